@@ -0,0 +1,79 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_BENCH__
+#define __CANARY_BENCH__
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+
+namespace canary::bench {
+
+    // Heap allocations made so far, counted by the replacement operator new in main.cpp
+    extern std::atomic<uint64_t> allocation_count;
+
+    // Runs fn (which processes items items) the given number of times and prints the best run, with the allocations
+    // it made
+    template<typename F>
+    void run(const char *name, uint64_t items, int iterations, F &&fn) {
+        double best_ns = 0;
+        uint64_t best_allocations = 0;
+        for (int i = 0; i < iterations; i++) {
+            const uint64_t allocations = allocation_count.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+
+            double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+            if (i == 0 || ns < best_ns) {
+                best_ns = ns;
+                best_allocations = allocation_count.load(std::memory_order_relaxed) - allocations;
+            }
+        }
+
+        std::printf("%-44s %12.0f items/s %10.1f ns/item %9.4f allocs/item\n", name, items / (best_ns / 1e9),
+                    best_ns / items, static_cast<double>(best_allocations) / items);
+    }
+
+    // Scratch file in the temp directory, removed when destroyed
+    class temp_file {
+    public:
+        explicit temp_file(const char *name);
+
+        ~temp_file();
+
+        temp_file(const temp_file &) = delete;
+
+        temp_file &operator=(const temp_file &) = delete;
+
+        [[nodiscard]] inline const std::string &get_path() const { return m_path; }
+
+    private:
+        std::string m_path;
+    };
+
+    inline const void *volatile optimiser_sink;
+
+    // Stops the optimiser from discarding a result
+    template<typename T>
+    inline void do_not_optimise(const T &value) {
+        optimiser_sink = &value;
+    }
+
+    void parser_benchmarks();
+
+    void decoder_benchmarks();
+
+    void dbc_benchmarks();
+
+    void store_benchmarks();
+
+    void filter_benchmarks();
+
+    void capture_benchmarks();
+
+}
+
+#endif
@@ -0,0 +1,98 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <random>
+#include <vector>
+
+#include "compression.hpp"
+#include "can/capturefile.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr size_t FRAME_COUNT = 1000000;
+
+        std::vector<can::frame> make_frames() {
+            std::mt19937 rng(1234);
+            std::vector<can::frame> frames(FRAME_COUNT);
+            for (size_t i = 0; i < frames.size(); i++) {
+                auto &f = frames[i];
+                f.id = 0x100 + (rng() % 200);
+                f.dlc = 8;
+                f.timestamp = 1700000000000000000ULL + i * 20000 + (rng() & 0xFFF);
+                f.data[0] = static_cast<uint8_t>(i >> 10);
+                f.data[1] = static_cast<uint8_t>(rng() & 0xF);
+                for (int b = 2; b < 8; b++) f.data[b] = static_cast<uint8_t>(f.id + b);
+            }
+            return frames;
+        }
+
+        int write_capture(const std::string &path, const std::vector<can::frame> &frames, bool compressed) {
+            can::capturewriter writer;
+            if (writer.open(path, compressed) != 0) return 1;
+            // In ingest-sized batches
+            for (size_t i = 0; i < frames.size(); i += 4096) {
+                if (writer.write(&frames[i], std::min<size_t>(4096, frames.size() - i)) != 0) return 1;
+            }
+            return writer.close();
+        }
+
+        // Opens the file and touches every frame
+        uint64_t read_capture(const std::string &path) {
+            can::capturefile file;
+            if (file.open(path) != 0) return 0;
+
+            uint64_t sum = 0;
+            for (size_t i = 0; i < file.size(); i++) sum += file[i].data[0];
+            return sum;
+        }
+    }
+
+    void capture_benchmarks() {
+        const auto frames = make_frames();
+        temp_file raw("canary_bench_raw.canary");
+        temp_file packed("canary_bench_compressed.canary");
+
+        int res = 0;
+        run("capture write, uncompressed", FRAME_COUNT, 3, [&] {
+            res |= write_capture(raw.get_path(), frames, false);
+        });
+        run("capture write, compressed", FRAME_COUNT, 3, [&] {
+            res |= write_capture(packed.get_path(), frames, true);
+        });
+
+        uint64_t sum = 0;
+        run("capture open + read, mapped", FRAME_COUNT, 3, [&] {
+            sum += read_capture(raw.get_path());
+        });
+        run("capture open + read, compressed", FRAME_COUNT, 3, [&] {
+            sum += read_capture(packed.get_path());
+        });
+        do_not_optimise(sum);
+
+        const auto *src = reinterpret_cast<const uint8_t *>(frames.data());
+        const size_t chunk_bytes = can::CAPTURE_CHUNK_FRAMES * sizeof(can::frame);
+        const size_t chunks = FRAME_COUNT / can::CAPTURE_CHUNK_FRAMES;
+        std::vector<uint8_t> compressed(compression::compress_bound(chunk_bytes) * chunks);
+        std::vector<size_t> sizes(chunks);
+        std::vector<uint8_t> decompressed(chunk_bytes);
+
+        run("lz4 compress, unshuffled chunks", chunks * can::CAPTURE_CHUNK_FRAMES, 3, [&] {
+            for (size_t c = 0; c < chunks; c++) {
+                sizes[c] = compression::compress(src + c * chunk_bytes, chunk_bytes,
+                                                 compressed.data() + c * compression::compress_bound(chunk_bytes));
+            }
+        });
+        run("lz4 decompress", chunks * can::CAPTURE_CHUNK_FRAMES, 3, [&] {
+            for (size_t c = 0; c < chunks; c++) {
+                res |= !compression::decompress(compressed.data() + c * compression::compress_bound(chunk_bytes),
+                                                sizes[c], decompressed.data(), chunk_bytes);
+            }
+        });
+
+        size_t total = 0;
+        for (size_t s: sizes) total += s;
+        std::printf("  unshuffled chunks compress to %.1f%%%s\n", 100.0 * total / (chunk_bytes * chunks),
+                    res ? ", ERRORS" : "");
+    }
+}
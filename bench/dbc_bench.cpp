@@ -0,0 +1,217 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include "dbc.hpp"
+#include "dbccache.hpp"
+#include "dbcdatabase.hpp"
+#include "dbcdecoder.hpp"
+#include "mappedfile.hpp"
+#include "stringutils.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr int MESSAGE_COUNT = 3000;
+        constexpr int SIGNALS_PER_MESSAGE = 16;
+        // Every nth message is multiplexed in the full grammar file
+        constexpr int MULTIPLEXED_EVERY = 8;
+
+        // Writes a DBC about the size of a large OEM body/powertrain database, returns the number of lines. The plain
+        // file has only BO_ and SG_ lines in the layout the legacy parser expects. The full file also has the
+        // comments, attributes, value descriptions and multiplexed signals real databases are full of.
+        size_t write_dbc(const std::string &path, bool full) {
+            std::mt19937 rng(1234);
+            std::FILE *file = std::fopen(path.c_str(), "w");
+            if (!file) return 0;
+
+            size_t lines = 0;
+            std::fprintf(file, "VERSION \"\"\n\n");
+            lines += 2;
+            if (full) {
+                std::fprintf(file, "NS_ :\n\tNS_DESC_\n\tCM_\n\tBA_DEF_\n\tBA_\n\tVAL_\n\tSIG_VALTYPE_\n"
+                                   "\tSG_MUL_VAL_\n\nBS_:\n\n");
+                std::fprintf(file, "VAL_TABLE_ OnOff 1 \"On\" 0 \"Off\" ;\n\n");
+                lines += 13;
+            }
+            std::fprintf(file, "BU_: ECM TCM BCM\n\n");
+            lines += 2;
+
+            for (int m = 0; m < MESSAGE_COUNT; m++) {
+                const unsigned id = (m % 3 == 0) ? (0x80000000u | (0x18FF0000u + m)) : (0x100u + m);
+                const bool multiplexed = full && m % MULTIPLEXED_EVERY == 0;
+                std::fprintf(file, "BO_ %u MSG_%d: 8 ECM\n", id, m);
+                lines++;
+                for (int s = 0; s < SIGNALS_PER_MESSAGE; s++) {
+                    const int start = (s * 4) % 64;
+                    std::string mux;
+                    if (multiplexed) mux = (s == 0) ? "M " : "m" + std::to_string(s % 4) + " ";
+                    std::fprintf(file, " SG_ SIG_%d_%d %s: %d|4@%c%c (%g,%g) [0|%d] \"unit\"  TCM,BCM\n", m, s,
+                                 mux.c_str(), start, (rng() & 1) ? '1' : '0', (rng() & 1) ? '+' : '-', 0.1 * (s + 1),
+                                 -10.0 * s, 15 * (s + 1));
+                    lines++;
+                }
+                std::fprintf(file, "\n");
+                lines++;
+            }
+
+            if (!full) {
+                std::fclose(file);
+                return lines;
+            }
+
+            std::fprintf(file, "BA_DEF_ BO_  \"GenMsgCycleTime\" INT 0 10000;\nBA_DEF_DEF_  \"GenMsgCycleTime\" 0;\n");
+            lines += 2;
+            for (int m = 0; m < MESSAGE_COUNT; m++) {
+                const unsigned id = (m % 3 == 0) ? (0x80000000u | (0x18FF0000u + m)) : (0x100u + m);
+                std::fprintf(file, "CM_ BO_ %u \"Message %d sent by the ECM,\nsee the \\\"network\\\" spec.\";\n", id,
+                             m);
+                std::fprintf(file, "CM_ SG_ %u SIG_%d_1 \"Signal comment\";\n", id, m);
+                std::fprintf(file, "BA_ \"GenMsgCycleTime\" BO_ %u %d;\n", id, 10 * (1 + m % 10));
+                std::fprintf(file, "VAL_ %u SIG_%d_2 3 \"Error\" 2 \"Fault\" 1 \"On\" 0 \"Off\" ;\n", id, m);
+                lines += 5;
+                if (m % MULTIPLEXED_EVERY == 0) {
+                    std::fprintf(file, "SG_MUL_VAL_ %u SIG_%d_3 SIG_%d_0 3-3, 5-7;\n", id, m, m);
+                    lines++;
+                }
+            }
+            std::fclose(file);
+            return lines;
+        }
+
+        // Previous loader: getline, split_string into copies for every field and stoi/stof
+        dbcfile legacy_load_dbc_file(const std::string &file_path) {
+            dbcfile dbc;
+            std::ifstream file(file_path);
+
+            std::string line;
+            long last_message_id = 0;
+            while (std::getline(file, line)) {
+                if (line.starts_with("BO_")) {
+                    auto parts = split_string(line, " ");
+                    auto name = parts[2].substr(0, parts[2].length() - 1);
+                    dbc_message message(std::stol(parts[1]), name, std::stoi(parts[3]), parts[4]);
+                    dbc.messages.insert(std::make_pair(std::stol(parts[1]), message));
+                    last_message_id = message.can_id;
+                } else if (line.starts_with(" SG_")) {
+                    auto parts = split_string(line, " ");
+                    auto bit_layout_parts = split_string(parts[4], "@");
+                    auto start_end = split_string(bit_layout_parts[0], "|");
+                    auto scale_offset_parts = split_string(parts[5].substr(1, parts[5].length() - 2), ",");
+                    auto min_max_parts = split_string(parts[6].substr(1, parts[6].length() - 2), "|");
+                    auto unit = parts[7];
+                    unit.erase(std::remove(unit.begin(), unit.end(), '"'), unit.end());
+
+                    dbc_signal signal(parts[2], std::stoi(start_end[0]), std::stoi(start_end[1]),
+                                      bit_layout_parts[1][0] == '1', bit_layout_parts[1][1] == '-',
+                                      std::stof(scale_offset_parts[0]), std::stof(scale_offset_parts[1]),
+                                      std::stof(min_max_parts[0]), std::stof(min_max_parts[1]), unit, parts[9]);
+                    signal.plan = compile_signal(signal);
+                    dbc.messages.at(last_message_id).signals.push_back(signal);
+                }
+            }
+            return dbc;
+        }
+
+        size_t count_signals(const dbcfile &dbc) {
+            size_t signals = 0;
+            for (const auto &[id, message]: dbc.messages) signals += message.signals.size();
+            return signals;
+        }
+    }
+
+    void dbc_benchmarks() {
+        temp_file plain("canary_bench.dbc");
+        temp_file full("canary_bench_full.dbc");
+        const size_t plain_lines = write_dbc(plain.get_path(), false);
+        const size_t full_lines = write_dbc(full.get_path(), true);
+
+        dbcfile legacy, loaded, full_loaded;
+        run("dbc load legacy getline/split_string", plain_lines, 3, [&] {
+            legacy = legacy_load_dbc_file(plain.get_path());
+        });
+        run("dbc load", plain_lines, 3, [&] {
+            loaded = dbcparser::load_dbc_file(plain.get_path());
+        });
+        std::printf("  %zu lines, legacy %zu messages/%zu signals, parser %zu messages/%zu signals\n", plain_lines,
+                    legacy.messages.size(), count_signals(legacy), loaded.messages.size(), count_signals(loaded));
+
+        size_t errors = 0;
+        run("dbc load full grammar", full_lines, 3, [&] {
+            errors = 0;
+            full_loaded = dbcparser::load_dbc_file(full.get_path(), [&errors](const std::string &) { errors++; });
+        });
+
+        size_t comments = 0, value_descriptions = 0, multiplexed = 0;
+        for (const auto &[id, message]: full_loaded.messages) {
+            for (const auto &signal: message.signals) {
+                if (!signal.comment.empty()) comments++;
+                if (!signal.values.empty()) value_descriptions++;
+                if (signal.multiplex_value >= 0 || !signal.multiplex_ranges.empty()) multiplexed++;
+            }
+        }
+        std::printf("  %zu lines, %zu messages/%zu signals, %zu commented, %zu with values, %zu multiplexed, "
+                    "%zu errors\n", full_lines, full_loaded.messages.size(), count_signals(full_loaded), comments,
+                    value_descriptions, multiplexed, errors);
+
+        // The first load through the cache parses and writes it, the rest read it back
+        const std::string cache_path = dbccache::get_cache_path(full.get_path());
+        dbccache::load(full.get_path());
+
+        mapped_file source;
+        source.open(full.get_path());
+        uint64_t hash = 0;
+        run("dbc content hash", full_lines, 5, [&] {
+            hash = dbccache::hash(source.get_data(), source.get_size());
+        });
+        do_not_optimise(hash);
+
+        std::shared_ptr<const dbcfile> cached;
+        run("dbc load from cache", full_lines, 5, [&] {
+            dbccache::clear_memory_cache();
+            cached = dbccache::load(full.get_path());
+        });
+        run("dbc load compiled", full_lines, 5, [&] {
+            cached = dbccache::load(full.get_path());
+        });
+
+        mapped_file cache;
+        cache.open(cache_path);
+        std::printf("  %zu byte DBC, %zu byte cache, %zu messages/%zu signals\n", source.get_size(), cache.get_size(),
+                    cached->messages.size(), count_signals(*cached));
+        cache.close();
+        std::remove(cache_path.c_str());
+
+        // A vehicle with a DBC per bus plus one shared by every bus, frames spread across the buses
+        constexpr int BUS_COUNT = 4;
+        dbcdatabase database;
+        for (int bus = 0; bus < BUS_COUNT; bus++) {
+            std::bitset<dbcdatabase::MAX_BUSES> buses;
+            buses.set(bus);
+            database.set_buses(database.add("bus" + std::to_string(bus) + ".dbc", cached), buses);
+        }
+        database.add("shared.dbc", loaded);
+
+        std::vector<std::pair<uint8_t, uint32_t>> lookups(200000);
+        std::mt19937 rng(99);
+        for (auto &[bus, id]: lookups) {
+            bus = static_cast<uint8_t>(rng() % (BUS_COUNT + 1));
+            const unsigned m = rng() % (MESSAGE_COUNT + MESSAGE_COUNT / 4);
+            id = (m % 3 == 0) ? (0x80000000u | (0x18FF0000u + m)) : (0x100u + m);
+        }
+
+        size_t found = 0;
+        run("dbc database find, 5 files", lookups.size(), 5, [&] {
+            found = 0;
+            for (const auto &[bus, id]: lookups) {
+                if (database.find(bus, id)) found++;
+            }
+        });
+        std::printf("  %zu index entries, %zu/%zu found\n", database.get_index().size(), found, lookups.size());
+    }
+}
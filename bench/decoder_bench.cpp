@@ -0,0 +1,171 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "dbcbatch.hpp"
+#include "dbcdatabase.hpp"
+#include "dbcdecoder.hpp"
+#include "dbcindex.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr size_t FRAME_COUNT = 100000;
+
+        // Previous frame properties path: expand the payload to a vector<bool> and rebuild 8/16-bit values bit by bit
+        std::vector<bool> legacy_bytes_to_bit_array(const uint8_t *data, size_t len) {
+            std::vector<bool> bits;
+            bits.reserve(len * 8);
+            for (size_t i = 0; i < len; i++) {
+                for (int bit = 7; bit >= 0; --bit) {
+                    bits.push_back((data[i] >> bit) & 1);
+                }
+            }
+            return bits;
+        }
+
+        uint64_t legacy_extract(const std::vector<bool> &bits, size_t start, size_t length) {
+            uint64_t result = 0;
+            for (size_t i = 0; i < length; ++i) {
+                if (bits[start + i]) result |= 1ULL << (length - 1 - i);
+            }
+            return result;
+        }
+
+        // Typical powertrain message, a mix of byte-aligned and packed signals in both byte orders
+        dbc_message make_message() {
+            dbc_message message(0x102CA040, "ENGINE_INFO", 8, "ECM");
+            const struct {
+                int start, length;
+                bool little_endian;
+            } layouts[] = {{0, 8, true}, {8, 16, true}, {24, 1, true}, {25, 3, true}, {28, 12, true},
+                           {47, 8, false}, {55, 16, false}, {60, 4, false}};
+
+            for (const auto &l: layouts) {
+                dbc_signal signal("SIG", l.start, l.length, l.little_endian, false, 0.25f, -40.0f, 0, 0, "", "");
+                signal.plan = compile_signal(signal);
+                message.signals.push_back(signal);
+            }
+            return message;
+        }
+
+        // Body control style message: a page number selecting one of 16 pages of 8 signals, plus two fixed signals
+        dbc_message make_multiplexed_message() {
+            dbc_message message(0x3A0, "BCM_STATUS", 8, "BCM");
+            dbc_signal page("PAGE", 0, 4, true, false, 1, 0, 0, 0, "", "");
+            page.is_multiplexor = true;
+            message.signals.push_back(page);
+            message.signals.emplace_back("COUNTER", 4, 4, true, false, 1, 0, 0, 0, "", "");
+            for (int p = 0; p < 16; p++) {
+                for (int s = 0; s < 8; s++) {
+                    dbc_signal signal("SIG", 8 + s * 7, 7, true, false, 0.5f, 0, 0, 0, "", "");
+                    signal.multiplex_value = p;
+                    message.signals.push_back(signal);
+                }
+            }
+            for (auto &signal: message.signals) signal.plan = compile_signal(signal);
+            message.mux = compile_multiplexing(message);
+            return message;
+        }
+    }
+
+    void decoder_benchmarks() {
+        std::mt19937 rng(1234);
+        std::vector<can::frame> frames(FRAME_COUNT);
+        for (auto &f: frames) {
+            f.dlc = 8;
+            for (int b = 0; b < 8; b++) f.data[b] = static_cast<uint8_t>(rng());
+        }
+
+        auto message = make_message();
+        const size_t signal_count = message.signals.size();
+        std::vector<double> values(signal_count);
+        double sum = 0;
+
+        run("signal decode legacy vector<bool>", FRAME_COUNT * signal_count, 5, [&] {
+            for (const auto &f: frames) {
+                auto bits = legacy_bytes_to_bit_array(f.data, f.dlc);
+                for (const auto &signal: message.signals) {
+                    int start = signal.start < static_cast<int>(bits.size()) - signal.length ? signal.start : 0;
+                    sum += signal.offset + signal.scale * static_cast<float>(legacy_extract(bits, start, signal.length));
+                }
+            }
+        });
+        run("signal decode compiled plan", FRAME_COUNT * signal_count, 5, [&] {
+            for (const auto &f: frames) {
+                decode_message(message, f, values.data());
+                for (double v: values) sum += v;
+            }
+        });
+
+        // Checking every signal's multiplex value against the multiplexor, against the plan's one lookup per frame
+        auto multiplexed = make_multiplexed_message();
+        values.resize(multiplexed.signals.size());
+        size_t present = 0;
+        run("multiplexed decode per-signal check", FRAME_COUNT, 5, [&] {
+            for (const auto &f: frames) {
+                dbc_payload payload(f);
+                const auto page = static_cast<int64_t>(extract_raw(multiplexed.signals[0].plan, payload));
+                for (size_t i = 0; i < multiplexed.signals.size(); i++) {
+                    const auto &signal = multiplexed.signals[i];
+                    if (signal.multiplex_value >= 0 && signal.multiplex_value != page) {
+                        values[i] = std::numeric_limits<double>::quiet_NaN();
+                    } else {
+                        values[i] = decode_signal(signal.plan, payload);
+                    }
+                }
+                sum += values[0];
+            }
+        });
+        run("multiplexed decode compiled plan", FRAME_COUNT, 5, [&] {
+            present = 0;
+            for (const auto &f: frames) {
+                present += decode_message(multiplexed, f, values.data());
+                sum += values[0];
+            }
+        });
+        std::printf("  %zu signals, %zu present per frame\n", multiplexed.signals.size(), present / FRAME_COUNT);
+
+        // Whole capture into per-signal columns: resolving and decoding frame by frame, against the batch decoder
+        dbcfile dbc;
+        dbc.messages.emplace(message.can_id, message);
+        dbc.messages.emplace(multiplexed.can_id, multiplexed);
+        dbcdatabase database;
+        database.add("bench.dbc", std::move(dbc));
+        dbcindex index;
+        index.build(database);
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            frames[i].id = (i % 2) ? (can::FRAME_EXTENDED_FLAG | 0x102CA040) : 0x3A0;
+            frames[i].timestamp = i * 1000;
+        }
+
+        std::unordered_map<const dbc_message *, std::vector<std::vector<double>>> columns;
+        run("capture decode frame by frame", FRAME_COUNT, 5, [&] {
+            columns.clear();
+            for (const auto &f: frames) {
+                const auto *m = index.find(f);
+                if (!m) continue;
+                auto &out = columns[m];
+                out.resize(m->signals.size());
+                decode_message(*m, f, values.data());
+                for (size_t i = 0; i < out.size(); i++) out[i].push_back(values[i]);
+            }
+        });
+        size_t series = 0;
+        run("capture decode dbcbatch", FRAME_COUNT, 5, [&] {
+            dbcbatch batch;
+            batch.update(frames, index);
+            for (const auto &s: batch.get_series()) batch.decode(s->bus, s->id);
+            series = batch.get_series().size();
+        });
+        std::printf("  %zu series\n", series);
+
+        do_not_optimise(sum);
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <random>
+#include <vector>
+
+#include "can/framestore.hpp"
+#include "can/packetfilter.hpp"
+#include "can/searchindex.hpp"
+#include "can/diffsearch.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr size_t FRAME_COUNT = 2000000;
+        constexpr size_t ID_COUNT = 300;
+        constexpr int QUERY_COUNT = 1000;
+
+        // A few hundred IDs with mostly slow-moving payloads, like a real bus
+        void fill_store(can::framestore &store) {
+            std::mt19937 rng(1234);
+            std::vector<uint32_t> ids(ID_COUNT);
+            for (auto &id: ids) {
+                id = (rng() % 4 == 0) ? (can::FRAME_EXTENDED_FLAG | (rng() & can::FRAME_EXTENDED_MASK)) : (rng() & 0x7FF);
+            }
+
+            can::frame f{};
+            f.dlc = 8;
+            for (size_t i = 0; i < FRAME_COUNT; i++) {
+                f.id = ids[rng() % ID_COUNT];
+                f.timestamp = 1700000000000000000ULL + i * 20000;
+                f.data[0] = static_cast<uint8_t>(i >> 12);
+                f.data[1] = static_cast<uint8_t>(rng() & 0x3);
+                for (int b = 2; b < 8; b++) f.data[b] = static_cast<uint8_t>((f.id >> b) + (i >> 16));
+                store.push_back(f);
+            }
+        }
+    }
+
+    void filter_benchmarks() {
+        can::framestore store;
+        fill_store(store);
+
+        // Hide a third of the IDs, as with the default OBD exclusions
+        can::packetfilter filter;
+        filter.set_mode(can::packetfilter::mode::EXCLUDE);
+        filter.set_enabled(true);
+        for (size_t i = 0; i < FRAME_COUNT && filter.get_ids().size() < ID_COUNT / 3; i += 97) {
+            filter.add_id(store[i].id);
+        }
+
+        size_t rows = 0;
+        run("filter view, incremental update", FRAME_COUNT, 5, [&] {
+            // Up to date with the filter, so only new packets are scanned, on this thread
+            can::packetfilter::view v;
+            v.generation = filter.get_generation();
+            filter.update_view(v, store);
+            rows = v.rows.size();
+        });
+        run("filter view, parallel rebuild", FRAME_COUNT, 5, [&] {
+            // A fresh view is out of date, so the whole store is rebuilt across threads
+            can::packetfilter::view v;
+            filter.update_view(v, store);
+            rows = v.rows.size();
+        });
+        std::printf("  %zu/%zu rows pass the filter\n", rows, FRAME_COUNT);
+
+        can::searchindex index;
+        run("search index build", FRAME_COUNT, 3, [&] {
+            index.reset();
+            index.update(store);
+        });
+
+        size_t matches = 0;
+        run("search find_ids, value range", QUERY_COUNT, 5, [&] {
+            for (int q = 0; q < QUERY_COUNT; q++) {
+                const auto lo = static_cast<uint8_t>(q % 200);
+                matches += index.find_ids(lo, static_cast<uint8_t>(lo + 10)).size();
+            }
+        });
+        run("search find_frames, first 10000", QUERY_COUNT, 5, [&] {
+            for (int q = 0; q < QUERY_COUNT; q++) {
+                const auto lo = static_cast<uint8_t>(q % 200);
+                matches += index.find_frames(lo, static_cast<uint8_t>(lo + 10), 10000).size();
+            }
+        });
+        do_not_optimise(matches);
+
+        can::diffsearch diff;
+        run("diff search segment summary", FRAME_COUNT, 3, [&] {
+            diff.reset();
+            diff.add_segment(store, 0, store.size());
+        });
+
+        const size_t half = store.size() / 2;
+        diff.reset();
+        const size_t first = diff.add_segment(store, 0, half);
+        const size_t second = diff.add_segment(store, half, store.size());
+        size_t candidates = 0;
+        run("diff search apply changed + increased", ID_COUNT * 8, 5, [&] {
+            while (diff.undo()) {}
+            diff.apply(first, can::diffsearch::condition::CHANGED);
+            candidates = diff.apply(second, can::diffsearch::condition::INCREASED).size();
+        });
+        std::printf("  %zu candidate bytes left\n", candidates);
+    }
+}
@@ -0,0 +1,67 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+
+namespace canary::bench {
+    std::atomic<uint64_t> allocation_count{0};
+
+    temp_file::temp_file(const char *name) : m_path((std::filesystem::temp_directory_path() / name).string()) {}
+
+    temp_file::~temp_file() {
+        std::error_code ec;
+        std::filesystem::remove(m_path, ec);
+    }
+}
+
+// Count every heap allocation so benchmarks can report allocations per item
+void *operator new(std::size_t size) {
+    canary::bench::allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size == 0 ? 1 : size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    struct group {
+        const char *name;
+        void (*fn)();
+    };
+
+    constexpr group GROUPS[] = {
+            {"parser",  canary::bench::parser_benchmarks},
+            {"store",   canary::bench::store_benchmarks},
+            {"dbc",     canary::bench::dbc_benchmarks},
+            {"decoder", canary::bench::decoder_benchmarks},
+            {"filter",  canary::bench::filter_benchmarks},
+            {"capture", canary::bench::capture_benchmarks},
+    };
+}
+
+// canary_bench [group...], runs every group if none are named
+int main(int argc, char **argv) {
+    for (const auto &g: GROUPS) {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], g.name) == 0) selected = true;
+        }
+        if (!selected) continue;
+
+        std::printf("[%s]\n", g.name);
+        g.fn();
+        std::printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <string>
+#include <vector>
+#include <random>
+
+#include "can/socketcandparser.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr size_t FRAME_COUNT = 200000;
+        constexpr size_t RECV_SIZE = 1024;
+
+        // Builds a socketcand rawmode stream similar to a busy powertrain bus
+        std::string make_stream() {
+            std::mt19937 rng(1234);
+            std::string stream;
+            char line[128];
+
+            for (size_t i = 0; i < FRAME_COUNT; i++) {
+                bool extended = (rng() % 4) != 0;
+                unsigned id = extended ? (rng() & 0x1FFFFFFF) : (rng() & 0x7FF);
+                int len = std::snprintf(line, sizeof(line), extended ? "< frame %08X %u.%06u " : "< frame %03X %u.%06u ",
+                                        id, 1700000000u + static_cast<unsigned>(i / 2000),
+                                        static_cast<unsigned>((i % 2000) * 500));
+                stream.append(line, len);
+                for (int b = 0; b < 8; b++) {
+                    std::snprintf(line, sizeof(line), "%02X", static_cast<unsigned>(rng() & 0xFF));
+                    stream.append(line, 2);
+                }
+                stream.append(" >");
+            }
+
+            return stream;
+        }
+
+        // Previous receive loop: copy each read into a string, substr each packet and split it into parts
+        std::vector<std::string> legacy_split_string(std::string s, const std::string &delimiter) {
+            std::vector<std::string> res;
+            size_t pos;
+            while ((pos = s.find(delimiter)) != std::string::npos) {
+                res.push_back(s.substr(0, pos));
+                s.erase(0, pos + delimiter.length());
+            }
+            res.push_back(s);
+            return res;
+        }
+
+        size_t legacy_parse(const std::string &stream) {
+            size_t frames = 0;
+            std::vector<std::string> packets;
+            for (size_t offset = 0; offset < stream.size(); offset += RECV_SIZE) {
+                auto partial_buffer = stream.substr(offset, RECV_SIZE);
+
+                size_t start = 0;
+                size_t end;
+                while ((end = partial_buffer.find('>', start)) != std::string::npos) {
+                    std::string packet = partial_buffer.substr(start, end - start + 1);
+                    packets.emplace_back(packet);
+                    start = end + 1;
+
+                    auto parts = legacy_split_string(packet, " ");
+                    if (parts.size() == 6) frames++;
+                }
+            }
+            do_not_optimise(packets);
+            return frames;
+        }
+
+        size_t stream_parse(const std::string &stream, std::vector<can::frame> &out) {
+            can::socketcandparser parser;
+            out.clear();
+            for (size_t offset = 0; offset < stream.size(); offset += RECV_SIZE) {
+                size_t len = std::min(RECV_SIZE, stream.size() - offset);
+                parser.feed(stream.data() + offset, len, [&out](const can::frame &f) {
+                    out.push_back(f);
+                });
+            }
+            return out.size();
+        }
+    }
+
+    void parser_benchmarks() {
+        auto stream = make_stream();
+        std::vector<can::frame> frames;
+        frames.reserve(FRAME_COUNT);
+
+        size_t legacy_frames = 0, parsed_frames = 0;
+
+        run("socketcand legacy split_string", FRAME_COUNT, 5, [&] {
+            legacy_frames = legacy_parse(stream);
+        });
+        run("socketcand stream parser", FRAME_COUNT, 5, [&] {
+            parsed_frames = stream_parse(stream, frames);
+        });
+
+        std::printf("  legacy path recognised %zu/%zu frames, stream parser %zu/%zu\n", legacy_frames, FRAME_COUNT,
+                    parsed_frames, FRAME_COUNT);
+    }
+}
@@ -0,0 +1,90 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "bench.hpp"
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "spscring.hpp"
+#include "can/framestore.hpp"
+#include "can/packetprovider.hpp"
+
+namespace canary::bench {
+    namespace {
+        constexpr size_t FRAME_COUNT = 1000000;
+        // Frames enqueued between polls, about one render frame's worth on a very busy bus
+        constexpr size_t POLL_BATCH = 4096;
+
+        std::vector<can::frame> make_frames(size_t buses) {
+            std::mt19937 rng(1234);
+            std::vector<can::frame> frames(FRAME_COUNT);
+            for (size_t i = 0; i < frames.size(); i++) {
+                auto &f = frames[i];
+                f.id = rng() & 0x7FF;
+                f.bus = static_cast<uint8_t>(i % buses);
+                f.dlc = 8;
+                f.timestamp = 1700000000000000000ULL + i * 20000;
+                for (int b = 0; b < 8; b++) f.data[b] = static_cast<uint8_t>(rng());
+            }
+            return frames;
+        }
+
+        // Enqueues every frame onto its bus queue, polling after each batch like the render loop
+        size_t ingest(const std::vector<can::frame> &frames, size_t buses) {
+            can::packetprovider provider;
+            for (size_t b = 0; b < buses; b++) provider.add_queue();
+
+            for (size_t i = 0; i < frames.size(); i += POLL_BATCH) {
+                const size_t end = std::min(frames.size(), i + POLL_BATCH);
+                for (size_t j = i; j < end; j++) {
+                    provider.enqueue(frames[j].bus, frames[j]);
+                }
+                provider.poll();
+            }
+            while (provider.poll() > 0) {}
+
+            return provider.get_received_packets().size();
+        }
+    }
+
+    void store_benchmarks() {
+        const auto frames = make_frames(1);
+        size_t stored = 0;
+
+        run("frame store append", FRAME_COUNT, 5, [&] {
+            can::framestore store;
+            for (const auto &f: frames) store.push_back(f);
+            stored = store.size();
+        });
+
+        run("frame store append, spilling past 4 MB", FRAME_COUNT, 5, [&] {
+            can::framestore store;
+            store.set_memory_budget(4 * 1024 * 1024);
+            for (const auto &f: frames) store.push_back(f);
+            stored = store.size();
+        });
+
+        run("spsc ring push + drain", FRAME_COUNT, 5, [&] {
+            spsc_ring<can::frame> ring(can::packetprovider::DEFAULT_QUEUE_CAPACITY);
+            size_t drained = 0;
+            for (size_t i = 0; i < frames.size(); i += POLL_BATCH) {
+                const size_t end = std::min(frames.size(), i + POLL_BATCH);
+                for (size_t j = i; j < end; j++) ring.push(frames[j]);
+                drained += ring.drain([](std::span<const can::frame> batch) { do_not_optimise(batch); });
+            }
+            stored = drained;
+        });
+
+        run("ingest enqueue + poll, 1 bus", FRAME_COUNT, 5, [&] {
+            stored = ingest(frames, 1);
+        });
+
+        const auto multi_bus_frames = make_frames(4);
+        run("ingest enqueue + poll, 4 buses merged", FRAME_COUNT, 5, [&] {
+            stored = ingest(multi_bus_frames, 4);
+        });
+
+        std::printf("  stored %zu/%zu frames\n", stored, FRAME_COUNT);
+    }
+}
@@ -0,0 +1,470 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "capturefile.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <format>
+
+#include "../compression.hpp"
+
+#if defined(WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace canary::can {
+    namespace {
+        uint32_t bloom_key(uint32_t id) {
+            return id & (FRAME_EXTENDED_FLAG | FRAME_EXTENDED_MASK);
+        }
+
+        void add_to_chunk(capture_chunk_info &chunk, const frame &f) {
+            if (chunk.frame_count == 0) chunk.first_timestamp = f.timestamp;
+            chunk.last_timestamp = f.timestamp;
+            capture_bloom_add(chunk.id_bloom, f.id);
+            chunk.frame_count++;
+        }
+
+        // Byte b of record r goes to b * count + r, so e.g. the mostly identical high timestamp bytes end up next to
+        // each other and compress well
+        void shuffle(const frame *frames, size_t count, uint8_t *out) {
+            const auto *in = reinterpret_cast<const uint8_t *>(frames);
+            for (size_t r = 0; r < count; r++) {
+                for (size_t b = 0; b < sizeof(frame); b++) {
+                    out[b * count + r] = in[r * sizeof(frame) + b];
+                }
+            }
+        }
+
+        void unshuffle(const uint8_t *in, size_t count, frame *frames) {
+            auto *out = reinterpret_cast<uint8_t *>(frames);
+            for (size_t b = 0; b < sizeof(frame); b++) {
+                for (size_t r = 0; r < count; r++) {
+                    out[r * sizeof(frame) + b] = in[b * count + r];
+                }
+            }
+        }
+    }
+
+    void capture_bloom_add(uint64_t *bloom, uint32_t id) {
+        uint32_t h = bloom_key(id) * 0x9E3779B1U;
+        bloom[(h >> 24) & 3] |= 1ULL << ((h >> 16) & 63);
+        bloom[(h >> 8) & 3] |= 1ULL << (h & 63);
+    }
+
+    bool capture_bloom_test(const uint64_t *bloom, uint32_t id) {
+        uint32_t h = bloom_key(id) * 0x9E3779B1U;
+        return (bloom[(h >> 24) & 3] & (1ULL << ((h >> 16) & 63))) && (bloom[(h >> 8) & 3] & (1ULL << (h & 63)));
+    }
+
+    capturewriter::~capturewriter() {
+        close();
+    }
+
+    int capturewriter::open(const std::string &path, bool compressed) {
+        close();
+
+        m_file = std::fopen(path.c_str(), "wb");
+        if (!m_file) {
+            return 1;
+        }
+        std::setvbuf(m_file, nullptr, _IOFBF, 1 << 20);
+
+        m_compressed = compressed;
+        m_flags = compressed ? CAPTURE_FLAG_COMPRESSED : 0;
+        std::memset(m_bus_mask, 0, sizeof(m_bus_mask));
+        m_chunks.clear();
+        m_pending.clear();
+        m_frame_count = 0;
+        m_offset = 0;
+
+        capture_header header{};
+        std::memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = CAPTURE_VERSION;
+        header.byte_order = CAPTURE_BYTE_ORDER_MARK;
+        header.record_size = sizeof(frame);
+        header.chunk_frames = CAPTURE_CHUNK_FRAMES;
+        header.flags = m_flags;
+        return write_bytes(&header, sizeof(header));
+    }
+
+    int capturewriter::write_bytes(const void *data, size_t len) {
+        if (std::fwrite(data, 1, len, m_file) != len) {
+            return 1;
+        }
+        m_offset += len;
+        return 0;
+    }
+
+    int capturewriter::write(const frame *frames, size_t count) {
+        if (!m_file) return 1;
+
+        for (size_t i = 0; i < count; i++) {
+            m_bus_mask[frames[i].bus / 32] |= 1u << (frames[i].bus % 32);
+        }
+
+        if (m_compressed) {
+            for (size_t i = 0; i < count; i++) {
+                m_pending.push_back(frames[i]);
+                if (m_pending.size() == CAPTURE_CHUNK_FRAMES && write_block() != 0) {
+                    return 1;
+                }
+            }
+            m_frame_count += count;
+            return 0;
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            if (m_chunks.empty() || m_chunks.back().frame_count == CAPTURE_CHUNK_FRAMES) {
+                m_chunks.emplace_back();
+                m_chunks.back().offset = m_offset + i * sizeof(frame);
+            }
+            add_to_chunk(m_chunks.back(), frames[i]);
+            m_chunks.back().stored_size += sizeof(frame);
+        }
+        m_frame_count += count;
+
+        return write_bytes(frames, count * sizeof(frame));
+    }
+
+    int capturewriter::write_block() {
+        const size_t count = m_pending.size();
+        const size_t raw_size = count * sizeof(frame);
+
+        m_shuffled.resize(raw_size);
+        shuffle(m_pending.data(), count, m_shuffled.data());
+
+        m_compressed_buffer.resize(compression::compress_bound(raw_size));
+        size_t stored = compression::compress(m_shuffled.data(), raw_size, m_compressed_buffer.data());
+
+        capture_chunk_info chunk{};
+        for (const auto &f: m_pending) {
+            add_to_chunk(chunk, f);
+        }
+        chunk.offset = m_offset;
+        chunk.stored_size = static_cast<uint32_t>(stored);
+        m_chunks.push_back(chunk);
+
+        capture_block_header block{static_cast<uint32_t>(stored), static_cast<uint32_t>(count)};
+        m_pending.clear();
+
+        if (write_bytes(&block, sizeof(block)) != 0) return 1;
+        return write_bytes(m_compressed_buffer.data(), stored);
+    }
+
+    int capturewriter::sync() {
+        if (!m_file) return 1;
+        if (std::fflush(m_file) != 0) return 1;
+#if defined(WIN32)
+        return _commit(_fileno(m_file)) == 0 ? 0 : 1;
+#else
+        return fsync(fileno(m_file)) == 0 ? 0 : 1;
+#endif
+    }
+
+    int capturewriter::close() {
+        if (!m_file) return 0;
+
+        bool ok = true;
+        if (!m_pending.empty()) {
+            ok = write_block() == 0;
+        }
+
+        capture_footer footer{};
+        footer.frame_count = m_frame_count;
+        footer.directory_offset = m_offset;
+        footer.chunk_count = static_cast<uint32_t>(m_chunks.size());
+        std::memcpy(footer.magic, CAPTURE_FOOTER_MAGIC, sizeof(footer.magic));
+
+        ok = ok && write_bytes(m_chunks.data(), m_chunks.size() * sizeof(capture_chunk_info)) == 0;
+        ok = ok && write_bytes(&footer, sizeof(footer)) == 0;
+
+        // The buses are only known now, fill them in in the header. A file that is never closed does without.
+        m_flags |= CAPTURE_FLAG_BUS_MASK;
+        ok = ok && std::fseek(m_file, offsetof(capture_header, flags), SEEK_SET) == 0;
+        ok = ok && std::fwrite(&m_flags, sizeof(m_flags), 1, m_file) == 1;
+        ok = ok && std::fwrite(m_bus_mask, sizeof(m_bus_mask), 1, m_file) == 1;
+        ok = ok && sync() == 0;
+
+        ok = std::fclose(m_file) == 0 && ok;
+        m_file = nullptr;
+        m_chunks.clear();
+        return ok ? 0 : 1;
+    }
+
+    capturefile::~capturefile() {
+        close();
+    }
+
+    int capturefile::map_file(const std::string &path) {
+        // Records are mostly read in order by the packet view and searches
+        if (m_mapping.open(path, true) != 0) return 1;
+
+        m_data = m_mapping.get_data();
+        m_length = m_mapping.get_size();
+        return 0;
+    }
+
+    void capturefile::unmap_file() {
+        m_mapping.close();
+        m_data = nullptr;
+        m_length = 0;
+    }
+
+    int capturefile::open(const std::string &path) {
+        close();
+
+        if (map_file(path) != 0) {
+            if (m_error_handler) m_error_handler(std::format("Error opening capture file: {}", path));
+            return 1;
+        }
+
+        capture_header header{};
+        if (m_length < sizeof(header)) {
+            if (m_error_handler) m_error_handler(std::format("Not a capture file: {}", path));
+            close();
+            return 1;
+        }
+        std::memcpy(&header, m_data, sizeof(header));
+
+        if (std::memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0) {
+            if (m_error_handler) m_error_handler(std::format("Not a capture file: {}", path));
+            close();
+            return 1;
+        }
+        if (header.version != CAPTURE_VERSION || header.byte_order != CAPTURE_BYTE_ORDER_MARK ||
+            header.record_size != sizeof(frame)) {
+            if (m_error_handler) m_error_handler(std::format("Unsupported capture file format: {}", path));
+            close();
+            return 1;
+        }
+
+        m_path = path;
+        m_has_buses = (header.flags & CAPTURE_FLAG_BUS_MASK) != 0;
+        for (size_t b = 0; b < m_buses.size(); b++) {
+            m_buses[b] = m_has_buses && (header.bus_mask[b / 32] >> (b % 32)) & 1;
+        }
+        const bool compressed = (header.flags & CAPTURE_FLAG_COMPRESSED) != 0;
+        if (!compressed) {
+            m_frames = reinterpret_cast<const frame *>(m_data + sizeof(capture_header));
+        }
+
+        capture_footer footer{};
+        if (m_length >= sizeof(header) + sizeof(footer)) {
+            std::memcpy(&footer, m_data + m_length - sizeof(footer), sizeof(footer));
+        }
+
+        bool has_footer = std::memcmp(footer.magic, CAPTURE_FOOTER_MAGIC, sizeof(footer.magic)) == 0 &&
+                          footer.frame_count <= static_cast<uint64_t>(footer.chunk_count) * CAPTURE_CHUNK_FRAMES &&
+                          footer.chunk_count <= m_length / sizeof(capture_chunk_info) &&
+                          footer.directory_offset >= sizeof(capture_header) &&
+                          footer.directory_offset + footer.chunk_count * sizeof(capture_chunk_info) +
+                          sizeof(footer) == m_length;
+        if (has_footer && !compressed) {
+            has_footer = footer.directory_offset == sizeof(capture_header) + footer.frame_count * sizeof(frame);
+        }
+
+        // The frames end where the directory starts, even if the directory itself turns out to be corrupt
+        const uint64_t data_end = has_footer ? footer.directory_offset : m_length;
+        if (has_footer) {
+            m_chunks.resize(footer.chunk_count);
+            std::memcpy(m_chunks.data(), m_data + footer.directory_offset,
+                        footer.chunk_count * sizeof(capture_chunk_info));
+
+            if (!check_directory(footer.frame_count, data_end, compressed)) {
+                if (m_error_handler)
+                    m_error_handler(std::format("Capture file index is corrupt, rebuilding it: {}", path));
+                has_footer = false;
+            }
+        }
+
+        if (has_footer) {
+            m_frame_count = footer.frame_count;
+        } else if (compressed) {
+            // Not closed properly, keep every complete block
+            rebuild_compressed_chunks(data_end);
+        } else {
+            // Not closed properly, keep every complete record
+            m_frame_count = (data_end - sizeof(capture_header)) / sizeof(frame);
+            rebuild_chunks();
+        }
+
+        return 0;
+    }
+
+    bool capturefile::get_buses(std::bitset<256> &buses) const {
+        if (!m_has_buses) return false;
+        buses = m_buses;
+        return true;
+    }
+
+    void capturefile::close() {
+        unmap_file();
+        m_path.clear();
+        m_has_buses = false;
+        m_frames = nullptr;
+        m_frame_count = 0;
+        m_chunks.clear();
+
+        std::lock_guard lk(m_decode_mutex);
+        m_decoded.clear();
+    }
+
+    bool capturefile::check_directory(uint64_t frame_count, uint64_t end, bool compressed) const {
+        uint64_t total = 0;
+        for (size_t c = 0; c < m_chunks.size(); c++) {
+            const auto &chunk = m_chunks[c];
+
+            // Frames are found by index, so every chunk but the last has to be full
+            if (chunk.frame_count == 0 || chunk.frame_count > CAPTURE_CHUNK_FRAMES ||
+                (c + 1 < m_chunks.size() && chunk.frame_count != CAPTURE_CHUNK_FRAMES)) {
+                return false;
+            }
+
+            if (compressed) {
+                capture_block_header block{};
+                if (chunk.offset < sizeof(capture_header) || chunk.offset > end ||
+                    end - chunk.offset < sizeof(block) + static_cast<uint64_t>(chunk.stored_size)) {
+                    return false;
+                }
+                std::memcpy(&block, m_data + chunk.offset, sizeof(block));
+                if (block.frame_count != chunk.frame_count || block.stored_size != chunk.stored_size) return false;
+            } else if (chunk.offset != sizeof(capture_header) + total * sizeof(frame) ||
+                       chunk.stored_size != chunk.frame_count * sizeof(frame)) {
+                return false;
+            }
+
+            total += chunk.frame_count;
+        }
+        return total == frame_count;
+    }
+
+    void capturefile::rebuild_chunks() {
+        m_chunks.clear();
+        m_chunks.reserve((m_frame_count + CAPTURE_CHUNK_FRAMES - 1) / CAPTURE_CHUNK_FRAMES);
+        for (size_t i = 0; i < m_frame_count; i++) {
+            if (i % CAPTURE_CHUNK_FRAMES == 0) m_chunks.emplace_back();
+            add_to_chunk(m_chunks.back(), m_frames[i]);
+        }
+    }
+
+    void capturefile::rebuild_compressed_chunks(uint64_t end) {
+        m_chunks.clear();
+        m_frame_count = 0;
+
+        // The summaries need the frames, but the file may be far larger than memory so each chunk is only decoded
+        // into this buffer and then dropped
+        auto frames = std::make_unique<frame[]>(CAPTURE_CHUNK_FRAMES);
+        std::vector<uint8_t> shuffled;
+
+        // Walk the blocks, only the last chunk can be partial
+        uint64_t offset = sizeof(capture_header);
+        while (offset + sizeof(capture_block_header) <= end) {
+            capture_block_header block{};
+            std::memcpy(&block, m_data + offset, sizeof(block));
+            if (block.frame_count == 0 || block.frame_count > CAPTURE_CHUNK_FRAMES ||
+                offset + sizeof(block) + block.stored_size > end) {
+                break;
+            }
+
+            capture_chunk_info chunk{};
+            chunk.offset = offset;
+            chunk.stored_size = block.stored_size;
+
+            // The summary counts its frames as they are added, the block's count is only needed for decoding
+            capture_chunk_info stored = chunk;
+            stored.frame_count = block.frame_count;
+            if (!decode_block(stored, frames.get(), shuffled)) {
+                // Torn write, keep the blocks before it
+                break;
+            }
+            for (uint32_t i = 0; i < block.frame_count; i++) {
+                add_to_chunk(chunk, frames[i]);
+            }
+            m_chunks.push_back(chunk);
+            m_frame_count += block.frame_count;
+
+            offset += sizeof(block) + block.stored_size;
+            if (block.frame_count < CAPTURE_CHUNK_FRAMES) break;
+        }
+    }
+
+    bool capturefile::decode_block(const capture_chunk_info &info, frame *out, std::vector<uint8_t> &shuffled) const {
+        shuffled.resize(info.frame_count * sizeof(frame));
+
+        const uint8_t *block = m_data + info.offset + sizeof(capture_block_header);
+        if (!compression::decompress(block, info.stored_size, shuffled.data(), shuffled.size())) return false;
+        unshuffle(shuffled.data(), info.frame_count, out);
+
+        // Readers size buffers by dlc
+        for (uint32_t i = 0; i < info.frame_count; i++) {
+            if (out[i].dlc > FRAME_MAX_DATA) out[i].dlc = FRAME_MAX_DATA;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const frame[]> capturefile::get_chunk(size_t chunk) const {
+        {
+            std::lock_guard lk(m_decode_mutex);
+            for (auto &d: m_decoded) {
+                if (d.chunk == chunk) {
+                    d.last_used = ++m_decode_clock;
+                    return d.frames;
+                }
+            }
+        }
+
+        // Decompressed without the lock so filter workers decode their own chunks in parallel. Value-initialised, a
+        // corrupt chunk reads as zeroed frames rather than failing every access.
+        auto frames = std::make_shared<frame[]>(CAPTURE_CHUNK_FRAMES);
+        std::vector<uint8_t> shuffled;
+        if (!decode_block(m_chunks[chunk], frames.get(), shuffled)) {
+            if (m_error_handler) m_error_handler(std::format("Capture file chunk {} is corrupt", chunk));
+        }
+
+        std::lock_guard lk(m_decode_mutex);
+        for (auto &d: m_decoded) {
+            // Another thread may have got here first
+            if (d.chunk == chunk) return d.frames;
+        }
+
+        if (m_decoded.size() < DECODED_CHUNK_LIMIT) {
+            m_decoded.push_back({chunk, frames, ++m_decode_clock});
+        } else {
+            auto lru = std::min_element(m_decoded.begin(), m_decoded.end(),
+                                        [](const decoded_chunk &a, const decoded_chunk &b) {
+                                            return a.last_used < b.last_used;
+                                        });
+            *lru = {chunk, frames, ++m_decode_clock};
+        }
+        return frames;
+    }
+
+    void capturefile::read(size_t first, size_t count, frame *out) const {
+        while (count > 0) {
+            const size_t chunk = first / CAPTURE_CHUNK_FRAMES;
+            const size_t begin = first % CAPTURE_CHUNK_FRAMES;
+            const size_t n = std::min(count, CAPTURE_CHUNK_FRAMES - begin);
+
+            if (m_frames) {
+                std::copy_n(m_frames + first, n, out);
+                for (size_t i = 0; i < n; i++) {
+                    if (out[i].dlc > FRAME_MAX_DATA) out[i].dlc = FRAME_MAX_DATA;
+                }
+            } else {
+                std::copy_n(get_chunk(chunk).get() + begin, n, out);
+            }
+
+            first += n;
+            count -= n;
+            out += n;
+        }
+    }
+
+    bool capturefile::chunk_may_contain(size_t chunk, uint32_t id) const {
+        return chunk < m_chunks.size() && capture_bloom_test(m_chunks[chunk].id_bloom, id);
+    }
+}
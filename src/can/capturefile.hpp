@@ -0,0 +1,236 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_CAPTUREFILE__
+#define __CANARY_CAPTUREFILE__
+
+#include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+#include "../mappedfile.hpp"
+
+namespace canary::can {
+
+    // Binary capture file, append-only:
+    //   capture_header
+    //   frames, grouped into chunks of CAPTURE_CHUNK_FRAMES
+    //   capture_chunk_info for every chunk
+    //   capture_footer
+    // Uncompressed files hold the frame records as-is so they can be used straight from a mapping. Compressed files
+    // (CAPTURE_FLAG_COMPRESSED) store each chunk as a capture_block_header followed by the chunk's records, byte
+    // shuffled so each field is contiguous and then LZ-compressed; chunks are decompressed on access and only the few
+    // most recently used are kept.
+    // The footer is written on close. A file without one (e.g. after a crash) is still readable, its chunk directory is
+    // rebuilt from the data when opened. The header's bus mask is also only filled in on close.
+    constexpr char CAPTURE_MAGIC[8] = {'C', 'A', 'N', 'A', 'R', 'Y', 'C', 'F'};
+    constexpr char CAPTURE_FOOTER_MAGIC[8] = {'C', 'A', 'N', 'A', 'R', 'Y', 'F', 'T'};
+    constexpr uint32_t CAPTURE_VERSION = 1;
+    constexpr uint32_t CAPTURE_CHUNK_FRAMES = 4096;
+    // Written in native byte order, reads back as a different value on a host of the other endianness
+    constexpr uint32_t CAPTURE_BYTE_ORDER_MARK = 0x01020304;
+
+    // Bits for capture_header::flags
+    constexpr uint32_t CAPTURE_FLAG_COMPRESSED = 0x1;
+    // capture_header::bus_mask is filled in, set when the file is closed
+    constexpr uint32_t CAPTURE_FLAG_BUS_MASK = 0x2;
+
+    struct capture_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t record_size;
+        uint32_t chunk_frames;
+        uint32_t flags;
+        // Bit b % 32 of word b / 32 for every bus b with frames in the file
+        uint32_t bus_mask[8];
+        uint8_t reserved[4];
+    };
+
+    // Precedes every chunk in a compressed file
+    struct capture_block_header {
+        uint32_t stored_size;
+        uint32_t frame_count;
+    };
+
+    struct capture_chunk_info {
+        uint64_t first_timestamp;
+        uint64_t last_timestamp;
+        // 256-bit bloom filter of the CAN IDs in the chunk
+        uint64_t id_bloom[4];
+        // Offset of the first record, or of the block header if compressed
+        uint64_t offset;
+        uint32_t frame_count;
+        // Bytes of frame data in the file, excluding the block header
+        uint32_t stored_size;
+    };
+
+    struct capture_footer {
+        uint64_t frame_count;
+        uint64_t directory_offset;
+        uint32_t chunk_count;
+        uint32_t reserved;
+        char magic[8];
+    };
+
+    static_assert(sizeof(capture_header) == 64, "capture_header is part of the file format");
+    static_assert(sizeof(capture_chunk_info) == 64, "capture_chunk_info is part of the file format");
+    static_assert(sizeof(capture_footer) == 32, "capture_footer is part of the file format");
+    static_assert(sizeof(capture_block_header) == 8, "capture_block_header is part of the file format");
+
+    // Adds the ID to a chunk's bloom filter
+    void capture_bloom_add(uint64_t *bloom, uint32_t id);
+
+    [[nodiscard]] bool capture_bloom_test(const uint64_t *bloom, uint32_t id);
+
+    // Writes a capture file
+    class capturewriter {
+    public:
+        ~capturewriter();
+
+        // Returns 0 on success
+        int open(const std::string &path, bool compressed = false);
+
+        int write(const frame *frames, size_t count);
+
+        inline int write(const frame &f) { return write(&f, 1); }
+
+        // Flushes everything written so far to disk (fsync), returns 0 on success. A compressed file only contains
+        // whole chunks, so up to CAPTURE_CHUNK_FRAMES - 1 frames stay buffered until the chunk fills or close().
+        int sync();
+
+        // Writes the chunk directory and footer, returns 0 on success
+        int close();
+
+        [[nodiscard]] inline bool is_open() const { return m_file != nullptr; }
+
+        [[nodiscard]] inline uint64_t get_frame_count() const { return m_frame_count; }
+
+        // Bytes written to the file so far
+        [[nodiscard]] inline uint64_t get_size() const { return m_offset; }
+
+    private:
+        std::FILE *m_file{nullptr};
+        bool m_compressed{false};
+        uint32_t m_flags{0};
+        uint32_t m_bus_mask[8]{};
+        std::vector<capture_chunk_info> m_chunks;
+        uint64_t m_frame_count{0};
+        uint64_t m_offset{0};
+
+        // Compressed only, frames of the chunk being filled
+        std::vector<frame> m_pending;
+        std::vector<uint8_t> m_shuffled;
+        std::vector<uint8_t> m_compressed_buffer;
+
+        int write_bytes(const void *data, size_t len);
+
+        int write_block();
+    };
+
+    // Read-only view of a capture file through a memory mapping, frames are paged in by the OS as they are accessed
+    class capturefile {
+    public:
+        capturefile() = default;
+
+        ~capturefile();
+
+        capturefile(const capturefile &) = delete;
+
+        capturefile &operator=(const capturefile &) = delete;
+
+        inline void set_error_handler(std::function<void(std::string message)> error_handler) {
+            m_error_handler = std::move(error_handler);
+        }
+
+        // Returns 0 on success
+        int open(const std::string &path);
+
+        void close();
+
+        [[nodiscard]] inline size_t size() const { return m_frame_count; }
+
+        // By value, the decoded chunk a compressed frame comes from can be evicted by any later access. Records with
+        // a dlc past FRAME_MAX_DATA (a corrupt file) have it clamped so readers never overrun the payload.
+        [[nodiscard]] inline frame operator[](size_t i) const {
+            if (!m_frames) return get_chunk(i / CAPTURE_CHUNK_FRAMES)[i % CAPTURE_CHUNK_FRAMES];
+
+            frame f = m_frames[i];
+            if (f.dlc > FRAME_MAX_DATA) f.dlc = FRAME_MAX_DATA;
+            return f;
+        }
+
+        // Copies count frames starting at first into out, a chunk at a time for compressed files
+        void read(size_t first, size_t count, frame *out) const;
+
+        [[nodiscard]] inline bool is_compressed() const { return m_frames == nullptr && m_data != nullptr; }
+
+        [[nodiscard]] inline const std::vector<capture_chunk_info> &get_chunks() const { return m_chunks; }
+
+        // Buses with frames in the file, false if the file does not record them (it was not closed cleanly)
+        [[nodiscard]] bool get_buses(std::bitset<256> &buses) const;
+
+        // False if the chunk definitely has no frames with this ID
+        [[nodiscard]] bool chunk_may_contain(size_t chunk, uint32_t id) const;
+
+        [[nodiscard]] inline bool is_open() const { return m_data != nullptr; }
+
+        [[nodiscard]] inline const std::string &get_path() const { return m_path; }
+
+    private:
+        std::string m_path;
+        std::bitset<256> m_buses;
+        bool m_has_buses{false};
+        const uint8_t *m_data{nullptr};
+        size_t m_length{0};
+        canary::mapped_file m_mapping;
+
+        // Uncompressed files only, the records in the mapping
+        const frame *m_frames{nullptr};
+        size_t m_frame_count{0};
+        std::vector<capture_chunk_info> m_chunks;
+
+        // Compressed files only, the most recently used decompressed chunks. Readers hold a chunk by its shared_ptr
+        // while copying out of it, so one evicted by another thread stays valid until they are done.
+        struct decoded_chunk {
+            size_t chunk;
+            std::shared_ptr<const frame[]> frames;
+            uint64_t last_used;
+        };
+
+        // Enough for every filter worker to have a chunk or two in flight, 5 MiB
+        static constexpr size_t DECODED_CHUNK_LIMIT = 16;
+
+        mutable std::vector<decoded_chunk> m_decoded;
+        mutable uint64_t m_decode_clock{0};
+        mutable std::mutex m_decode_mutex;
+
+        std::function<void(std::string message)> m_error_handler{};
+
+        int map_file(const std::string &path);
+
+        void unmap_file();
+
+        // True if the chunk directory read from the footer describes frame_count frames stored before end
+        [[nodiscard]] bool check_directory(uint64_t frame_count, uint64_t end, bool compressed) const;
+
+        // For files without a footer, or with a corrupt one
+        void rebuild_chunks();
+
+        // Walks the blocks before end, decompressing each one only long enough to summarise it
+        void rebuild_compressed_chunks(uint64_t end);
+
+        // Decompresses a block into out, returns false if it is corrupt
+        bool decode_block(const capture_chunk_info &info, frame *out, std::vector<uint8_t> &shuffled) const;
+
+        std::shared_ptr<const frame[]> get_chunk(size_t chunk) const;
+    };
+
+}
+
+#endif
@@ -0,0 +1,212 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "capturemanager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <vector>
+
+#include "socketcand.hpp"
+#include "socketcan.hpp"
+#include "replay.hpp"
+#include "../reactor.hpp"
+
+namespace canary::can {
+    namespace {
+        constexpr int SOCKETCAND_DEFAULT_PORT = 29536;
+        constexpr int READ_TIMEOUT_MS = 500;
+        // How long a lossless source waits before retrying a full queue
+        constexpr int QUEUE_FULL_WAIT_US = 100;
+
+        template<typename T>
+        T param_or(const config::connection &connection, const std::string &key, const T &default_value) {
+            auto it = connection.can_params.find(key);
+            if (it == connection.can_params.end()) {
+                return default_value;
+            }
+            return it->second.template get<T>();
+        }
+    }
+
+    capturemanager::~capturemanager() {
+        stop();
+    }
+
+    std::unique_ptr<packetsource> capturemanager::create_source(const config::connection &connection, uint8_t bus) {
+        if (connection.can_type == "socketcand") {
+            return std::make_unique<socketcand>(param_or<std::string>(connection, "host", "127.0.0.1"),
+                                                param_or<int>(connection, "port", SOCKETCAND_DEFAULT_PORT),
+                                                param_or<std::string>(connection, "interface", "can0"), bus);
+        }
+        if (connection.can_type == "replay") {
+            return std::make_unique<replay>(param_or<std::string>(connection, "path", ""),
+                                            param_or<double>(connection, "speed", 1.0),
+                                            param_or<bool>(connection, "loop", false), bus);
+        }
+#if defined(__linux__)
+        if (connection.can_type == "socketcan") {
+            return std::make_unique<socketcan>(param_or<std::string>(connection, "interface", "can0"), bus);
+        }
+#endif
+        return nullptr;
+    }
+
+    int capturemanager::add_connections(const std::vector<config::connection> &connections) {
+        int added = 0;
+        for (const auto &connection: connections) {
+            if (!connection.enabled) continue;
+
+            auto source = create_source(connection, static_cast<uint8_t>(m_buses.size()));
+            if (!source) {
+                if (m_error_handler) {
+                    m_error_handler(std::format("{}: Unsupported connection type: {}", connection.name,
+                                                connection.can_type));
+                }
+                continue;
+            }
+
+            add_bus(connection.name, std::move(source));
+            added++;
+        }
+        return added;
+    }
+
+    int capturemanager::add_bus(std::string name, std::unique_ptr<packetsource> source) {
+        const size_t first = m_buses.size();
+        const size_t count = source->get_bus_count();
+
+        for (size_t i = 0; i < count; i++) {
+            auto b = std::make_unique<bus>();
+            b->name = count == 1 ? name : std::format("{}:{}", name, i);
+            if (i == 0) {
+                b->source = std::move(source);
+#if defined(__linux__)
+                b->reactor = std::make_unique<canary::reactor>();
+#endif
+            } else {
+                b->fed_by = m_buses[first].get();
+            }
+            b->queue = m_provider.add_queue(packetprovider::DEFAULT_QUEUE_CAPACITY, b->name);
+            m_buses.push_back(std::move(b));
+        }
+        return static_cast<int>(first);
+    }
+
+    void capturemanager::start() {
+        m_running = true;
+        for (auto &b: m_buses) {
+            if (b->fed_by) continue;
+            b->reader = std::thread(&capturemanager::read_bus, this, std::ref(*b));
+        }
+    }
+
+    void capturemanager::stop() {
+        if (!m_running.exchange(false)) return;
+
+        for (auto &b: m_buses) {
+            if (b->fed_by) continue;
+#if defined(__linux__)
+            // Wake the reader straight away rather than waiting for its next timeout
+            b->reactor->stop();
+#endif
+            // Force close if still in connection phase
+            if (!b->source->is_open()) {
+                b->source->close();
+            }
+        }
+
+        for (auto &b: m_buses) {
+            if (b->reader.joinable()) b->reader.join();
+        }
+    }
+
+    int capturemanager::send_frame(size_t bus, const frame &f) {
+        if (bus >= m_buses.size() || !m_buses[bus]->connected) return 1;
+        auto &b = m_buses[bus]->fed_by ? *m_buses[bus]->fed_by : *m_buses[bus];
+        return b.source->send_frame(f);
+    }
+
+    bool capturemanager::is_finished() const {
+        if (m_buses.empty()) return false;
+        return std::all_of(m_buses.begin(), m_buses.end(), [](const auto &b) { return b->finished.load(); });
+    }
+
+    void capturemanager::read_bus(bus &b) {
+        auto &source = *b.source;
+        source.set_error_handler([this, &b](const std::string &msg) {
+            if (m_error_handler) m_error_handler(std::format("{}: {}", b.name, msg));
+        });
+
+        // This bus and the ones it feeds, which frames on their bus index go to
+        std::vector<bus *> fed{&b};
+        for (auto &other: m_buses) {
+            if (other->fed_by == &b) fed.push_back(other.get());
+        }
+
+        if (source.open() != 0) {
+            if (m_error_handler) m_error_handler(std::format("{}: Error connecting", b.name));
+            return;
+        }
+        for (auto *f: fed) f->connected = true;
+
+        const bool lossless = source.is_lossless();
+        frame_handler handle_frame = [this, &b, lossless](const frame &f) {
+            if (m_observer) m_observer(f);
+            bus &target = f.bus < m_buses.size() && m_buses[f.bus]->fed_by == &b ? *m_buses[f.bus] : b;
+            if (lossless) {
+                // Wait for the render thread to catch up rather than drop
+                while (!m_provider.try_enqueue(target.queue, f)) {
+                    if (!m_running) return;
+                    std::this_thread::sleep_for(std::chrono::microseconds(QUEUE_FULL_WAIT_US));
+                }
+            } else {
+                m_provider.enqueue(target.queue, f);
+            }
+            target.frame_count.fetch_add(1, std::memory_order_relaxed);
+        };
+
+        bool source_failed = false;
+        bool use_reactor = false;
+#if defined(__linux__)
+        if (source.get_fd() >= 0 && b.reactor->is_valid()) {
+            use_reactor = b.reactor->add(source.get_fd(), canary::reactor::READABLE,
+                                         [&source, &handle_frame, &source_failed](uint32_t) {
+                                             // Edge-triggered, so read until the source has nothing left
+                                             int n;
+                                             while ((n = source.read_frames(0, handle_frame)) > 0) {}
+                                             if (n < 0) source_failed = true;
+                                         }) == 0;
+        }
+#endif
+
+        while (m_running) {
+            int n;
+#if defined(__linux__)
+            if (use_reactor) {
+                n = b.reactor->run_once(READ_TIMEOUT_MS);
+                if (source_failed) n = -1;
+            } else
+#endif
+            {
+                n = source.read_frames(READ_TIMEOUT_MS, handle_frame);
+            }
+
+            if (n < 0) {
+                if (source.is_finished()) {
+                    for (auto *f: fed) f->finished = true;
+                } else if (m_running && m_error_handler) {
+                    m_error_handler(std::format("{}: Error reading frames", b.name));
+                }
+                break;
+            }
+        }
+
+#if defined(__linux__)
+        if (use_reactor) b.reactor->remove(source.get_fd());
+#endif
+
+        for (auto *f: fed) f->connected = false;
+        source.close();
+    }
+}
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_CAPTUREMANAGER__
+#define __CANARY_CAPTUREMANAGER__
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "packetsource.hpp"
+#include "packetprovider.hpp"
+#include "../config.hpp"
+#include "../reactor.hpp"
+
+namespace canary::can {
+
+    // Captures from any number of buses at once. Each bus gets its own reader thread and its own queue into the
+    // packetprovider, which merges them into one time-ordered stream; frame::bus holds the bus index.
+    class capturemanager {
+    public:
+        struct bus {
+            std::string name;
+            std::unique_ptr<packetsource> source;
+            size_t queue{0};
+            std::thread reader;
+            std::atomic<bool> connected{false};
+            // The source ran out of frames, see packetsource::is_finished()
+            std::atomic<bool> finished{false};
+            std::atomic<uint64_t> frame_count{0};
+            // Set for the extra buses of a source with more than one, which are fed by that source's reader and have no
+            // source of their own
+            bus *fed_by{nullptr};
+#if defined(__linux__)
+            std::unique_ptr<canary::reactor> reactor;
+#endif
+        };
+
+        explicit capturemanager(packetprovider &provider) : m_provider(provider) {};
+
+        ~capturemanager();
+
+        // Creates the packet source for a configured connection, nullptr if the connection type is not supported
+        static std::unique_ptr<packetsource> create_source(const config::connection &connection, uint8_t bus);
+
+        // Adds a bus for every enabled connection, returns the number added
+        int add_connections(const std::vector<config::connection> &connections);
+
+        // Adds a bus for each of the source's buses (see packetsource::get_bus_count()), named name:0, name:1, ... if
+        // there are several. Returns the index of the first.
+        int add_bus(std::string name, std::unique_ptr<packetsource> source);
+
+        // Starts a reader thread per bus
+        void start();
+
+        // Stops and joins all reader threads
+        void stop();
+
+        // Called on the reader threads for every frame, before it is queued. Must be set before start().
+        inline void set_frame_observer(frame_handler observer) { m_observer = std::move(observer); }
+
+        inline void set_error_handler(std::function<void(std::string message)> error_handler) {
+            m_error_handler = std::move(error_handler);
+        }
+
+        int send_frame(size_t bus, const frame &f);
+
+        [[nodiscard]] inline const std::vector<std::unique_ptr<bus>> &get_buses() const { return m_buses; }
+
+        [[nodiscard]] inline bool is_running() const { return m_running.load(std::memory_order_acquire); }
+
+        // True if there are buses and every one has finished, only possible when they are all replays
+        [[nodiscard]] bool is_finished() const;
+
+    private:
+        packetprovider &m_provider;
+        std::vector<std::unique_ptr<bus>> m_buses;
+        std::atomic<bool> m_running{false};
+
+        frame_handler m_observer{};
+        std::function<void(std::string message)> m_error_handler{};
+
+        void read_bus(bus &b);
+    };
+
+}
+
+#endif
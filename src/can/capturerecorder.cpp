@@ -0,0 +1,98 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "capturerecorder.hpp"
+
+#include <chrono>
+#include <format>
+
+namespace canary::can {
+    capturerecorder::~capturerecorder() {
+        stop();
+    }
+
+    int capturerecorder::start(const std::string &path, bool compressed) {
+        stop();
+
+        if (m_writer.open(path, compressed) != 0) {
+            if (m_error_handler) m_error_handler(std::format("Error opening {} for recording", path));
+            return 1;
+        }
+
+        m_path = path;
+        m_frames_written = 0;
+        m_bytes_written = 0;
+        m_dropped = 0;
+
+        m_recording = true;
+        m_thread = std::thread(&capturerecorder::write_loop, this);
+        return 0;
+    }
+
+    void capturerecorder::stop() {
+        {
+            std::lock_guard lk(m_mutex);
+            m_recording = false;
+        }
+        m_wakeup.notify_all();
+
+        // Also joins a writer that stopped itself after an error
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    void capturerecorder::record(std::span<const frame> frames) {
+        if (!is_recording()) return;
+
+        size_t pushed = m_queue.push_batch(frames.data(), frames.size());
+        if (pushed < frames.size()) {
+            m_dropped.fetch_add(frames.size() - pushed, std::memory_order_relaxed);
+        }
+    }
+
+    bool capturerecorder::write_queued() {
+        bool ok = true;
+        m_queue.drain([this, &ok](std::span<const frame> frames) {
+            if (ok && m_writer.write(frames.data(), frames.size()) != 0) {
+                ok = false;
+                return;
+            }
+            m_frames_written.fetch_add(frames.size(), std::memory_order_relaxed);
+        });
+        m_bytes_written.store(m_writer.get_size(), std::memory_order_relaxed);
+        return ok;
+    }
+
+    void capturerecorder::write_loop() {
+        auto last_sync = std::chrono::steady_clock::now();
+
+        std::unique_lock lk(m_mutex);
+        while (m_recording) {
+            m_wakeup.wait_for(lk, std::chrono::milliseconds(WRITE_INTERVAL_MS), [this] {
+                return !m_recording;
+            });
+
+            // Compression and disk writes happen without the lock, record() never takes it anyway
+            lk.unlock();
+            bool ok = write_queued();
+
+            auto now = std::chrono::steady_clock::now();
+            if (ok && now - last_sync >= std::chrono::milliseconds(SYNC_INTERVAL_MS)) {
+                ok = m_writer.sync() == 0;
+                last_sync = now;
+            }
+            lk.lock();
+
+            if (!ok) {
+                if (m_error_handler) m_error_handler(std::format("Error writing to {}, recording stopped", m_path));
+                m_recording = false;
+            }
+        }
+        lk.unlock();
+
+        // Whatever was queued before stop()
+        write_queued();
+        if (m_writer.close() != 0 && m_error_handler) {
+            m_error_handler(std::format("Error closing {}", m_path));
+        }
+        m_bytes_written.store(m_writer.get_size(), std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_CAPTURERECORDER__
+#define __CANARY_CAPTURERECORDER__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+
+#include "frame.hpp"
+#include "capturefile.hpp"
+#include "../spscring.hpp"
+
+namespace canary::can {
+
+    // Streams frames to a capture file on its own thread. record() only copies into a lock-free queue, the writer
+    // thread compresses and writes in batches and syncs to disk every SYNC_INTERVAL_MS, so recording never waits on
+    // the disk.
+    class capturerecorder {
+    public:
+        static constexpr size_t DEFAULT_QUEUE_CAPACITY = 262144;
+        // How often the writer wakes to write queued frames
+        static constexpr int WRITE_INTERVAL_MS = 100;
+        static constexpr int SYNC_INTERVAL_MS = 2000;
+
+        explicit capturerecorder(size_t capacity = DEFAULT_QUEUE_CAPACITY) : m_queue(capacity) {};
+
+        ~capturerecorder();
+
+        inline void set_error_handler(std::function<void(std::string message)> error_handler) {
+            m_error_handler = std::move(error_handler);
+        }
+
+        // Returns 0 on success
+        int start(const std::string &path, bool compressed = true);
+
+        // Writes everything still queued and closes the file
+        void stop();
+
+        // Called from a single producer thread. Frames that don't fit in the queue are dropped and counted.
+        void record(std::span<const frame> frames);
+
+        inline void record(const frame &f) { record(std::span<const frame>(&f, 1)); }
+
+        [[nodiscard]] inline bool is_recording() const { return m_recording.load(std::memory_order_acquire); }
+
+        [[nodiscard]] inline const std::string &get_path() const { return m_path; }
+
+        [[nodiscard]] inline uint64_t get_frames_written() const {
+            return m_frames_written.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] inline uint64_t get_bytes_written() const {
+            return m_bytes_written.load(std::memory_order_relaxed);
+        }
+
+        [[nodiscard]] inline uint64_t get_dropped_count() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        spsc_ring<frame> m_queue;
+        capturewriter m_writer;
+        std::thread m_thread;
+        std::string m_path;
+
+        std::atomic<bool> m_recording{false};
+        std::mutex m_mutex;
+        std::condition_variable m_wakeup;
+
+        std::atomic<uint64_t> m_frames_written{0};
+        std::atomic<uint64_t> m_bytes_written{0};
+        std::atomic<uint64_t> m_dropped{0};
+
+        std::function<void(std::string message)> m_error_handler{};
+
+        void write_loop();
+
+        // Returns false if writing failed
+        bool write_queued();
+    };
+
+}
+
+#endif
@@ -0,0 +1,187 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "diffsearch.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace canary::can {
+    namespace {
+        // Frames copied per read_packets() call by the background update, the render thread waits at most this long
+        // to store new frames
+        constexpr size_t READ_FRAMES = 4096;
+    }
+
+    diffsearch::~diffsearch() {
+        stop_update();
+    }
+
+    const char *diffsearch::condition_name(condition cond) {
+        switch (cond) {
+            case condition::CHANGED:
+                return "Changed";
+            case condition::UNCHANGED:
+                return "Unchanged";
+            case condition::INCREASED:
+                return "Increased";
+            case condition::DECREASED:
+                return "Decreased";
+            case condition::IN_RANGE:
+                return "In range";
+        }
+        return "";
+    }
+
+    void diffsearch::summarise(std::unordered_map<key, byte_summary> &summaries, key k, uint8_t value) {
+        auto [it, inserted] = summaries.try_emplace(k);
+        auto &s = it->second;
+        if (inserted) {
+            s = {k, value, value, value, value, 1, false};
+            return;
+        }
+
+        if (value != s.first) s.changed = true;
+        if (value < s.min) s.min = value;
+        if (value > s.max) s.max = value;
+        s.last = value;
+        s.count++;
+    }
+
+    void diffsearch::summarise(std::unordered_map<key, byte_summary> &summaries, const frame &f) {
+        for (uint8_t b = 0; b < f.dlc; b++) {
+            summarise(summaries, make_key(f.id, b), f.data[b]);
+        }
+    }
+
+    bool diffsearch::add_segment(const packetprovider &provider, size_t begin, size_t end) {
+        if (end - begin < BACKGROUND_UPDATE_MIN) {
+            add_segment(provider.get_received_packets(), begin, end);
+            return true;
+        }
+
+        m_progress.store(0, std::memory_order_relaxed);
+        m_progress_total.store(end - begin, std::memory_order_relaxed);
+        m_updating.store(true, std::memory_order_release);
+        m_worker = std::thread(&diffsearch::background_update, this, std::cref(provider), provider.get_epoch(), begin,
+                               end);
+        return false;
+    }
+
+    bool diffsearch::is_updating() {
+        if (m_updating.load(std::memory_order_acquire)) return true;
+        if (m_worker.joinable()) m_worker.join();
+        return false;
+    }
+
+    float diffsearch::get_progress() const {
+        const size_t total = m_progress_total.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        return std::min(1.0f, static_cast<float>(m_progress.load(std::memory_order_relaxed)) /
+                              static_cast<float>(total));
+    }
+
+    void diffsearch::stop_update() {
+        if (!m_worker.joinable()) return;
+
+        m_cancel.store(true, std::memory_order_relaxed);
+        m_worker.join();
+        m_cancel.store(false, std::memory_order_relaxed);
+        m_updating.store(false, std::memory_order_relaxed);
+    }
+
+    void diffsearch::background_update(const packetprovider &provider, uint64_t epoch, size_t begin, size_t end) {
+        std::unordered_map<key, byte_summary> summaries;
+        std::vector<frame> buffer(READ_FRAMES);
+        size_t pos = begin;
+        while (pos < end && !m_cancel.load(std::memory_order_relaxed)) {
+            const size_t count = provider.read_packets(epoch, pos, std::min(READ_FRAMES, end - pos), buffer.data());
+            // Cleared or replaced, the render thread resets once it sees the new epoch
+            if (count == 0) break;
+
+            for (size_t i = 0; i < count; i++) {
+                summarise(summaries, buffer[i]);
+            }
+            pos += count;
+            m_progress.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        // A segment that was cut short would compare against the wrong frames, leave it out
+        if (pos == end) finish_segment(begin, end, summaries);
+        m_updating.store(false, std::memory_order_release);
+    }
+
+    size_t diffsearch::finish_segment(size_t begin, size_t end, std::unordered_map<key, byte_summary> &summaries) {
+        segment seg{begin, end, {}};
+        seg.bytes.reserve(summaries.size());
+        for (const auto &[k, s]: summaries) {
+            seg.bytes.push_back(s);
+        }
+        std::sort(seg.bytes.begin(), seg.bytes.end(), [](const byte_summary &a, const byte_summary &b) {
+            return a.k < b.k;
+        });
+
+        m_segments.push_back(std::move(seg));
+        return m_segments.size() - 1;
+    }
+
+    bool diffsearch::matches(const byte_summary &s, condition cond, uint8_t lo, uint8_t hi) {
+        switch (cond) {
+            case condition::CHANGED:
+                return s.changed;
+            case condition::UNCHANGED:
+                return !s.changed;
+            case condition::INCREASED:
+                return s.last > s.first;
+            case condition::DECREASED:
+                return s.last < s.first;
+            case condition::IN_RANGE:
+                return s.min >= lo && s.max <= hi;
+        }
+        return false;
+    }
+
+    const std::vector<diffsearch::key> &diffsearch::apply(size_t segment, condition cond, uint8_t lo, uint8_t hi) {
+        stage st{segment, cond, lo, hi, {}};
+
+        if (segment < m_segments.size()) {
+            std::vector<key> matching;
+            for (const auto &s: m_segments[segment].bytes) {
+                if (matches(s, cond, lo, hi)) matching.push_back(s.k);
+            }
+
+            if (m_stages.empty()) {
+                st.candidates = std::move(matching);
+            } else {
+                // Both sides are sorted by key
+                const auto &previous = m_stages.back().candidates;
+                std::set_intersection(previous.begin(), previous.end(), matching.begin(), matching.end(),
+                                      std::back_inserter(st.candidates));
+            }
+        }
+
+        m_stages.push_back(std::move(st));
+        return m_stages.back().candidates;
+    }
+
+    bool diffsearch::undo() {
+        if (m_stages.empty()) return false;
+        m_stages.pop_back();
+        return true;
+    }
+
+    void diffsearch::reset() {
+        stop_update();
+        m_stages.clear();
+        m_segments.clear();
+    }
+
+    const diffsearch::byte_summary *diffsearch::find_summary(size_t segment, key k) const {
+        if (segment >= m_segments.size()) return nullptr;
+
+        const auto &bytes = m_segments[segment].bytes;
+        auto it = std::lower_bound(bytes.begin(), bytes.end(), k, [](const byte_summary &s, key value) {
+            return s.k < value;
+        });
+        return (it != bytes.end() && it->k == k) ? &*it : nullptr;
+    }
+}
@@ -0,0 +1,146 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DIFFSEARCH__
+#define __CANARY_DIFFSEARCH__
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "frame.hpp"
+#include "packetprovider.hpp"
+
+namespace canary::can {
+
+    // Differential search for reverse engineering. The capture is split into segments (e.g. "pedal pressed", "pedal
+    // released"), each summarised per CAN ID and byte position. Each stage keeps the bytes of one segment matching a
+    // condition and intersects them with the previous stage, so the candidates narrow down step by step. Segments and
+    // stages are kept, so undo() steps back without rescanning, and the capture itself is never modified.
+    class diffsearch {
+    public:
+        enum class condition {
+            // Value differs somewhere within the segment
+            CHANGED,
+            UNCHANGED,
+            // Last value in the segment is higher than the first
+            INCREASED,
+            DECREASED,
+            // Every value in the segment is within [lo, hi]
+            IN_RANGE
+        };
+
+        // Candidate key, CAN ID (frame::id without RTR/error flags) in the top bits and byte position in the low 6
+        using key = uint64_t;
+
+        struct byte_summary {
+            key k;
+            uint8_t first;
+            uint8_t last;
+            uint8_t min;
+            uint8_t max;
+            uint32_t count;
+            bool changed;
+        };
+
+        struct segment {
+            // Packet index range [begin, end)
+            size_t begin;
+            size_t end;
+            // Sorted by key
+            std::vector<byte_summary> bytes;
+        };
+
+        struct stage {
+            size_t segment;
+            condition cond;
+            uint8_t lo;
+            uint8_t hi;
+            // Sorted candidates left after this stage
+            std::vector<key> candidates;
+        };
+
+        static inline key make_key(uint32_t id, uint8_t byte) {
+            return (static_cast<key>(id & (FRAME_EXTENDED_FLAG | FRAME_EXTENDED_MASK)) << 6) | (byte & 0x3F);
+        }
+
+        static inline uint32_t key_id(key k) { return static_cast<uint32_t>(k >> 6); }
+
+        static inline uint8_t key_byte(key k) { return static_cast<uint8_t>(k & 0x3F); }
+
+        // Below this many packets, add_segment() with a packetprovider summarises them before returning
+        static constexpr size_t BACKGROUND_UPDATE_MIN = 262144;
+
+        ~diffsearch();
+
+        static const char *condition_name(condition cond);
+
+        // Summarises packets [begin, end) into a new segment and returns its index. Packets is any container with
+        // operator[] returning a frame.
+        template<typename Packets>
+        size_t add_segment(const Packets &packets, size_t begin, size_t end) {
+            std::unordered_map<key, byte_summary> summaries;
+            for (size_t i = begin; i < end; i++) {
+                summarise(summaries, packets[i]);
+            }
+            return finish_segment(begin, end, summaries);
+        }
+
+        // For the render thread, not while is_updating(). Summarises packets [begin, end) into a new segment as above.
+        // If that is BACKGROUND_UPDATE_MIN packets or more it is done on a background thread, reading the packets a
+        // chunk at a time so they can still be stored meanwhile, and the segment is only added once is_updating() is
+        // false. Nothing else may be called until then. Returns false while the background update runs.
+        bool add_segment(const packetprovider &provider, size_t begin, size_t end);
+
+        // Joins the background update once it has finished
+        [[nodiscard]] bool is_updating();
+
+        // Fraction of the background update done
+        [[nodiscard]] float get_progress() const;
+
+        // Keeps the candidates matching cond in the given segment and returns them. lo and hi are only used by
+        // IN_RANGE.
+        const std::vector<key> &apply(size_t segment, condition cond, uint8_t lo = 0, uint8_t hi = 255);
+
+        // Removes the last stage, returns false if there was none
+        bool undo();
+
+        // Removes all stages and segments. Must be called when the packets are cleared, stops the background update
+        // if there is one.
+        void reset();
+
+        // nullptr if the key was not seen in the segment
+        [[nodiscard]] const byte_summary *find_summary(size_t segment, key k) const;
+
+        [[nodiscard]] inline const std::vector<segment> &get_segments() const { return m_segments; }
+
+        [[nodiscard]] inline const std::vector<stage> &get_stages() const { return m_stages; }
+
+    private:
+        std::vector<segment> m_segments;
+        std::vector<stage> m_stages;
+
+        std::thread m_worker;
+        std::atomic<bool> m_updating{false};
+        std::atomic<bool> m_cancel{false};
+        // Packets summarised by the background update, and the packets it has to go through
+        std::atomic<size_t> m_progress{0};
+        std::atomic<size_t> m_progress_total{0};
+
+        void stop_update();
+
+        void background_update(const packetprovider &provider, uint64_t epoch, size_t begin, size_t end);
+
+        static void summarise(std::unordered_map<key, byte_summary> &summaries, key k, uint8_t value);
+
+        static void summarise(std::unordered_map<key, byte_summary> &summaries, const frame &f);
+
+        size_t finish_segment(size_t begin, size_t end, std::unordered_map<key, byte_summary> &summaries);
+
+        static bool matches(const byte_summary &s, condition cond, uint8_t lo, uint8_t hi);
+    };
+
+}
+
+#endif
@@ -0,0 +1,132 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "frame.hpp"
+
+#include <array>
+#include <cstdio>
+#include <cstring>
+
+namespace canary::can {
+    namespace {
+        constexpr char HEX_DIGITS[] = "0123456789ABCDEF";
+
+        // Maps ASCII to its hex digit value, -1 for anything else
+        constexpr auto HEX_VALUES = [] {
+            std::array<int8_t, 256> table{};
+            for (auto &v: table) v = -1;
+            for (int c = '0'; c <= '9'; c++) table[c] = static_cast<int8_t>(c - '0');
+            for (int c = 'A'; c <= 'F'; c++) table[c] = static_cast<int8_t>(c - 'A' + 10);
+            for (int c = 'a'; c <= 'f'; c++) table[c] = static_cast<int8_t>(c - 'a' + 10);
+            return table;
+        }();
+
+        inline int hex_value(char c) {
+            return HEX_VALUES[static_cast<unsigned char>(c)];
+        }
+
+        // Returns the next space separated token and advances pos past it
+        inline std::string_view next_token(std::string_view s, size_t &pos) {
+            while (pos < s.size() && s[pos] == ' ') pos++;
+            size_t start = pos;
+            while (pos < s.size() && s[pos] != ' ') pos++;
+            return s.substr(start, pos - start);
+        }
+    }
+
+    bool parse_socketcand_frame(std::string_view packet, frame &out) {
+        size_t pos = 0;
+        if (next_token(packet, pos) != "<") return false;
+        if (next_token(packet, pos) != "frame") return false;
+
+        auto id_str = next_token(packet, pos);
+        auto time_str = next_token(packet, pos);
+        auto data_str = next_token(packet, pos);
+
+        // Empty payloads have no data token, so the closing bracket comes early
+        if (data_str == ">") {
+            data_str = {};
+        } else if (next_token(packet, pos) != ">") {
+            return false;
+        }
+
+        if (id_str.empty() || id_str.size() > 8 || time_str.empty() || data_str.size() % 2 != 0 ||
+            data_str.size() / 2 > FRAME_MAX_DATA) {
+            return false;
+        }
+
+        uint32_t id = 0;
+        for (char c: id_str) {
+            int v = hex_value(c);
+            if (v < 0) return false;
+            id = (id << 4) | static_cast<uint32_t>(v);
+        }
+
+        // socketcand always sends 3 digits for standard IDs and 8 for extended
+        if (id_str.size() > 3) {
+            id = (id & FRAME_EXTENDED_MASK) | FRAME_EXTENDED_FLAG;
+        }
+
+        // Timestamp is seconds.microseconds
+        uint64_t secs = 0, frac = 0;
+        int frac_digits = 0;
+        bool in_frac = false;
+        for (char c: time_str) {
+            if (c == '.') {
+                if (in_frac) return false;
+                in_frac = true;
+            } else if (c >= '0' && c <= '9') {
+                if (in_frac) {
+                    if (frac_digits < 9) {
+                        frac = frac * 10 + (c - '0');
+                        frac_digits++;
+                    }
+                } else {
+                    secs = secs * 10 + (c - '0');
+                }
+            } else {
+                return false;
+            }
+        }
+        for (; frac_digits < 9; frac_digits++) frac *= 10;
+
+        std::memset(&out, 0, sizeof(out));
+        out.id = id;
+        out.timestamp = secs * 1000000000ULL + frac;
+        out.dlc = static_cast<uint8_t>(data_str.size() / 2);
+        if (out.dlc > 8) out.flags |= FRAME_FD_FLAG;
+
+        for (size_t i = 0; i < out.dlc; i++) {
+            int hi = hex_value(data_str[i * 2]);
+            int lo = hex_value(data_str[i * 2 + 1]);
+            if (hi < 0 || lo < 0) return false;
+            out.data[i] = static_cast<uint8_t>((hi << 4) | lo);
+        }
+
+        return true;
+    }
+
+    size_t format_can_id(const frame &f, char *buf) {
+        uint32_t id = f.can_id();
+        int digits = f.is_extended() ? 8 : 3;
+        for (int i = 0; i < digits; i++) {
+            buf[i] = HEX_DIGITS[(id >> ((digits - 1 - i) * 4)) & 0xF];
+        }
+        buf[digits] = '\0';
+        return digits;
+    }
+
+    size_t format_timestamp(const frame &f, char *buf) {
+        int n = std::snprintf(buf, 32, "%llu.%06llu", static_cast<unsigned long long>(f.timestamp / 1000000000ULL),
+                              static_cast<unsigned long long>((f.timestamp % 1000000000ULL) / 1000ULL));
+        return n < 0 ? 0 : static_cast<size_t>(n);
+    }
+
+    size_t format_data(const frame &f, char *buf) {
+        for (size_t i = 0; i < f.dlc; i++) {
+            buf[i * 2] = HEX_DIGITS[f.data[i] >> 4];
+            buf[i * 2 + 1] = HEX_DIGITS[f.data[i] & 0xF];
+        }
+        buf[f.dlc * 2] = '\0';
+        return f.dlc * 2;
+    }
+}
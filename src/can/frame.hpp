@@ -0,0 +1,72 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_FRAME__
+#define __CANARY_FRAME__
+
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+namespace canary::can {
+
+    // Flag bits stored in the top of frame::id, same layout as Linux SocketCAN
+    constexpr uint32_t FRAME_EXTENDED_FLAG = 0x80000000U;
+    constexpr uint32_t FRAME_RTR_FLAG = 0x40000000U;
+    constexpr uint32_t FRAME_ERROR_FLAG = 0x20000000U;
+
+    constexpr uint32_t FRAME_STANDARD_MASK = 0x000007FFU;
+    constexpr uint32_t FRAME_EXTENDED_MASK = 0x1FFFFFFFU;
+
+    // Bits for frame::flags
+    constexpr uint8_t FRAME_FD_FLAG = 0x01; // CAN FD frame
+    constexpr uint8_t FRAME_BRS_FLAG = 0x02; // CAN FD bit rate switch
+
+    constexpr size_t FRAME_MAX_DATA = 64;
+
+    // Fixed-size binary CAN frame record. Frames are parsed into this once on ingest, so everything after the
+    // transport works on plain integers rather than socketcand text.
+    struct frame {
+        // CAN ID with FRAME_*_FLAG bits
+        uint32_t id;
+        // Index of the interface/connection the frame was received on
+        uint8_t bus;
+        // Payload length in bytes (0-64)
+        uint8_t dlc;
+        uint8_t flags;
+        uint8_t reserved;
+        // Nanoseconds since the Unix epoch
+        uint64_t timestamp;
+        // Payload, bytes past dlc are always zero
+        uint8_t data[FRAME_MAX_DATA];
+
+        [[nodiscard]] inline uint32_t can_id() const {
+            return id & (is_extended() ? FRAME_EXTENDED_MASK : FRAME_STANDARD_MASK);
+        }
+
+        [[nodiscard]] inline bool is_extended() const { return (id & FRAME_EXTENDED_FLAG) != 0; }
+
+        [[nodiscard]] inline bool is_rtr() const { return (id & FRAME_RTR_FLAG) != 0; }
+
+        [[nodiscard]] inline bool is_error() const { return (id & FRAME_ERROR_FLAG) != 0; }
+
+        [[nodiscard]] inline bool is_fd() const { return (flags & FRAME_FD_FLAG) != 0; }
+    };
+
+    static_assert(sizeof(frame) == 80, "frame must stay a fixed-size record");
+
+    // Parses a single socketcand rawmode packet, e.g. "< frame 102CA040 1700000000.123456 0011223344556677 >".
+    // Returns false if the packet is not a frame or is malformed.
+    bool parse_socketcand_frame(std::string_view packet, frame &out);
+
+    // Writes the CAN ID as upper case hex (no prefix), returns the number of characters written. buf must hold 9 chars.
+    size_t format_can_id(const frame &f, char *buf);
+
+    // Writes the timestamp as seconds.microseconds, returns the number of characters written. buf must hold 32 chars.
+    size_t format_timestamp(const frame &f, char *buf);
+
+    // Writes the payload as upper case hex, returns the number of characters written. buf must hold 2 * dlc + 1 chars.
+    size_t format_data(const frame &f, char *buf);
+
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "framestore.hpp"
+
+#include <algorithm>
+
+namespace canary::can {
+    void framestore::push_back(const frame &f) {
+        if (m_size == m_slots.size() * CHUNK_FRAMES) {
+            if (m_memory_budget > 0) spill_chunks();
+
+            // Left uninitialised, frames are written before they are read
+            auto memory = std::unique_ptr<chunk>(new chunk);
+            const frame *frames = memory->frames;
+            m_slots.push_back({std::move(memory), frames});
+            m_resident_chunks++;
+        }
+        m_slots.back().memory->frames[m_size % CHUNK_FRAMES] = f;
+        m_size++;
+    }
+
+    void framestore::spill_chunks() {
+        // Every resident chunk is full here, the new tail chunk is about to be added
+        while (!m_spill_failed && m_first_resident < m_slots.size() &&
+               (m_resident_chunks + 1) * sizeof(chunk) > m_memory_budget) {
+            auto &s = m_slots[m_first_resident];
+            const frame *spilled = m_spill.spill(s.memory->frames, CHUNK_FRAMES);
+            if (!spilled) {
+                // Keep everything in memory rather than lose frames
+                m_spill_failed = true;
+                if (m_error_handler) m_error_handler("Could not write to the spill file, capture is no longer bounded");
+                return;
+            }
+
+            s.frames = spilled;
+            s.memory.reset();
+            m_resident_chunks--;
+            m_first_resident++;
+        }
+    }
+
+    void framestore::clear() {
+        m_file.reset();
+        m_file_frames = 0;
+        m_slots.clear();
+        m_size = 0;
+        m_resident_chunks = 0;
+        m_first_resident = 0;
+        m_spill.close();
+        m_spill_failed = false;
+        m_epoch++;
+    }
+
+    int framestore::open_file(const std::string &path, std::function<void(std::string message)> error_handler) {
+        auto file = std::make_unique<capturefile>();
+        file->set_error_handler(std::move(error_handler));
+        if (file->open(path) != 0) {
+            return 1;
+        }
+
+        clear();
+        m_file_frames = file->size();
+        m_file = std::move(file);
+        return 0;
+    }
+
+    int framestore::save_file(const std::string &path) const {
+        // Truncating the file would pull it out from under the mapping
+        if (m_file && m_file->get_path() == path) {
+            return 1;
+        }
+
+        capturewriter writer;
+        if (writer.open(path) != 0) {
+            return 1;
+        }
+
+        // The file part first, copied out a chunk at a time as it may be compressed, then each chunk as one write
+        if (m_file_frames > 0) {
+            std::vector<frame> buffer(CHUNK_FRAMES);
+            for (size_t i = 0; i < m_file_frames; i += CHUNK_FRAMES) {
+                size_t count = std::min(CHUNK_FRAMES, m_file_frames - i);
+                m_file->read(i, count, buffer.data());
+                if (writer.write(buffer.data(), count) != 0) return 1;
+            }
+        }
+        for (size_t c = 0; c < m_slots.size(); c++) {
+            size_t count = std::min(CHUNK_FRAMES, m_size - c * CHUNK_FRAMES);
+            if (writer.write(m_slots[c].frames, count) != 0) return 1;
+        }
+
+        return writer.close();
+    }
+}
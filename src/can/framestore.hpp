@@ -0,0 +1,109 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_FRAMESTORE__
+#define __CANARY_FRAMESTORE__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame.hpp"
+#include "capturefile.hpp"
+#include "spillfile.hpp"
+
+namespace canary::can {
+
+    // All frames in the current capture. An opened capture file is accessed through its mapping, frames received
+    // after it are appended to fixed-size chunks so growing the store never copies existing frames. Once the chunks
+    // in memory exceed the memory budget the oldest full ones are moved to a spill file and read back through its
+    // mapping, so only the recent tail stays resident. Indices are stable until clear() or open_file(). Frames are
+    // returned by value as those from a compressed file only live in its small cache of decoded chunks.
+    class framestore {
+    public:
+        static constexpr size_t CHUNK_FRAMES = CAPTURE_CHUNK_FRAMES;
+
+        framestore() = default;
+
+        // Could be gigabytes, pass it by reference
+        framestore(const framestore &) = delete;
+
+        framestore &operator=(const framestore &) = delete;
+
+        [[nodiscard]] inline size_t size() const { return m_file_frames + m_size; }
+
+        [[nodiscard]] inline bool empty() const { return size() == 0; }
+
+        [[nodiscard]] inline frame operator[](size_t i) const {
+            if (i < m_file_frames) return (*m_file)[i];
+            i -= m_file_frames;
+            return m_slots[i / CHUNK_FRAMES].frames[i % CHUNK_FRAMES];
+        }
+
+        void push_back(const frame &f);
+
+        void clear();
+
+        // Replaces the contents with a capture file, returns 0 on success
+        int open_file(const std::string &path, std::function<void(std::string message)> error_handler = {});
+
+        // Writes every frame to a capture file, returns 0 on success. Fails if path is the open capture file.
+        int save_file(const std::string &path) const;
+
+        // nullptr if no file is open
+        [[nodiscard]] inline const capturefile *get_file() const { return m_file.get(); }
+
+        // Bytes of received frames kept in memory, 0 for no limit. Takes effect as the next chunk fills. Only the
+        // frames themselves count, the structures built over them (packetfilter rows, searchindex lists, dbcbatch
+        // columns) stay in memory on top of the budget.
+        inline void set_memory_budget(size_t bytes) { m_memory_budget = bytes; }
+
+        [[nodiscard]] inline size_t get_memory_budget() const { return m_memory_budget; }
+
+        [[nodiscard]] inline size_t get_resident_bytes() const { return m_resident_chunks * sizeof(chunk); }
+
+        [[nodiscard]] inline uint64_t get_spilled_bytes() const { return m_spill.get_size(); }
+
+        inline void set_error_handler(std::function<void(std::string message)> error_handler) {
+            m_error_handler = std::move(error_handler);
+        }
+
+        // Changes whenever existing indices become invalid (clear or open)
+        [[nodiscard]] inline uint64_t get_epoch() const { return m_epoch; }
+
+    private:
+        struct chunk {
+            frame frames[CHUNK_FRAMES];
+        };
+
+        std::unique_ptr<capturefile> m_file;
+        size_t m_file_frames{0};
+
+        // frames points into memory while the chunk is resident, or into the spill file mapping once spilled
+        struct slot {
+            std::unique_ptr<chunk> memory;
+            const frame *frames;
+        };
+
+        std::vector<slot> m_slots;
+        // Frames in m_slots
+        size_t m_size{0};
+
+        size_t m_memory_budget{0};
+        size_t m_resident_chunks{0};
+        // Chunks are spilled oldest first, everything before this has been
+        size_t m_first_resident{0};
+        spillfile m_spill;
+        bool m_spill_failed{false};
+
+        uint64_t m_epoch{0};
+
+        std::function<void(std::string message)> m_error_handler{};
+
+        void spill_chunks();
+    };
+
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "packetfilter.hpp"
+
+namespace canary::can {
+    namespace {
+        bool is_standard(uint32_t id) {
+            return (id & FRAME_EXTENDED_FLAG) == 0;
+        }
+    }
+
+    void packetfilter::add_id(uint32_t id) {
+        if (is_standard(id)) {
+            m_standard_ids.set(id & FRAME_STANDARD_MASK);
+        } else {
+            m_extended_ids.insert(id & FRAME_EXTENDED_MASK);
+        }
+        m_generation++;
+    }
+
+    void packetfilter::remove_id(uint32_t id) {
+        if (is_standard(id)) {
+            m_standard_ids.reset(id & FRAME_STANDARD_MASK);
+        } else {
+            m_extended_ids.erase(id & FRAME_EXTENDED_MASK);
+        }
+        m_generation++;
+    }
+
+    void packetfilter::clear() {
+        m_standard_ids.reset();
+        m_extended_ids.clear();
+        m_generation++;
+    }
+
+    bool packetfilter::contains(uint32_t id) const {
+        if (is_standard(id)) {
+            return m_standard_ids.test(id & FRAME_STANDARD_MASK);
+        }
+        return m_extended_ids.contains(id & FRAME_EXTENDED_MASK);
+    }
+
+    std::vector<uint32_t> packetfilter::get_ids() const {
+        std::vector<uint32_t> ids;
+        ids.reserve(m_standard_ids.count() + m_extended_ids.size());
+
+        for (uint32_t id = 0; id <= FRAME_STANDARD_MASK; id++) {
+            if (m_standard_ids.test(id)) ids.push_back(id);
+        }
+
+        size_t first_extended = ids.size();
+        for (uint32_t id: m_extended_ids) {
+            ids.push_back(FRAME_EXTENDED_FLAG | id);
+        }
+        std::sort(ids.begin() + static_cast<std::ptrdiff_t>(first_extended), ids.end());
+
+        return ids;
+    }
+
+    std::vector<bool> packetfilter::skippable_chunks(const framestore &packets) const {
+        const capturefile *file = packets.get_file();
+        if (!m_enabled || m_mode != mode::INCLUDE || !file) return {};
+
+        const size_t id_count = m_standard_ids.count() + m_extended_ids.size();
+        if (id_count > CHUNK_SKIP_MAX_IDS) return {};
+        const std::vector<uint32_t> ids = get_ids();
+
+        // Only whole chunks of the file, a partial last one also holds frames received after it was opened
+        std::vector<bool> skip(file->size() / framestore::CHUNK_FRAMES);
+        for (size_t chunk = 0; chunk < skip.size(); chunk++) {
+            skip[chunk] = std::none_of(ids.begin(), ids.end(), [file, chunk](uint32_t id) {
+                return file->chunk_may_contain(chunk, id);
+            });
+        }
+        return skip;
+    }
+
+    void packetfilter::set_mode(mode m) {
+        if (m == m_mode) return;
+        m_mode = m;
+        m_generation++;
+    }
+
+    void packetfilter::set_enabled(bool enabled) {
+        if (enabled == m_enabled) return;
+        m_enabled = enabled;
+        m_generation++;
+    }
+}
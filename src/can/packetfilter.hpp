@@ -0,0 +1,155 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_PACKETFILTER__
+#define __CANARY_PACKETFILTER__
+
+#include <algorithm>
+#include <bitset>
+#include <cstdint>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "frame.hpp"
+#include "framestore.hpp"
+
+namespace canary::can {
+
+    // Software filter on CAN IDs. Standard IDs are kept in a 2048-bit bitset and extended IDs in a hash set, so a
+    // check is a single lookup on the numeric ID.
+    class packetfilter {
+    public:
+        enum class mode {
+            // Hide frames whose ID is in the set
+            EXCLUDE,
+            // Only show frames whose ID is in the set
+            INCLUDE
+        };
+
+        // Indices of packets that pass the filter. Kept up to date by update_view(), which only looks at packets
+        // received since the last call unless the filter changed.
+        struct view {
+            std::vector<uint32_t> rows;
+            // Number of packets already considered
+            size_t scanned = 0;
+            uint64_t generation = UINT64_MAX;
+        };
+
+        // Below this many packets a rebuild is done on the calling thread
+        static constexpr size_t PARALLEL_REBUILD_MIN = 65536;
+
+        // Up to this many IDs an INCLUDE rebuild checks them against the chunk index of an opened capture file and
+        // skips the chunks that cannot have any. With more the 256-bit bloom filters let nearly every chunk through.
+        static constexpr size_t CHUNK_SKIP_MAX_IDS = 32;
+
+        // id is a frame::id, flags other than FRAME_EXTENDED_FLAG are ignored
+        void add_id(uint32_t id);
+
+        void remove_id(uint32_t id);
+
+        void clear();
+
+        [[nodiscard]] bool contains(uint32_t id) const;
+
+        // Sorted IDs in the set, for display
+        [[nodiscard]] std::vector<uint32_t> get_ids() const;
+
+        void set_mode(mode m);
+
+        [[nodiscard]] inline mode get_mode() const { return m_mode; }
+
+        void set_enabled(bool enabled);
+
+        [[nodiscard]] inline bool is_enabled() const { return m_enabled; }
+
+        // Changes every time the filter does, views built for an older generation are rebuilt
+        [[nodiscard]] inline uint64_t get_generation() const { return m_generation; }
+
+        [[nodiscard]] inline bool matches(const frame &f) const {
+            if (!m_enabled) return true;
+            return contains(f.id) == (m_mode == mode::INCLUDE);
+        }
+
+        // Packets is any container with size() and operator[] returning a frame
+        template<typename Packets>
+        void update_view(view &v, const Packets &packets) const {
+            if (v.generation != m_generation || packets.size() < v.scanned) {
+                rebuild_view(v, packets);
+                return;
+            }
+
+            for (size_t i = v.scanned; i < packets.size(); i++) {
+                if (matches(packets[i])) v.rows.push_back(static_cast<uint32_t>(i));
+            }
+            v.scanned = packets.size();
+        }
+
+    private:
+        std::bitset<FRAME_STANDARD_MASK + 1> m_standard_ids;
+        std::unordered_set<uint32_t> m_extended_ids;
+        mode m_mode{mode::EXCLUDE};
+        bool m_enabled{true};
+        uint64_t m_generation{0};
+
+        // Chunks of framestore::CHUNK_FRAMES packets with none of the packets this filter lets through, only known
+        // for the part of a framestore that is an opened capture file
+        template<typename Packets>
+        std::vector<bool> skippable_chunks(const Packets &) const { return {}; }
+
+        std::vector<bool> skippable_chunks(const framestore &packets) const;
+
+        // Splits the packets between worker threads, each filters its own range and the results are joined in order
+        template<typename Packets>
+        void rebuild_view(view &v, const Packets &packets) const {
+            const size_t count = packets.size();
+            v.rows.clear();
+            v.generation = m_generation;
+            v.scanned = count;
+
+            const std::vector<bool> skip = skippable_chunks(packets);
+            const auto scan = [this, &packets, &skip](size_t begin, size_t end, std::vector<uint32_t> &out) {
+                for (size_t i = begin; i < end; i++) {
+                    const size_t chunk = i / framestore::CHUNK_FRAMES;
+                    if (chunk < skip.size() && skip[chunk]) {
+                        // Straight to the last packet of the chunk, the loop moves on to the next one
+                        i = std::min(end, (chunk + 1) * framestore::CHUNK_FRAMES) - 1;
+                        continue;
+                    }
+                    if (matches(packets[i])) out.push_back(static_cast<uint32_t>(i));
+                }
+            };
+
+            size_t workers = std::max(1u, std::thread::hardware_concurrency());
+            if (count < PARALLEL_REBUILD_MIN || workers == 1) {
+                scan(0, count, v.rows);
+                return;
+            }
+
+            const size_t per_worker = (count + workers - 1) / workers;
+            std::vector<std::vector<uint32_t>> parts(workers);
+            std::vector<std::thread> threads;
+            threads.reserve(workers);
+
+            for (size_t w = 0; w < workers; w++) {
+                threads.emplace_back([&scan, &parts, w, per_worker, count] {
+                    size_t begin = std::min(count, w * per_worker);
+                    scan(begin, std::min(count, begin + per_worker), parts[w]);
+                });
+            }
+
+            size_t total = 0;
+            for (size_t w = 0; w < workers; w++) {
+                threads[w].join();
+                total += parts[w].size();
+            }
+
+            v.rows.reserve(total);
+            for (const auto &part: parts) {
+                v.rows.insert(v.rows.end(), part.begin(), part.end());
+            }
+        }
+    };
+
+}
+
+#endif
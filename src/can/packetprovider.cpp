@@ -2,16 +2,228 @@
 
 #include "packetprovider.hpp"
 
+#include <algorithm>
+#include <chrono>
+
 namespace canary::can {
-    const std::vector<std::string> &packetprovider::get_received_packets() {
+    namespace {
+        // Frame timestamps from another clock (e.g. a socketcand device) can be slightly ahead of ours
+        inline uint64_t latency(uint64_t now, uint64_t timestamp) {
+            return now > timestamp ? now - timestamp : 0;
+        }
+
+        inline uint64_t steady_now() {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+    }
+
+    const framestore &packetprovider::get_received_packets() const {
         return received_packets;
     }
 
-    void packetprovider::add_packet(const std::string &packet) {
+    size_t packetprovider::read_packets(uint64_t epoch, size_t first, size_t count, frame *out) const {
+        std::lock_guard lk(m_packets_mutex);
+        if (received_packets.get_epoch() != epoch || first >= received_packets.size()) return 0;
+
+        count = std::min(count, received_packets.size() - first);
+        for (size_t i = 0; i < count; i++) {
+            out[i] = received_packets[first + i];
+        }
+        return count;
+    }
+
+    void packetprovider::add_packet(const frame &packet) {
+        std::lock_guard lk(m_packets_mutex);
         received_packets.push_back(packet);
     }
 
     void packetprovider::clear_packets() {
+        std::lock_guard lk(m_packets_mutex);
         received_packets.clear();
+        m_rendered = 0;
+    }
+
+    int packetprovider::open_capture(const std::string &path, std::function<void(std::string message)> error_handler) {
+        std::lock_guard lk(m_packets_mutex);
+        int res = received_packets.open_file(path, std::move(error_handler));
+        // Frames from a file were never live, they do not count as rendered late
+        m_rendered = received_packets.size();
+        return res;
+    }
+
+    int packetprovider::save_capture(const std::string &path) const {
+        return received_packets.save_file(path);
+    }
+
+    int packetprovider::start_recording(const std::string &path, bool compressed,
+                                        std::function<void(std::string message)> error_handler) {
+        m_recorder.set_error_handler(std::move(error_handler));
+        return m_recorder.start(path, compressed);
+    }
+
+    void packetprovider::stop_recording() {
+        m_recorder.stop();
+    }
+
+    size_t packetprovider::add_queue(size_t capacity, std::string name) {
+        auto queue = std::make_unique<ingest_queue>(capacity);
+        queue->stats.name = name.empty() ? "Queue " + std::to_string(m_queues.size()) : std::move(name);
+        queue->stats.capacity = queue->ring.capacity();
+        m_queues.push_back(std::move(queue));
+        return m_queues.size() - 1;
+    }
+
+    bool packetprovider::push(ingest_queue &queue, const frame &packet) {
+        if (!queue.ring.push(packet)) return false;
+
+        const uint64_t frames = queue.stats.frames.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (frames % LATENCY_SAMPLE_INTERVAL == 0) {
+            queue.stats.received.record(latency(timestamp_now(), packet.timestamp));
+        }
+        return true;
+    }
+
+    bool packetprovider::enqueue(size_t queue, const frame &packet) {
+        auto &q = *m_queues[queue];
+        if (!push(q, packet)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            q.stats.dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool packetprovider::try_enqueue(size_t queue, const frame &packet) {
+        return push(*m_queues[queue], packet);
+    }
+
+    void packetprovider::store(const frame &f, uint64_t now) {
+        received_packets.push_back(f);
+        m_stats.stored.record(latency(now, f.timestamp));
+    }
+
+    size_t packetprovider::poll() {
+        const uint64_t now = timestamp_now();
+
+        for (auto &queue: m_queues) {
+            const size_t waiting = queue->ring.size();
+            if (waiting > queue->stats.high_water.load(std::memory_order_relaxed)) {
+                queue->stats.high_water.store(waiting, std::memory_order_relaxed);
+            }
+        }
+
+        std::lock_guard lk(m_packets_mutex);
+        if (m_queues.size() == 1) {
+            // Single bus, already in order
+            size_t stored = m_queues[0]->ring.drain([this, now](std::span<const frame> frames) {
+                for (const auto &f: frames) {
+                    store(f, now);
+                }
+                m_recorder.record(frames);
+            });
+            m_stats.stored_frames.fetch_add(stored, std::memory_order_relaxed);
+            return stored;
+        }
+
+        const uint64_t steady = steady_now();
+        size_t drained = 0;
+        for (auto &queue: m_queues) {
+            drained += queue->ring.drain([this, &queue, steady](std::span<const frame> frames) {
+                queue->pending.insert(queue->pending.end(), frames.begin(), frames.end());
+                queue->pending_since.insert(queue->pending_since.end(), frames.size(), steady);
+                m_newest_timestamp = std::max(m_newest_timestamp, frames.back().timestamp);
+            });
+        }
+
+        // Once the buses go quiet there is nothing left to wait for, so flush everything
+        uint64_t watermark = UINT64_MAX;
+        if (drained > 0) {
+            watermark = m_newest_timestamp > REORDER_WINDOW_NS ? m_newest_timestamp - REORDER_WINDOW_NS : 0;
+        }
+
+        // A bus whose clock runs ahead of the others would otherwise hold its frames for as long as they stay busy
+        const uint64_t held_since = steady > REORDER_WINDOW_NS ? steady - REORDER_WINDOW_NS : 0;
+
+        size_t stored = merge_pending(watermark, held_since, now);
+        m_stats.stored_frames.fetch_add(stored, std::memory_order_relaxed);
+        return stored;
+    }
+
+    size_t packetprovider::flush() {
+        size_t stored = poll();
+        if (m_queues.size() > 1) {
+            std::lock_guard lk(m_packets_mutex);
+            // Nothing else is coming to be ordered before them
+            const size_t merged = merge_pending(UINT64_MAX, 0, timestamp_now());
+            m_stats.stored_frames.fetch_add(merged, std::memory_order_relaxed);
+            stored += merged;
+        }
+        return stored;
+    }
+
+    void packetprovider::mark_rendered() {
+        const size_t count = received_packets.size();
+        if (m_rendered > count) {
+            // Cleared since the last call
+            m_rendered = count;
+            return;
+        }
+
+        const uint64_t now = timestamp_now();
+        for (size_t i = m_rendered; i < count; i++) {
+            m_stats.rendered.record(latency(now, received_packets[i].timestamp));
+        }
+        m_stats.rendered_frames.fetch_add(count - m_rendered, std::memory_order_relaxed);
+        m_rendered = count;
+    }
+
+    void packetprovider::reset_stats() {
+        for (auto &queue: m_queues) {
+            queue->stats.received.reset();
+            queue->stats.frames.store(0, std::memory_order_relaxed);
+            queue->stats.dropped.store(0, std::memory_order_relaxed);
+            queue->stats.high_water.store(0, std::memory_order_relaxed);
+        }
+        m_dropped.store(0, std::memory_order_relaxed);
+        m_stats.stored.reset();
+        m_stats.rendered.reset();
+        m_stats.stored_frames.store(0, std::memory_order_relaxed);
+        m_stats.rendered_frames.store(0, std::memory_order_relaxed);
+        m_stats.since = std::chrono::steady_clock::now();
+    }
+
+    size_t packetprovider::merge_pending(uint64_t watermark, uint64_t held_since, uint64_t now) {
+        size_t merged = 0;
+
+        // k-way merge, there are only ever a handful of buses so a linear scan for the oldest front is fine
+        while (true) {
+            ingest_queue *oldest = nullptr;
+            for (auto &queue: m_queues) {
+                if (queue->pending_pos >= queue->pending.size()) continue;
+
+                const auto &front = queue->pending[queue->pending_pos];
+                if (front.timestamp > watermark && queue->pending_since[queue->pending_pos] > held_since) continue;
+
+                if (!oldest || front.timestamp < oldest->pending[oldest->pending_pos].timestamp) {
+                    oldest = queue.get();
+                }
+            }
+
+            if (!oldest) break;
+
+            const auto &f = oldest->pending[oldest->pending_pos++];
+            store(f, now);
+            m_recorder.record(f);
+            merged++;
+        }
+
+        for (auto &queue: m_queues) {
+            queue->pending.erase(queue->pending.begin(), queue->pending.begin() + queue->pending_pos);
+            queue->pending_since.erase(queue->pending_since.begin(), queue->pending_since.begin() + queue->pending_pos);
+            queue->pending_pos = 0;
+        }
+
+        return merged;
     }
 }
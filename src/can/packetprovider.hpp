@@ -4,20 +4,139 @@
 #define __CANARY_PACKETPROVIDER__
 
 #include <vector>
+#include <span>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
 
+#include "frame.hpp"
+#include "framestore.hpp"
+#include "capturerecorder.hpp"
+#include "pipelinestats.hpp"
+#include "../spscring.hpp"
+
 namespace canary::can {
 
     class packetprovider {
     public:
-        const std::vector<std::string> &get_received_packets();
+        static constexpr size_t DEFAULT_QUEUE_CAPACITY = 65536;
+
+        // Frames from different buses are held back this long (by timestamp) so they can be merged in order. Buses can
+        // be on different clocks (socketcand frames carry the device's), so a frame is also released once it has
+        // been waiting this long in real time, whatever the other buses' timestamps say.
+        static constexpr uint64_t REORDER_WINDOW_NS = 50000000;
+
+        // Queue latency is sampled every this many frames, reading the clock for every frame costs more than the
+        // enqueue itself
+        static constexpr uint64_t LATENCY_SAMPLE_INTERVAL = 16;
+
+        // For the thread that polls, which is the only one storing frames
+        const framestore &get_received_packets() const;
 
-        void add_packet(const std::string &packet);
+        // For any other thread: copies up to count received packets from first into out while no frames are being
+        // stored, and returns the number copied. 0 once the packets have been cleared or replaced since epoch.
+        size_t read_packets(uint64_t epoch, size_t first, size_t count, frame *out) const;
+
+        void add_packet(const frame &packet);
 
         void clear_packets();
 
+        // Replaces the received packets with a capture file, returns 0 on success
+        int open_capture(const std::string &path, std::function<void(std::string message)> error_handler = {});
+
+        // Returns 0 on success
+        int save_capture(const std::string &path) const;
+
+        // Received frames beyond this many bytes are spilled to a temporary file, 0 for no limit
+        inline void set_memory_budget(size_t bytes,
+                                      std::function<void(std::string message)> error_handler = {}) {
+            received_packets.set_memory_budget(bytes);
+            if (error_handler) received_packets.set_error_handler(std::move(error_handler));
+        }
+
+        // Streams every frame polled from now on to a capture file on a background thread, returns 0 on success
+        int start_recording(const std::string &path, bool compressed = true,
+                            std::function<void(std::string message)> error_handler = {});
+
+        void stop_recording();
+
+        [[nodiscard]] inline const capturerecorder &get_recorder() const { return m_recorder; }
+
+        // Changes when the received packets are cleared or replaced, anything holding packet indices must start again
+        [[nodiscard]] inline uint64_t get_epoch() const { return received_packets.get_epoch(); }
+
+        // Creates a queue for one producer thread (normally one per bus) and returns its index. All queues must be
+        // added before any producer starts.
+        size_t add_queue(size_t capacity = DEFAULT_QUEUE_CAPACITY, std::string name = {});
+
+        // Called from the producer thread owning the queue. Never blocks, returns false and counts a drop if the queue
+        // is full.
+        bool enqueue(size_t queue, const frame &packet);
+
+        // As enqueue, but a full queue is not counted as a drop, for producers that retry
+        bool try_enqueue(size_t queue, const frame &packet);
+
+        // Called from the render thread once per frame (or the headless loop). Moves queued frames into the packet
+        // store, merging queues by timestamp, and returns the number of frames added.
+        size_t poll();
+
+        // Called once every producer has stopped. Polls a last time and then merges everything the reorder window
+        // was holding back, so no frame is left behind when the recording is closed. Returns the number of frames
+        // added.
+        size_t flush();
+
+        // Called from the render thread once a frame has been drawn, records how long the frames stored since the
+        // last call took to reach the screen
+        void mark_rendered();
+
+        [[nodiscard]] inline size_t get_queue_count() const { return m_queues.size(); }
+
+        [[nodiscard]] inline const queue_stats &get_queue_stats(size_t queue) const { return m_queues[queue]->stats; }
+
+        [[nodiscard]] inline const pipeline_stats &get_stats() const { return m_stats; }
+
+        // Clears every latency histogram and counter, including the drop counts
+        void reset_stats();
+
+        [[nodiscard]] inline uint64_t get_dropped_count() const {
+            return m_dropped.load(std::memory_order_relaxed);
+        }
+
     private:
-        std::vector<std::string> received_packets;
+        struct ingest_queue {
+            explicit ingest_queue(size_t capacity) : ring(capacity) {};
+
+            spsc_ring<frame> ring;
+            // Frames drained from the ring but not yet merged, and when each was drained (steady clock)
+            std::vector<frame> pending;
+            std::vector<uint64_t> pending_since;
+            size_t pending_pos{0};
+
+            queue_stats stats;
+        };
+
+        framestore received_packets;
+        // Held while received_packets changes, so read_packets() can run alongside
+        mutable std::mutex m_packets_mutex;
+
+        capturerecorder m_recorder;
+
+        std::vector<std::unique_ptr<ingest_queue>> m_queues;
+        uint64_t m_newest_timestamp{0};
+        std::atomic<uint64_t> m_dropped{0};
+
+        pipeline_stats m_stats;
+        // Packet index up to which frames have been rendered
+        size_t m_rendered{0};
+
+        // Pushes onto the queue and updates its stats, false if the queue is full
+        bool push(ingest_queue &queue, const frame &packet);
+
+        void store(const frame &f, uint64_t now);
+
+        // Merges pending frames with timestamps up to watermark, and any drained at or before held_since
+        size_t merge_pending(uint64_t watermark, uint64_t held_since, uint64_t now);
     };
 
 }
@@ -0,0 +1,61 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_PACKETSOURCE__
+#define __CANARY_PACKETSOURCE__
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <functional>
+
+#include "frame.hpp"
+
+namespace canary::can {
+
+    using frame_handler = std::function<void(const frame &)>;
+
+    // Common interface for anything frames can be captured from, e.g. a socketcand server or a local CAN interface
+    class packetsource {
+    public:
+        virtual ~packetsource() = default;
+
+        inline void set_error_handler(std::function<void(std::string message)> error_handler) {
+            m_error_handler = std::move(error_handler);
+        }
+
+        // Returns 0 on success
+        virtual int open() = 0;
+
+        // Waits up to timeout_ms for frames and passes each one received to on_frame. Returns the number of frames
+        // read, 0 on timeout, or -1 if the source failed or was closed.
+        virtual int read_frames(int timeout_ms, const frame_handler &on_frame) = 0;
+
+        // Returns 0 on success
+        virtual int send_frame(const frame &f) = 0;
+
+        virtual void close() = 0;
+
+        [[nodiscard]] virtual bool is_open() const = 0;
+
+        // Descriptor that becomes readable when frames are waiting, for use with canary::reactor. -1 if the source
+        // cannot be waited on this way.
+        [[nodiscard]] virtual int get_fd() const { return -1; }
+
+        // True if the source can be held up while the capture queue is full instead of dropping frames, e.g. a replay.
+        // Live sources must never be.
+        [[nodiscard]] virtual bool is_lossless() const { return false; }
+
+        // True once a finite source has passed on every frame, read_frames then returns -1
+        [[nodiscard]] virtual bool is_finished() const { return false; }
+
+        // Number of consecutive buses the frames come in on, starting at the bus the source was created for, e.g. more
+        // than one for a replay of several buses. Called before open().
+        [[nodiscard]] virtual size_t get_bus_count() { return 1; }
+
+    protected:
+        std::function<void(std::string message)> m_error_handler{};
+    };
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "pipelinestats.hpp"
+
+#include <bit>
+#include <cstdio>
+
+namespace canary::can {
+    size_t latency_histogram::bucket_of(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return static_cast<size_t>(ns);
+
+        // Keep the top SUB_BUCKET_BITS + 1 bits, the leading one picks the row and the rest the bucket within it
+        const int shift = std::bit_width(ns) - SUB_BUCKET_BITS - 1;
+        return (static_cast<size_t>(shift) + 1) * SUB_BUCKETS + static_cast<size_t>((ns >> shift) - SUB_BUCKETS);
+    }
+
+    uint64_t latency_histogram::bucket_upper(size_t bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+
+        const size_t shift = bucket / SUB_BUCKETS - 1;
+        const uint64_t sub = bucket % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void latency_histogram::reset() {
+        for (auto &b: m_buckets) b.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    double latency_histogram::get_mean() const {
+        const uint64_t count = get_count();
+        return count == 0 ? 0.0 : static_cast<double>(m_sum.load(std::memory_order_relaxed)) / count;
+    }
+
+    uint64_t latency_histogram::percentile(double p) const {
+        // Sum the buckets rather than trusting m_count, which may be mid-update
+        uint64_t total = 0;
+        for (const auto &b: m_buckets) total += b.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+
+        const auto target = static_cast<uint64_t>(static_cast<double>(total) * p / 100.0 + 0.5);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++) {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= target && seen > 0) {
+                // The top bucket's upper bound can be well past anything recorded
+                const uint64_t upper = bucket_upper(i);
+                const uint64_t max = get_max();
+                return upper < max ? upper : max;
+            }
+        }
+        return get_max();
+    }
+
+    std::string format_latency(uint64_t ns) {
+        char buf[32];
+        if (ns < 1000) {
+            std::snprintf(buf, sizeof(buf), "%llu ns", static_cast<unsigned long long>(ns));
+        } else if (ns < 1000000) {
+            std::snprintf(buf, sizeof(buf), "%.1f us", ns / 1e3);
+        } else if (ns < 1000000000) {
+            std::snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+        } else {
+            std::snprintf(buf, sizeof(buf), "%.2f s", ns / 1e9);
+        }
+        return buf;
+    }
+}
@@ -0,0 +1,93 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_PIPELINESTATS__
+#define __CANARY_PIPELINESTATS__
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace canary::can {
+
+    // Log-linear (HDR style) latency histogram. Each power of two is split into 16 buckets, so any value from 1 ns up
+    // is recorded to within about 6% in a fixed 8 KB table. Recording is a few relaxed atomic operations and never
+    // allocates, so a capture thread can record while the GUI reads.
+    class latency_histogram {
+    public:
+        static constexpr int SUB_BUCKET_BITS = 4;
+        static constexpr size_t SUB_BUCKETS = size_t{1} << SUB_BUCKET_BITS;
+        // Values below SUB_BUCKETS are exact, then one row of SUB_BUCKETS per remaining bit of a 64-bit value
+        static constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+        void record(uint64_t ns) {
+            m_buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum.fetch_add(ns, std::memory_order_relaxed);
+
+            uint64_t max = m_max.load(std::memory_order_relaxed);
+            while (ns > max && !m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+        }
+
+        // Values recorded at the same time may or may not be kept
+        void reset();
+
+        [[nodiscard]] inline uint64_t get_count() const { return m_count.load(std::memory_order_relaxed); }
+
+        [[nodiscard]] inline uint64_t get_max() const { return m_max.load(std::memory_order_relaxed); }
+
+        [[nodiscard]] double get_mean() const;
+
+        // Upper bound of the bucket holding the given percentile (0-100), 0 if nothing has been recorded
+        [[nodiscard]] uint64_t percentile(double p) const;
+
+        static size_t bucket_of(uint64_t ns);
+
+        // Largest value that falls in the bucket
+        static uint64_t bucket_upper(size_t bucket);
+
+    private:
+        std::atomic<uint64_t> m_buckets[BUCKET_COUNT]{};
+        std::atomic<uint64_t> m_count{0};
+        std::atomic<uint64_t> m_sum{0};
+        std::atomic<uint64_t> m_max{0};
+    };
+
+    // Counters for one capture queue (normally one bus). Written by the producer thread, read from anywhere.
+    struct queue_stats {
+        std::string name;
+        size_t capacity{0};
+        // Frame timestamp to queued, i.e. time spent in the kernel, on the network and being parsed. Sampled, see
+        // packetprovider::LATENCY_SAMPLE_INTERVAL.
+        latency_histogram received;
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> dropped{0};
+        // Most frames waiting in the queue at once
+        std::atomic<size_t> high_water{0};
+    };
+
+    // Frame timestamp to later points in the pipeline, recorded on the render (or headless) thread
+    struct pipeline_stats {
+        // Added to the packet store, includes waiting in the queue and for the multi-bus merge
+        latency_histogram stored;
+        // Drawn on screen for the first time
+        latency_histogram rendered;
+        std::atomic<uint64_t> stored_frames{0};
+        std::atomic<uint64_t> rendered_frames{0};
+        // When the counters were last reset, for rates
+        std::chrono::steady_clock::time_point since{std::chrono::steady_clock::now()};
+    };
+
+    // Nanoseconds since the Unix epoch, the clock frame timestamps use
+    inline uint64_t timestamp_now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // e.g. "850 ns", "12.3 us", "4.56 ms"
+    std::string format_latency(uint64_t ns);
+
+}
+
+#endif
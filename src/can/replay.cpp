@@ -0,0 +1,136 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "replay.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <thread>
+#include <vector>
+
+namespace canary::can {
+    namespace {
+        // Gap left between the end of the capture and the start of the next loop
+        constexpr uint64_t LOOP_GAP_NS = 1000000;
+    }
+
+    replay::replay(std::string path, double speed, bool loop, uint8_t bus) : m_path(std::move(path)),
+                                                                             m_speed(std::max(speed, 0.0)),
+                                                                             m_loop(loop), m_bus(bus) {}
+
+    int replay::open_file() {
+        if (m_file.is_open()) return 0;
+
+        m_file.set_error_handler(m_error_handler);
+        if (m_file.open(m_path) != 0) {
+            return 1;
+        }
+
+        std::bitset<256> buses;
+        if (!m_file.get_buses(buses)) {
+            // Not closed cleanly, so the header does not list the buses
+            std::vector<frame> block(std::min<size_t>(m_file.size(), CAPTURE_CHUNK_FRAMES));
+            for (size_t i = 0; i < m_file.size(); i += block.size()) {
+                const size_t n = std::min(block.size(), m_file.size() - i);
+                m_file.read(i, n, block.data());
+                for (size_t j = 0; j < n; j++) buses.set(block[j].bus);
+            }
+        }
+
+        // Recorded buses are numbered in order without gaps
+        m_bus_count = 0;
+        for (size_t b = 0; b < buses.size(); b++) {
+            m_bus_map[b] = static_cast<uint8_t>(m_bus + m_bus_count);
+            if (buses[b]) m_bus_count++;
+        }
+        m_bus_count = std::max<size_t>(m_bus_count, 1);
+        return 0;
+    }
+
+    size_t replay::get_bus_count() {
+        if (open_file() != 0) return 1;
+        return m_bus_count;
+    }
+
+    int replay::open() {
+        if (open_file() != 0) {
+            return 1;
+        }
+
+        m_pos = 0;
+        m_loop_offset_ns = 0;
+        m_first_timestamp = m_file.size() > 0 ? m_file[0].timestamp : 0;
+        m_start = std::chrono::steady_clock::now();
+        m_start_timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        m_frames_replayed = 0;
+        m_finished = false;
+        m_open = true;
+        return 0;
+    }
+
+    uint64_t replay::offset_of(size_t i) const {
+        // Frames from different buses can be slightly out of order, never go back before the start
+        const uint64_t ts = m_file[i].timestamp;
+        uint64_t offset = (ts > m_first_timestamp ? ts - m_first_timestamp : 0) + m_loop_offset_ns;
+        if (m_speed > 0) offset = static_cast<uint64_t>(static_cast<double>(offset) / m_speed);
+        return offset;
+    }
+
+    int replay::emit_due(std::chrono::steady_clock::time_point now, const frame_handler &on_frame) {
+        const auto elapsed = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_start).count());
+
+        int n = 0;
+        while (n < MAX_BATCH_SIZE) {
+            if (m_pos >= m_file.size()) {
+                if (!m_loop || m_file.size() == 0) break;
+
+                m_loop_offset_ns += m_file[m_file.size() - 1].timestamp - m_first_timestamp + LOOP_GAP_NS;
+                m_pos = 0;
+            }
+
+            const uint64_t offset = offset_of(m_pos);
+            if (m_speed > 0 && offset > elapsed) break;
+
+            frame f = m_file[m_pos++];
+            f.timestamp = m_start_timestamp + offset;
+            f.bus = m_bus_map[f.bus];
+            on_frame(f);
+            n++;
+        }
+
+        m_frames_replayed.fetch_add(n, std::memory_order_relaxed);
+        return n;
+    }
+
+    int replay::read_frames(int timeout_ms, const frame_handler &on_frame) {
+        if (!is_open()) return -1;
+
+        if (m_pos >= m_file.size() && !m_loop) {
+            m_finished = true;
+            return -1;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        int n = emit_due(now, on_frame);
+        if (n > 0 || m_speed == 0) return n;
+
+        // Nothing due yet, sleep until the next frame or the timeout, whichever comes first
+        auto wake = now + std::chrono::milliseconds(timeout_ms);
+        if (m_pos < m_file.size()) {
+            wake = std::min(wake, m_start + std::chrono::nanoseconds(offset_of(m_pos)));
+        }
+        std::this_thread::sleep_until(wake);
+
+        return emit_due(std::chrono::steady_clock::now(), on_frame);
+    }
+
+    int replay::send_frame(const frame &) {
+        return 1;
+    }
+
+    void replay::close() {
+        m_open = false;
+        m_file.close();
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_REPLAY__
+#define __CANARY_REPLAY__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "packetsource.hpp"
+#include "capturefile.hpp"
+
+namespace canary::can {
+
+    // Plays a capture file back as if it were a live bus, either at the recorded timing (scaled by speed) or as fast
+    // as the capture queue will take it. Timestamps are shifted so the replay starts at the time open() was called.
+    // Each bus in the recording comes back on its own bus, numbered in order from the replay's own bus index, so a
+    // recording of several buses comes back as several buses.
+    class replay : public packetsource {
+    public:
+        // Most frames passed on by one read_frames call, so a max speed replay still returns regularly
+        static constexpr int MAX_BATCH_SIZE = 4096;
+
+        // speed 2.0 plays twice as fast as recorded, 0 as fast as possible. With loop, playback starts again from the
+        // beginning instead of finishing. bus is the first of the buses the recorded ones are replayed on.
+        explicit replay(std::string path, double speed = 1.0, bool loop = false, uint8_t bus = 0);
+
+        int open() override;
+
+        // Number of buses in the recording, opens the file if needed
+        [[nodiscard]] size_t get_bus_count() override;
+
+        int read_frames(int timeout_ms, const frame_handler &on_frame) override;
+
+        // Replays are receive only
+        int send_frame(const frame &) override;
+
+        void close() override;
+
+        [[nodiscard]] inline bool is_open() const override { return m_open.load(std::memory_order_acquire); }
+
+        [[nodiscard]] inline bool is_lossless() const override { return true; }
+
+        [[nodiscard]] inline bool is_finished() const override {
+            return m_finished.load(std::memory_order_acquire);
+        }
+
+        // Frames replayed so far, including earlier loops
+        [[nodiscard]] inline uint64_t get_frames_replayed() const {
+            return m_frames_replayed.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::string m_path;
+        double m_speed;
+        bool m_loop;
+        uint8_t m_bus;
+
+        capturefile m_file;
+        std::atomic<bool> m_open{false};
+        std::atomic<bool> m_finished{false};
+        std::atomic<uint64_t> m_frames_replayed{0};
+
+        // Bus each recorded bus is replayed on
+        uint8_t m_bus_map[256]{};
+        size_t m_bus_count{0};
+
+        size_t m_pos{0};
+        uint64_t m_first_timestamp{0};
+        // Added to recorded offsets on each loop so time keeps moving forwards
+        uint64_t m_loop_offset_ns{0};
+        std::chrono::steady_clock::time_point m_start{};
+        uint64_t m_start_timestamp{0};
+
+        // Opens the file and maps its buses if not done yet, returns 0 on success
+        int open_file();
+
+        // Scaled time from the start of the replay to frame i
+        [[nodiscard]] uint64_t offset_of(size_t i) const;
+
+        // Passes on every frame due by now, returns the number passed on
+        int emit_due(std::chrono::steady_clock::time_point now, const frame_handler &on_frame);
+    };
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "searchindex.hpp"
+
+#include <algorithm>
+
+namespace canary::can {
+    namespace {
+        // Frames copied per read_packets() call by the background update, the render thread waits at most this long
+        // to store new frames
+        constexpr size_t READ_FRAMES = 4096;
+
+        uint32_t id_key(const frame &f) {
+            return f.id & (FRAME_EXTENDED_FLAG | FRAME_EXTENDED_MASK);
+        }
+    }
+
+    searchindex::~searchindex() {
+        stop_update();
+    }
+
+    bool searchindex::update(const packetprovider &provider) {
+        const auto &packets = provider.get_received_packets();
+        if (packets.size() < m_indexed) reset();
+
+        if (packets.size() - m_indexed < BACKGROUND_UPDATE_MIN) {
+            update(packets);
+            return true;
+        }
+
+        m_progress.store(0, std::memory_order_relaxed);
+        m_progress_total.store(packets.size() - m_indexed, std::memory_order_relaxed);
+        m_updating.store(true, std::memory_order_release);
+        m_worker = std::thread(&searchindex::background_update, this, std::cref(provider), provider.get_epoch(),
+                               packets.size());
+        return false;
+    }
+
+    bool searchindex::is_updating() {
+        if (m_updating.load(std::memory_order_acquire)) return true;
+        if (m_worker.joinable()) m_worker.join();
+        return false;
+    }
+
+    float searchindex::get_progress() const {
+        const size_t total = m_progress_total.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        return std::min(1.0f, static_cast<float>(m_progress.load(std::memory_order_relaxed)) /
+                              static_cast<float>(total));
+    }
+
+    void searchindex::stop_update() {
+        if (!m_worker.joinable()) return;
+
+        m_cancel.store(true, std::memory_order_relaxed);
+        m_worker.join();
+        m_cancel.store(false, std::memory_order_relaxed);
+        m_updating.store(false, std::memory_order_relaxed);
+    }
+
+    void searchindex::background_update(const packetprovider &provider, uint64_t epoch, size_t end) {
+        std::vector<frame> buffer(READ_FRAMES);
+        while (m_indexed < end && !m_cancel.load(std::memory_order_relaxed)) {
+            const size_t count = provider.read_packets(epoch, m_indexed, std::min(READ_FRAMES, end - m_indexed),
+                                                       buffer.data());
+            // Cleared or replaced, the render thread resets once it sees the new epoch
+            if (count == 0) break;
+
+            for (size_t i = 0; i < count; i++) {
+                add(buffer[i], static_cast<uint32_t>(m_indexed + i));
+            }
+            m_indexed += count;
+            m_progress.fetch_add(count, std::memory_order_relaxed);
+        }
+        m_updating.store(false, std::memory_order_release);
+    }
+
+    void searchindex::reset() {
+        stop_update();
+        m_ids.clear();
+        for (auto &frames: m_frames_by_value) {
+            frames.clear();
+        }
+        m_indexed = 0;
+    }
+
+    void searchindex::add(const frame &f, uint32_t index) {
+        auto &entry = m_ids[id_key(f)];
+        if (!entry) {
+            entry = std::make_unique<id_entry>();
+            entry->id = id_key(f);
+        }
+
+        entry->frames.push_back(index);
+        if (f.dlc > entry->max_dlc) entry->max_dlc = f.dlc;
+
+        // Each frame goes in a value's list once, however many bytes hold that value
+        std::bitset<256> values;
+        for (size_t i = 0; i < f.dlc; i++) {
+            entry->seen[i].set(f.data[i]);
+            if (!values.test(f.data[i])) {
+                values.set(f.data[i]);
+                m_frames_by_value[f.data[i]].push_back(index);
+            }
+        }
+    }
+
+    std::bitset<256> searchindex::range_mask(uint8_t lo, uint8_t hi) {
+        std::bitset<256> mask;
+        for (int v = lo; v <= hi; v++) {
+            mask.set(v);
+        }
+        return mask;
+    }
+
+    std::vector<searchindex::id_match> searchindex::find_ids(uint8_t lo, uint8_t hi) const {
+        std::vector<id_match> matches;
+        if (lo > hi) return matches;
+
+        auto mask = range_mask(lo, hi);
+        for (const auto &[key, entry]: m_ids) {
+            uint64_t positions = 0;
+            for (size_t i = 0; i < entry->max_dlc; i++) {
+                if ((entry->seen[i] & mask).any()) positions |= 1ULL << i;
+            }
+            if (positions) matches.push_back({entry->id, positions});
+        }
+
+        std::sort(matches.begin(), matches.end(), [](const id_match &a, const id_match &b) {
+            return a.id < b.id;
+        });
+        return matches;
+    }
+
+    std::vector<uint32_t> searchindex::find_frames(uint8_t lo, uint8_t hi, size_t limit) const {
+        std::vector<uint32_t> frames;
+        if (lo > hi) return frames;
+
+        // k-way merge of the per-value lists, a frame is in several lists if it holds several values in the range
+        std::vector<size_t> pos(hi - lo + 1, 0);
+        while (frames.size() < limit) {
+            uint32_t next = UINT32_MAX;
+            for (int v = lo; v <= hi; v++) {
+                const auto &list = m_frames_by_value[v];
+                size_t p = pos[v - lo];
+                if (p < list.size() && list[p] < next) next = list[p];
+            }
+            if (next == UINT32_MAX) break;
+
+            frames.push_back(next);
+            for (int v = lo; v <= hi; v++) {
+                const auto &list = m_frames_by_value[v];
+                size_t &p = pos[v - lo];
+                if (p < list.size() && list[p] == next) p++;
+            }
+        }
+
+        return frames;
+    }
+
+    const std::vector<uint32_t> *searchindex::get_frames(uint32_t id) const {
+        auto it = m_ids.find(id & (FRAME_EXTENDED_FLAG | FRAME_EXTENDED_MASK));
+        return it == m_ids.end() ? nullptr : &it->second->frames;
+    }
+}
@@ -0,0 +1,109 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_SEARCHINDEX__
+#define __CANARY_SEARCHINDEX__
+
+#include <atomic>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "frame.hpp"
+#include "packetprovider.hpp"
+
+namespace canary::can {
+
+    // Index over payload bytes for value searches, built incrementally as packets arrive. For every CAN ID it keeps
+    // the set of values seen at each byte position, and for every byte value the list of frames containing it, so a
+    // search never has to go back over the payloads.
+    class searchindex {
+    public:
+        // Below this many packets to index, update() with a packetprovider does it before returning
+        static constexpr size_t BACKGROUND_UPDATE_MIN = 262144;
+
+        ~searchindex();
+
+        struct id_match {
+            // frame::id
+            uint32_t id;
+            // Bit n set if a value in the range was seen at byte n
+            uint64_t positions;
+        };
+
+        // Packets is any container with size() and operator[] returning a frame. Indexes packets received since the
+        // last call.
+        template<typename Packets>
+        void update(const Packets &packets) {
+            if (packets.size() < m_indexed) reset();
+
+            for (size_t i = m_indexed; i < packets.size(); i++) {
+                add(packets[i], static_cast<uint32_t>(i));
+            }
+            m_indexed = packets.size();
+        }
+
+        // For the render thread, not while is_updating(). Indexes the packets received since the last call as above.
+        // If that is BACKGROUND_UPDATE_MIN packets or more (e.g. a long capture the first time) it is done on a
+        // background thread, reading the packets a chunk at a time so they can still be stored meanwhile, and the
+        // index may not be queried until is_updating() is false. Returns false while the background update runs.
+        bool update(const packetprovider &provider);
+
+        // Joins the background update once it has finished
+        [[nodiscard]] bool is_updating();
+
+        // Fraction of the background update done
+        [[nodiscard]] float get_progress() const;
+
+        // Must be called when the packets are cleared. Stops the background update if there is one.
+        void reset();
+
+        // IDs carrying a value in [lo, hi] at any byte, sorted by ID
+        [[nodiscard]] std::vector<id_match> find_ids(uint8_t lo, uint8_t hi) const;
+
+        // Indices of frames containing a value in [lo, hi], in order. Stops after limit frames.
+        [[nodiscard]] std::vector<uint32_t> find_frames(uint8_t lo, uint8_t hi, size_t limit = SIZE_MAX) const;
+
+        // Indices of all frames with this ID, in order, nullptr if the ID has not been seen
+        [[nodiscard]] const std::vector<uint32_t> *get_frames(uint32_t id) const;
+
+        [[nodiscard]] inline size_t get_indexed_count() const { return m_indexed; }
+
+        [[nodiscard]] inline size_t get_id_count() const { return m_ids.size(); }
+
+    private:
+        struct id_entry {
+            uint32_t id;
+            std::bitset<256> seen[FRAME_MAX_DATA];
+            // Highest dlc seen, limits which positions are checked
+            uint8_t max_dlc{0};
+            // Frames with this ID, in order
+            std::vector<uint32_t> frames;
+        };
+
+        std::unordered_map<uint32_t, std::unique_ptr<id_entry>> m_ids;
+        // Frames containing each byte value, in order
+        std::vector<uint32_t> m_frames_by_value[256];
+        size_t m_indexed{0};
+
+        std::thread m_worker;
+        std::atomic<bool> m_updating{false};
+        std::atomic<bool> m_cancel{false};
+        // Packets indexed by the background update, and the packets it has to go through
+        std::atomic<size_t> m_progress{0};
+        std::atomic<size_t> m_progress_total{0};
+
+        void stop_update();
+
+        void background_update(const packetprovider &provider, uint64_t epoch, size_t end);
+
+        void add(const frame &f, uint32_t index);
+
+        static std::bitset<256> range_mask(uint8_t lo, uint8_t hi);
+    };
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "socketcan.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+#include <cstring>
+#include <chrono>
+#include <format>
+
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+namespace canary::can {
+    socketcan::socketcan(std::string can_interface, uint8_t bus, int batch_size)
+            : m_interface(std::move(can_interface)), m_bus(bus), m_batch_size(batch_size > 0 ? batch_size : 1) {
+        m_slots.resize(m_batch_size);
+        m_msgs.resize(m_batch_size);
+        m_iovecs.resize(m_batch_size);
+    }
+
+    socketcan::~socketcan() {
+        close();
+    }
+
+    int socketcan::open() {
+        m_fd = ::socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK, CAN_RAW);
+        if (m_fd < 0) {
+            if (m_error_handler) m_error_handler(std::format("socketcan: Error opening socket: {}", strerror(errno)));
+            return 1;
+        }
+
+        // Receive CAN FD frames too, classic-only interfaces reject this which is fine
+        int enable = 1;
+        m_fd_enabled = setsockopt(m_fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES, &enable, sizeof(enable)) == 0;
+
+        // Prefer hardware timestamps, the kernel still fills in the software one if the driver has none
+        int ts_flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE |
+                       SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE;
+        if (setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPING, &ts_flags, sizeof(ts_flags)) < 0) {
+            setsockopt(m_fd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof(enable));
+        }
+
+        struct ifreq ifr{};
+        std::strncpy(ifr.ifr_name, m_interface.c_str(), IFNAMSIZ - 1);
+        if (ioctl(m_fd, SIOCGIFINDEX, &ifr) < 0) {
+            if (m_error_handler) m_error_handler(std::format("socketcan: No such interface: {}", m_interface));
+            close();
+            return 1;
+        }
+
+        struct sockaddr_can addr{};
+        addr.can_family = AF_CAN;
+        addr.can_ifindex = ifr.ifr_ifindex;
+        if (bind(m_fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+            if (m_error_handler) m_error_handler(std::format("socketcan: Bind failed: {}", strerror(errno)));
+            close();
+            return 1;
+        }
+
+        return 0;
+    }
+
+    void socketcan::prepare_batch() {
+        for (int i = 0; i < m_batch_size; i++) {
+            m_iovecs[i].iov_base = m_slots[i].frame;
+            m_iovecs[i].iov_len = sizeof(m_slots[i].frame);
+
+            auto &hdr = m_msgs[i].msg_hdr;
+            hdr = {};
+            hdr.msg_iov = &m_iovecs[i];
+            hdr.msg_iovlen = 1;
+            hdr.msg_control = m_slots[i].control;
+            hdr.msg_controllen = sizeof(m_slots[i].control);
+            m_msgs[i].msg_len = 0;
+        }
+    }
+
+    int socketcan::read_frames(int timeout_ms, const frame_handler &on_frame) {
+        if (m_fd < 0) return -1;
+
+        struct pollfd pfd{m_fd, POLLIN, 0};
+        int ready = ::poll(&pfd, 1, timeout_ms);
+        if (ready < 0) {
+            if (errno == EINTR) return 0;
+            if (m_error_handler) m_error_handler(std::format("socketcan: poll failed: {}", strerror(errno)));
+            return -1;
+        }
+        if (ready == 0) {
+            return 0;
+        }
+
+        prepare_batch();
+        int n = recvmmsg(m_fd, m_msgs.data(), m_batch_size, MSG_DONTWAIT, nullptr);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return 0;
+            if (m_error_handler) m_error_handler(std::format("socketcan: recvmmsg failed: {}", strerror(errno)));
+            return -1;
+        }
+
+        frame f;
+        for (int i = 0; i < n; i++) {
+            const auto *raw = reinterpret_cast<const struct canfd_frame *>(m_slots[i].frame);
+            const bool is_fd = m_msgs[i].msg_len == CANFD_MTU;
+            if (!is_fd && m_msgs[i].msg_len != CAN_MTU) {
+                continue;
+            }
+
+            std::memset(&f, 0, sizeof(f));
+            f.id = raw->can_id;
+            f.bus = m_bus;
+            f.dlc = raw->len > FRAME_MAX_DATA ? FRAME_MAX_DATA : raw->len;
+            if (is_fd) {
+                f.flags |= FRAME_FD_FLAG;
+                if (raw->flags & CANFD_BRS) f.flags |= FRAME_BRS_FLAG;
+            }
+            std::memcpy(f.data, raw->data, f.dlc);
+
+            for (auto *cmsg = CMSG_FIRSTHDR(&m_msgs[i].msg_hdr); cmsg;
+                 cmsg = CMSG_NXTHDR(&m_msgs[i].msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level != SOL_SOCKET) continue;
+
+                if (cmsg->cmsg_type == SO_TIMESTAMPING) {
+                    // [0] software, [2] raw hardware
+                    struct scm_timestamping ts{};
+                    std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+                    const auto &t = (ts.ts[2].tv_sec || ts.ts[2].tv_nsec) ? ts.ts[2] : ts.ts[0];
+                    f.timestamp = static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+                } else if (cmsg->cmsg_type == SO_TIMESTAMPNS) {
+                    struct timespec t{};
+                    std::memcpy(&t, CMSG_DATA(cmsg), sizeof(t));
+                    f.timestamp = static_cast<uint64_t>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+                }
+            }
+
+            if (f.timestamp == 0) {
+                f.timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+            }
+
+            on_frame(f);
+        }
+
+        return n;
+    }
+
+    int socketcan::send_frame(const frame &f) {
+        if (m_fd < 0) return 1;
+
+        struct canfd_frame raw{};
+        raw.can_id = f.id;
+        raw.len = f.dlc;
+        std::memcpy(raw.data, f.data, f.dlc);
+
+        size_t mtu = CAN_MTU;
+        if (f.is_fd() || f.dlc > CAN_MAX_DLEN) {
+            if (!m_fd_enabled) {
+                if (m_error_handler) m_error_handler("socketcan: Interface does not support CAN FD frames");
+                return 1;
+            }
+            mtu = CANFD_MTU;
+            if (f.flags & FRAME_BRS_FLAG) raw.flags |= CANFD_BRS;
+        }
+
+        if (::write(m_fd, &raw, mtu) != static_cast<ssize_t>(mtu)) {
+            if (m_error_handler) m_error_handler(std::format("socketcan: Failed to send frame: {}", strerror(errno)));
+            return 1;
+        }
+
+        return 0;
+    }
+
+    void socketcan::close() {
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,63 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_SOCKETCAN__
+#define __CANARY_SOCKETCAN__
+
+#if defined(__linux__)
+
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "packetsource.hpp"
+
+namespace canary::can {
+
+    // Captures frames directly from a Linux SocketCAN interface (e.g. can0, vcan0) using a raw CAN socket. Frames are
+    // pulled in batches with recvmmsg and stamped with kernel (or hardware, if available) receive timestamps.
+    class socketcan : public packetsource {
+    public:
+        static constexpr int DEFAULT_BATCH_SIZE = 64;
+
+        explicit socketcan(std::string can_interface, uint8_t bus = 0, int batch_size = DEFAULT_BATCH_SIZE);
+
+        ~socketcan() override;
+
+        int open() override;
+
+        int read_frames(int timeout_ms, const frame_handler &on_frame) override;
+
+        int send_frame(const frame &f) override;
+
+        void close() override;
+
+        [[nodiscard]] inline bool is_open() const override { return m_fd >= 0; }
+
+        [[nodiscard]] inline int get_fd() const override { return m_fd; }
+
+    private:
+        // Per-message receive buffers, sized for CAN FD frames and timestamp control messages
+        struct rx_slot {
+            alignas(8) unsigned char frame[72];
+            alignas(8) unsigned char control[128];
+        };
+
+        std::string m_interface;
+        uint8_t m_bus;
+        int m_batch_size;
+        int m_fd{-1};
+        bool m_fd_enabled{false};
+
+        std::vector<rx_slot> m_slots;
+        std::vector<mmsghdr> m_msgs;
+        std::vector<iovec> m_iovecs;
+
+        void prepare_batch();
+    };
+
+}
+
+#endif
+
+#endif
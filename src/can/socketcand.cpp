@@ -2,5 +2,50 @@
 
 #include "socketcand.hpp"
 
+#include <cstdio>
+
 namespace canary::can {
-}
\ No newline at end of file
+    int socketcand::open() {
+        m_socket.set_error_handler(m_error_handler);
+        m_parser.reset();
+        return m_socket.connect();
+    }
+
+    int socketcand::read_frames(int timeout_ms, const frame_handler &on_frame) {
+        bool read = false, write = false;
+        int activity = m_socket.select(false, read, write, timeout_ms);
+        if (activity < 0) {
+            return -1;
+        }
+        if (activity == 0 || !read) {
+            return 0;
+        }
+
+        int n = m_socket.recv(m_buffer, sizeof(m_buffer));
+        if (n <= 0) {
+            if (n == 0 && m_error_handler) m_error_handler("Connection closed by socketcand");
+            return -1;
+        }
+
+        return static_cast<int>(m_parser.feed(m_buffer, n, on_frame));
+    }
+
+    int socketcand::send_frame(const frame &f) {
+        // < send can_id can_dlc [data]* >
+        char msg[32 + FRAME_MAX_DATA * 3];
+        char id_str[9];
+        format_can_id(f, id_str);
+
+        int len = std::snprintf(msg, sizeof(msg), "< send %s %d", id_str, f.dlc);
+        for (size_t i = 0; i < f.dlc; i++) {
+            len += std::snprintf(msg + len, sizeof(msg) - len, " %02x", f.data[i]);
+        }
+        len += std::snprintf(msg + len, sizeof(msg) - len, " >\n");
+
+        return m_socket.send_when_ready(msg, len) == len ? 0 : 1;
+    }
+
+    void socketcand::close() {
+        m_socket.close();
+    }
+}
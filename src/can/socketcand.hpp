@@ -3,11 +3,34 @@
 #ifndef __CANARY_SOCKETCAND__
 #define __CANARY_SOCKETCAND__
 
+#include "packetsource.hpp"
+#include "socketcandparser.hpp"
+#include "../socket.hpp"
 
 namespace canary::can {
 
-    class socketcand {
+    // Captures frames from a socketcand server in rawmode
+    class socketcand : public packetsource {
+    public:
+        socketcand(std::string host, int port, std::string socketcand_interface, uint8_t bus = 0)
+                : m_socket(std::move(host), port, std::move(socketcand_interface)), m_parser(bus) {};
 
+        int open() override;
+
+        int read_frames(int timeout_ms, const frame_handler &on_frame) override;
+
+        int send_frame(const frame &f) override;
+
+        void close() override;
+
+        [[nodiscard]] inline bool is_open() const override { return m_socket.m_connected; }
+
+        [[nodiscard]] inline int get_fd() const override { return m_socket.get_fd(); }
+
+    private:
+        canary::socketcand m_socket;
+        socketcandparser m_parser;
+        char m_buffer[4096]{};
     };
 
 }
@@ -0,0 +1,15 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "socketcandparser.hpp"
+
+namespace canary::can {
+    bool socketcandparser::append_partial(const char *data, size_t len) {
+        if (m_partial_length + len > MAX_PACKET_LENGTH) {
+            return false;
+        }
+
+        std::memcpy(m_partial + m_partial_length, data, len);
+        m_partial_length += len;
+        return true;
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_SOCKETCANDPARSER__
+#define __CANARY_SOCKETCANDPARSER__
+
+#include <cstring>
+#include <string_view>
+
+#include "frame.hpp"
+
+namespace canary::can {
+
+    // Incremental parser for the socketcand rawmode stream. Scans receive buffers in place and only copies the tail of
+    // a packet that is split across two reads, so no allocations are made while parsing.
+    class socketcandparser {
+    public:
+        // Longest packet we accept, a 64 byte CAN FD frame with an extended ID is well under this
+        static constexpr size_t MAX_PACKET_LENGTH = 256;
+
+        explicit socketcandparser(uint8_t bus = 0) : m_bus(bus) {};
+
+        // Parses len bytes of stream data, calling on_frame(const frame &) for each complete frame. Returns the number
+        // of frames emitted.
+        template<typename F>
+        size_t feed(const char *data, size_t len, F &&on_frame) {
+            size_t emitted = 0;
+            const char *pos = data;
+            const char *end = data + len;
+
+            if (m_partial_length > 0) {
+                // Finish the packet started by the previous read
+                auto close = static_cast<const char *>(std::memchr(pos, '>', end - pos));
+                const char *copy_end = close ? close + 1 : end;
+                if (!append_partial(pos, copy_end - pos)) {
+                    m_partial_length = 0;
+                    m_malformed_count++;
+                } else if (close) {
+                    emitted += handle_packet(std::string_view(m_partial, m_partial_length), on_frame);
+                    m_partial_length = 0;
+                }
+                pos = copy_end;
+            }
+
+            while (pos < end) {
+                auto open = static_cast<const char *>(std::memchr(pos, '<', end - pos));
+                if (!open) break;
+
+                auto close = static_cast<const char *>(std::memchr(open, '>', end - open));
+                if (!close) {
+                    // Packet continues in the next read
+                    if (!append_partial(open, end - open)) {
+                        m_partial_length = 0;
+                        m_malformed_count++;
+                    }
+                    break;
+                }
+
+                emitted += handle_packet(std::string_view(open, close - open + 1), on_frame);
+                pos = close + 1;
+            }
+
+            return emitted;
+        }
+
+        // Drops any partially received packet, e.g. after reconnecting
+        inline void reset() { m_partial_length = 0; }
+
+        [[nodiscard]] inline uint64_t get_malformed_count() const { return m_malformed_count; }
+
+        [[nodiscard]] inline uint64_t get_frame_count() const { return m_frame_count; }
+
+    private:
+        uint8_t m_bus;
+        char m_partial[MAX_PACKET_LENGTH]{};
+        size_t m_partial_length{0};
+        uint64_t m_frame_count{0};
+        uint64_t m_malformed_count{0};
+
+        bool append_partial(const char *data, size_t len);
+
+        template<typename F>
+        size_t handle_packet(std::string_view packet, F &on_frame) {
+            frame f;
+            if (!parse_socketcand_frame(packet, f)) {
+                // Control packets such as "< ok >" are expected, anything claiming to be a frame is not
+                if (packet.starts_with("< frame")) m_malformed_count++;
+                return 0;
+            }
+
+            f.bus = m_bus;
+            m_frame_count++;
+            on_frame(static_cast<const frame &>(f));
+            return 1;
+        }
+    };
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "spillfile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+#if defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+namespace canary::can {
+    spillfile::~spillfile() {
+        close();
+    }
+
+    int spillfile::create() {
+#if defined(WIN32)
+        char dir[MAX_PATH], path[MAX_PATH];
+        if (!GetTempPathA(MAX_PATH, dir) || !GetTempFileNameA(dir, "cny", 0, path)) return 1;
+
+        HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                  FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return 1;
+        m_handle = file;
+#else
+        // tmpfile() is already unlinked, nothing is left behind if CANary crashes
+        std::FILE *file = std::tmpfile();
+        if (!file) return 1;
+        m_fd = dup(fileno(file));
+        std::fclose(file);
+        if (m_fd < 0) return 1;
+#endif
+        return 0;
+    }
+
+    int spillfile::add_window(size_t length) {
+        const uint64_t offset = m_windows.empty() ? 0 : m_window_offset + m_windows.back().length;
+        // Whole 64 KiB units, so the next window starts on a mapping boundary too
+        length = std::max((length + 0xFFFF) & ~static_cast<size_t>(0xFFFF), WINDOW_BYTES);
+
+#if defined(WIN32)
+        // Creating the mapping object grows the file to cover the window
+        const uint64_t end = offset + length;
+        HANDLE mapping = CreateFileMappingA(m_handle, nullptr, PAGE_READONLY, static_cast<DWORD>(end >> 32),
+                                            static_cast<DWORD>(end & 0xFFFFFFFF), nullptr);
+        if (!mapping) return 1;
+        void *data = MapViewOfFile(mapping, FILE_MAP_READ, static_cast<DWORD>(offset >> 32),
+                                   static_cast<DWORD>(offset & 0xFFFFFFFF), length);
+        // The view keeps the mapping object alive
+        CloseHandle(mapping);
+        if (!data) return 1;
+#else
+        // Sparse, only the blocks written take up disk space
+        if (ftruncate(m_fd, static_cast<off_t>(offset + length)) != 0) return 1;
+        void *data = mmap(nullptr, length, PROT_READ, MAP_SHARED, m_fd, static_cast<off_t>(offset));
+        if (data == MAP_FAILED) return 1;
+#endif
+
+        m_windows.push_back({data, length});
+        m_window_offset = offset;
+        m_window_used = 0;
+        return 0;
+    }
+
+    const frame *spillfile::spill(const frame *frames, size_t count) {
+#if defined(WIN32)
+        if (!m_handle && create() != 0) return nullptr;
+#else
+        if (m_fd < 0 && create() != 0) return nullptr;
+#endif
+
+        const size_t length = count * sizeof(frame);
+        if (m_windows.empty() || m_windows.back().length - m_window_used < length) {
+            if (add_window(length) != 0) return nullptr;
+        }
+        const uint64_t offset = m_window_offset + m_window_used;
+
+        // Written through the file rather than the mapping, so running out of disk space is an error here instead of
+        // a SIGBUS later
+#if defined(WIN32)
+        LARGE_INTEGER pos;
+        pos.QuadPart = static_cast<LONGLONG>(offset);
+        DWORD written = 0;
+        if (!SetFilePointerEx(m_handle, pos, nullptr, FILE_BEGIN) ||
+            !WriteFile(m_handle, frames, static_cast<DWORD>(length), &written, nullptr) || written != length) {
+            return nullptr;
+        }
+#else
+        size_t done = 0;
+        while (done < length) {
+            ssize_t n = pwrite(m_fd, reinterpret_cast<const uint8_t *>(frames) + done, length - done,
+                               static_cast<off_t>(offset + done));
+            if (n <= 0) return nullptr;
+            done += static_cast<size_t>(n);
+        }
+#endif
+
+        const auto *data = static_cast<const uint8_t *>(m_windows.back().data) + m_window_used;
+        m_window_used += length;
+        m_size += length;
+        return reinterpret_cast<const frame *>(data);
+    }
+
+    void spillfile::close() {
+        for (const auto &m: m_windows) {
+#if defined(WIN32)
+            UnmapViewOfFile(m.data);
+#else
+            munmap(m.data, m.length);
+#endif
+        }
+        m_windows.clear();
+        m_size = 0;
+        m_window_offset = 0;
+        m_window_used = 0;
+
+#if defined(WIN32)
+        if (m_handle) {
+            CloseHandle(static_cast<HANDLE>(m_handle));
+            m_handle = nullptr;
+        }
+#else
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+#endif
+    }
+}
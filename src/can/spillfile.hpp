@@ -0,0 +1,65 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_SPILLFILE__
+#define __CANARY_SPILLFILE__
+
+#include <cstdint>
+#include <vector>
+
+#include "frame.hpp"
+
+namespace canary::can {
+
+    // Anonymous temporary file that frames are moved out of memory into. The file is mapped back read-only in large
+    // windows, so spilled blocks can still be read in place and the OS pages them in and out as needed, while a
+    // day-long capture only needs a few hundred mappings rather than one per block (which would run into
+    // vm.max_map_count). Windows are never unmapped before close(), so pointers returned by spill() stay valid. The
+    // file is deleted when closed.
+    class spillfile {
+    public:
+        // Multiple of 64 KiB, so every window starts on a mapping boundary
+        static constexpr size_t WINDOW_BYTES = 256 * 1024 * 1024;
+
+        spillfile() = default;
+
+        ~spillfile();
+
+        spillfile(const spillfile &) = delete;
+
+        spillfile &operator=(const spillfile &) = delete;
+
+        // Appends count frames and returns a pointer to them in the mapping, nullptr on failure. Blocks never straddle
+        // two windows, a block that does not fit in what is left of the current one starts the next.
+        const frame *spill(const frame *frames, size_t count);
+
+        void close();
+
+        // Bytes written to the file
+        [[nodiscard]] inline uint64_t get_size() const { return m_size; }
+
+    private:
+        struct mapping {
+            void *data;
+            size_t length;
+        };
+
+#if defined(WIN32)
+        void *m_handle{nullptr};
+#else
+        int m_fd{-1};
+#endif
+        uint64_t m_size{0};
+        std::vector<mapping> m_windows;
+        // File offset of the last window, and how much of it has been written
+        uint64_t m_window_offset{0};
+        size_t m_window_used{0};
+
+        int create();
+
+        // Grows the file by a window of at least length bytes and maps it, returns 0 on success
+        int add_window(size_t length);
+    };
+
+}
+
+#endif
@@ -0,0 +1,100 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "commanddispatcher.hpp"
+
+#include "statscmd.hpp"
+
+#include <cstdio>
+
+namespace canary::command {
+    namespace {
+        std::string describe_stage(const std::string &name, uint64_t frames, double seconds,
+                                   const canary::can::latency_histogram &latency) {
+            using canary::can::format_latency;
+
+            char line[256];
+            std::snprintf(line, sizeof(line), "%-24s %12llu frames %10.0f/s  p50 %-9s p99 %-9s p99.9 %-9s max %s",
+                          name.c_str(), static_cast<unsigned long long>(frames), seconds > 0 ? frames / seconds : 0.0,
+                          format_latency(latency.percentile(50)).c_str(),
+                          format_latency(latency.percentile(99)).c_str(),
+                          format_latency(latency.percentile(99.9)).c_str(),
+                          format_latency(latency.get_max()).c_str());
+            return line;
+        }
+    }
+
+    const std::string stats_cmd::get_name() const {
+        return "stats";
+    }
+
+    const std::string stats_cmd::get_description() const {
+        return "Displays throughput and latency for each stage of the capture pipeline. \"stats reset\" starts "
+               "counting again.";
+    }
+
+    const std::unordered_set<std::string> stats_cmd::get_args() const {
+        return {"reset"};
+    }
+
+    const std::unordered_set<std::string> stats_cmd::get_opts() const {
+        return std::unordered_set<std::string>();
+    }
+
+    int stats_cmd::execute(const parsed_command &args, command_line &out) {
+        if (!args.args.empty() && args.args[0] == "reset") {
+            m_provider.reset_stats();
+            out.print("Statistics reset");
+            return 0;
+        }
+
+        for (const auto &line: describe(m_provider)) {
+            out.print("{}", line);
+        }
+        return 0;
+    }
+
+    std::vector<std::string> stats_cmd::describe(const canary::can::packetprovider &provider) {
+        const auto &stats = provider.get_stats();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stats.since).count();
+
+        std::vector<std::string> lines;
+        char line[256];
+        std::snprintf(line, sizeof(line), "Latency from frame timestamp, over the last %.1f s", seconds);
+        lines.emplace_back(line);
+
+        for (size_t i = 0; i < provider.get_queue_count(); i++) {
+            const auto &queue = provider.get_queue_stats(i);
+            lines.push_back(describe_stage("Queued (" + queue.name + ")", queue.frames.load(), seconds,
+                                           queue.received));
+        }
+        lines.push_back(describe_stage("Stored", stats.stored_frames.load(), seconds, stats.stored));
+        if (stats.rendered_frames.load() > 0) {
+            lines.push_back(describe_stage("Rendered", stats.rendered_frames.load(), seconds, stats.rendered));
+        }
+
+        for (size_t i = 0; i < provider.get_queue_count(); i++) {
+            const auto &queue = provider.get_queue_stats(i);
+            std::snprintf(line, sizeof(line), "%s: %llu dropped, queue high water %zu/%zu", queue.name.c_str(),
+                          static_cast<unsigned long long>(queue.dropped.load()), queue.high_water.load(),
+                          queue.capacity);
+            lines.emplace_back(line);
+        }
+
+        const auto &packets = provider.get_received_packets();
+        std::snprintf(line, sizeof(line), "Store: %zu frames, %.1f MB resident, %.1f MB spilled", packets.size(),
+                      packets.get_resident_bytes() / (1024.0 * 1024.0),
+                      packets.get_spilled_bytes() / (1024.0 * 1024.0));
+        lines.emplace_back(line);
+
+        const auto &recorder = provider.get_recorder();
+        if (recorder.is_recording()) {
+            std::snprintf(line, sizeof(line), "Recording: %llu frames, %.1f MB, %llu dropped",
+                          static_cast<unsigned long long>(recorder.get_frames_written()),
+                          recorder.get_bytes_written() / (1024.0 * 1024.0),
+                          static_cast<unsigned long long>(recorder.get_dropped_count()));
+            lines.emplace_back(line);
+        }
+
+        return lines;
+    }
+}
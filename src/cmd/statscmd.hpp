@@ -0,0 +1,35 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_COMMAND_STATS__
+#define __CANARY_COMMAND_STATS__
+
+#include <string>
+#include <vector>
+
+#include "commandbase.hpp"
+#include "../can/packetprovider.hpp"
+
+namespace canary::command {
+    class stats_cmd : public command_base {
+    public:
+        explicit stats_cmd(canary::can::packetprovider &provider) : m_provider(provider) {};
+
+        [[nodiscard]] const std::string get_name() const override;
+
+        [[nodiscard]] const std::string get_description() const override;
+
+        [[nodiscard]] const std::unordered_set<std::string> get_args() const override;
+
+        [[nodiscard]] const std::unordered_set<std::string> get_opts() const override;
+
+        int execute(const parsed_command &args, command_line &out) override;
+
+        // Throughput, latency percentiles, drops and buffer use per pipeline stage, one line each
+        static std::vector<std::string> describe(const canary::can::packetprovider &provider);
+
+    private:
+        canary::can::packetprovider &m_provider;
+    };
+}
+
+#endif
@@ -0,0 +1,156 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "compression.hpp"
+
+#include <cstring>
+
+namespace canary::compression {
+    namespace {
+        constexpr int HASH_BITS = 12;
+        constexpr size_t MIN_MATCH = 4;
+        // The format requires the last 5 bytes to be literals and the last match to start 12 bytes from the end
+        constexpr size_t LAST_LITERALS = 5;
+        constexpr size_t MATCH_FIND_LIMIT = 12;
+        constexpr size_t MAX_OFFSET = 65535;
+
+        inline uint32_t read32(const uint8_t *p) {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint32_t hash(uint32_t sequence) {
+            return (sequence * 2654435761U) >> (32 - HASH_BITS);
+        }
+
+        inline uint8_t *write_length(uint8_t *op, size_t len) {
+            while (len >= 255) {
+                *op++ = 255;
+                len -= 255;
+            }
+            *op++ = static_cast<uint8_t>(len);
+            return op;
+        }
+
+        inline uint8_t *write_sequence(uint8_t *op, const uint8_t *literals, size_t literal_len, size_t offset,
+                                       size_t match_len) {
+            uint8_t *token = op++;
+            *token = static_cast<uint8_t>((literal_len >= 15 ? 15 : literal_len) << 4);
+            if (literal_len >= 15) op = write_length(op, literal_len - 15);
+
+            std::memcpy(op, literals, literal_len);
+            op += literal_len;
+
+            if (match_len == 0) {
+                // Last sequence, literals only
+                return op;
+            }
+
+            *op++ = static_cast<uint8_t>(offset & 0xFF);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+
+            size_t ml = match_len - MIN_MATCH;
+            *token |= static_cast<uint8_t>(ml >= 15 ? 15 : ml);
+            if (ml >= 15) op = write_length(op, ml - 15);
+
+            return op;
+        }
+
+        inline bool read_length(const uint8_t *&ip, const uint8_t *end, size_t &len) {
+            uint8_t b;
+            do {
+                if (ip >= end) return false;
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+            return true;
+        }
+    }
+
+    size_t compress(const uint8_t *src, size_t len, uint8_t *dst) {
+        uint8_t *op = dst;
+        size_t anchor = 0;
+
+        if (len > MATCH_FIND_LIMIT) {
+            uint32_t table[1 << HASH_BITS] = {};
+            const size_t match_find_end = len - MATCH_FIND_LIMIT;
+            const size_t match_end = len - LAST_LITERALS;
+
+            size_t ip = 1;
+            while (ip < match_find_end) {
+                uint32_t sequence = read32(src + ip);
+                uint32_t h = hash(sequence);
+                size_t candidate = table[h];
+                table[h] = static_cast<uint32_t>(ip);
+
+                if (candidate >= ip || ip - candidate > MAX_OFFSET || read32(src + candidate) != sequence) {
+                    // Skip faster through data that doesn't compress
+                    ip += 1 + ((ip - anchor) >> 6);
+                    continue;
+                }
+
+                while (ip > anchor && candidate > 0 && src[ip - 1] == src[candidate - 1]) {
+                    ip--;
+                    candidate--;
+                }
+
+                size_t match_len = MIN_MATCH;
+                while (ip + match_len < match_end && src[candidate + match_len] == src[ip + match_len]) {
+                    match_len++;
+                }
+
+                op = write_sequence(op, src + anchor, ip - anchor, ip - candidate, match_len);
+                ip += match_len;
+                anchor = ip;
+
+                if (ip < match_find_end) {
+                    table[hash(read32(src + ip - 2))] = static_cast<uint32_t>(ip - 2);
+                }
+            }
+        }
+
+        op = write_sequence(op, src + anchor, len - anchor, 0, 0);
+        return static_cast<size_t>(op - dst);
+    }
+
+    bool decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len) {
+        const uint8_t *ip = src;
+        const uint8_t *ip_end = src + len;
+        uint8_t *op = dst;
+        uint8_t *op_end = dst + dst_len;
+
+        while (ip < ip_end) {
+            uint8_t token = *ip++;
+
+            size_t literal_len = token >> 4;
+            if (literal_len == 15 && !read_length(ip, ip_end, literal_len)) return false;
+            if (literal_len > static_cast<size_t>(ip_end - ip) || literal_len > static_cast<size_t>(op_end - op)) {
+                return false;
+            }
+            std::memcpy(op, ip, literal_len);
+            ip += literal_len;
+            op += literal_len;
+
+            if (ip == ip_end) break;
+
+            if (ip_end - ip < 2) return false;
+            size_t offset = ip[0] | (ip[1] << 8);
+            ip += 2;
+            if (offset == 0 || offset > static_cast<size_t>(op - dst)) return false;
+
+            size_t match_len = token & 0xF;
+            if (match_len == 15 && !read_length(ip, ip_end, match_len)) return false;
+            match_len += MIN_MATCH;
+            if (match_len > static_cast<size_t>(op_end - op)) return false;
+
+            // Matches can overlap their own output, copy forwards a byte at a time
+            const uint8_t *match = op - offset;
+            for (size_t i = 0; i < match_len; i++) {
+                op[i] = match[i];
+            }
+            op += match_len;
+        }
+
+        return op == op_end;
+    }
+}
@@ -0,0 +1,27 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_COMPRESSION__
+#define __CANARY_COMPRESSION__
+
+#include <cstddef>
+#include <cstdint>
+
+namespace canary::compression {
+
+    // Block compression using the LZ4 block format: greedy matching with a 4096-entry hash table, no entropy coding.
+    // Fast enough to keep up with capture on a single core.
+
+    // Largest possible compressed size for len input bytes
+    constexpr size_t compress_bound(size_t len) {
+        return len + len / 255 + 16;
+    }
+
+    // dst must have room for compress_bound(len) bytes. Returns the compressed size.
+    size_t compress(const uint8_t *src, size_t len, uint8_t *dst);
+
+    // Decompresses exactly dst_len bytes, returns false if the input is malformed or the wrong size
+    bool decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t dst_len);
+
+}
+
+#endif
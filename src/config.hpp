@@ -18,17 +18,23 @@ namespace canary::config {
 
     struct connection {
         std::string name;
+        // "socketcand" (params: host, port, interface), "socketcan" (params: interface) or "replay" (params: path,
+        // speed, loop)
         std::string can_type;
         std::map<std::string, nlohmann::json> can_params;
-        bool canaryd_enabled;
+        bool canaryd_enabled = false;
         std::string canaryd_host;
-        int canaryd_port;
+        int canaryd_port = 0;
+        // Captured when CANary starts
+        bool enabled = true;
     };
 
     struct connection_options {
         bool non_blocking = true;
         int timeout = 5;
-        int cooldown = 100;
+        // Received frames kept in memory, in MB. Older frames are spilled to a temporary file. 0 for no limit. Filter,
+        // search and signal views over the frames are not counted.
+        int memory_budget_mb = 1024;
     };
 
     struct config {
@@ -51,10 +57,11 @@ namespace canary::config {
 
     NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(canary::config::ui_options, open_dialogs);
 
-    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(canary::config::connection, name, can_type, can_params, canaryd_enabled,
-                                       canaryd_host, canaryd_port)
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(canary::config::connection, name, can_type, can_params,
+                                                    canaryd_enabled, canaryd_host, canaryd_port, enabled)
 
-    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(canary::config::connection_options, non_blocking, timeout, cooldown)
+    NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(canary::config::connection_options, non_blocking, timeout,
+                                                    memory_budget_mb)
 
     NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE(canary::config::config, ui_opts, connections, conn_opts)
 }
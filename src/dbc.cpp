@@ -1,74 +1,561 @@
 // Copyright (C) 2024 Ryan Bester
 
 #include "dbc.hpp"
+#include "dbcdecoder.hpp"
+#include "mappedfile.hpp"
 
-#include "main.hpp"
-
-#include <iostream>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <format>
 
 namespace canary {
-    dbcfile dbcparser::load_dbc_file(const std::string &file_path) {
-        dbcfile dbc;
+    namespace {
+        // Statements that end with a semicolon and can span lines, skipped as a whole when not read
+        constexpr std::array<std::string_view, 16> SKIPPED_STATEMENTS = {
+                "EV_", "ENVVAR_DATA_", "SGTYPE_", "SGTYPE_VAL_", "BA_DEF_", "BA_DEF_SGTYPE_", "BA_DEF_REL_",
+                "BA_DEF_DEF_REL_", "BA_REL_", "BA_SGTYPE_", "SIG_TYPE_REF_", "SIG_GROUP_", "SIGTYPE_VALTYPE_",
+                "BO_TX_BU_", "CAT_DEF_", "CAT_"
+        };
+
+        inline bool is_separator(char c) {
+            switch (c) {
+                case ' ':
+                case '\t':
+                case '\r':
+                case '\n':
+                case ':':
+                case ';':
+                case ',':
+                case '|':
+                case '@':
+                case '(':
+                case ')':
+                case '[':
+                case ']':
+                case '"':
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // Cursor over DBC text. Tokens are views into the text, nothing is allocated until a value is stored.
+        class dbc_reader {
+        public:
+            explicit dbc_reader(std::string_view text) : m_text(text) {}
+
+            [[nodiscard]] inline bool at_end() const { return m_pos >= m_text.size(); }
+
+            [[nodiscard]] inline size_t get_pos() const { return m_pos; }
+
+            [[nodiscard]] inline char peek() const { return at_end() ? '\0' : m_text[m_pos]; }
+
+            void skip_space() {
+                while (!at_end()) {
+                    char c = m_text[m_pos];
+                    if (c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
+                    m_pos++;
+                }
+            }
+
+            // Consumes c if it is the next character after any whitespace
+            bool accept(char c) {
+                skip_space();
+                if (peek() != c) return false;
+                m_pos++;
+                return true;
+            }
+
+            // Identifier, keyword or bare value up to the next whitespace or punctuation, empty if there is none
+            std::string_view word() {
+                skip_space();
+                size_t start = m_pos;
+                while (!at_end() && !is_separator(m_text[m_pos])) m_pos++;
+                return m_text.substr(start, m_pos - start);
+            }
+
+            template<typename T>
+            bool number(T &value) {
+                skip_space();
+                const char *first = m_text.data() + m_pos;
+                const char *last = m_text.data() + m_text.size();
+                // from_chars does not take an explicit plus sign
+                if (first != last && *first == '+') first++;
+
+                auto [ptr, ec] = std::from_chars(first, last, value);
+                if (ec != std::errc()) return false;
+                m_pos = ptr - m_text.data();
+                return true;
+            }
+
+            // Double quoted string with \" and \\ escapes, which can span lines
+            bool quoted(std::string &value) {
+                if (!accept('"')) return false;
+
+                value.clear();
+                size_t start = m_pos;
+                while (!at_end()) {
+                    char c = m_text[m_pos];
+                    if (c == '"') {
+                        value.append(m_text.substr(start, m_pos - start));
+                        m_pos++;
+                        return true;
+                    }
+                    if (c == '\\' && m_pos + 1 < m_text.size()) {
+                        // Keep the escaped character as the start of the next run
+                        value.append(m_text.substr(start, m_pos - start));
+                        start = m_pos + 1;
+                        m_pos += 2;
+                        continue;
+                    }
+                    m_pos++;
+                }
+                return false;
+            }
+
+            // Remainder of the line after any whitespace
+            std::string_view rest_of_line() {
+                skip_space();
+                size_t end = std::min(m_text.find('\n', m_pos), m_text.size());
+                size_t start = m_pos;
+                m_pos = end;
+                while (end > start && (m_text[end - 1] == ' ' || m_text[end - 1] == '\t' || m_text[end - 1] == '\r')) {
+                    end--;
+                }
+                return m_text.substr(start, end - start);
+            }
+
+            // Returns a reader over the rest of the current line and moves this one to the start of the next
+            dbc_reader take_line() {
+                size_t end = std::min(m_text.find('\n', m_pos), m_text.size());
+                dbc_reader line(m_text.substr(m_pos, end - m_pos));
+                m_pos = std::min(end + 1, m_text.size());
+                return line;
+            }
+
+            // Moves past the next semicolon outside a string
+            void skip_statement() {
+                while (!at_end()) {
+                    char c = m_text[m_pos++];
+                    if (c == ';') return;
+                    if (c == '"') {
+                        while (!at_end() && m_text[m_pos] != '"') {
+                            m_pos += (m_text[m_pos] == '\\') ? 2 : 1;
+                        }
+                        m_pos++;
+                    }
+                }
+            }
+
+            [[nodiscard]] size_t line_of(size_t pos) const {
+                return std::count(m_text.begin(), m_text.begin() + static_cast<std::ptrdiff_t>(pos), '\n') + 1;
+            }
+
+        private:
+            std::string_view m_text;
+            size_t m_pos{0};
+        };
+
+        class dbc_builder {
+        public:
+            dbc_builder(std::string_view text, const std::function<void(std::string message)> &error_handler)
+                    : m_reader(text), m_error_handler(error_handler) {}
+
+            dbcfile build() {
+                while (true) {
+                    m_reader.skip_space();
+                    if (m_reader.at_end()) break;
+
+                    m_statement = m_reader.get_pos();
+                    const std::string_view keyword = m_reader.word();
+                    if (keyword.empty()) {
+                        // Stray punctuation
+                        report("Unexpected character");
+                        m_reader.take_line();
+                    } else if (!parse_statement(keyword)) {
+                        report(std::format("Invalid {} statement", keyword));
+                    }
+                }
+
+                // SG_MUL_VAL_ comes after the messages, multiplexing can only be resolved once the whole file is read
+                for (auto &[id, message]: m_dbc.messages) {
+                    message.mux = compile_multiplexing(message);
+                }
+                return std::move(m_dbc);
+            }
+
+        private:
+            dbc_reader m_reader;
+            const std::function<void(std::string message)> &m_error_handler;
+            dbcfile m_dbc;
+            // Message the following SG_ lines belong to
+            dbc_message *m_message{nullptr};
+            // Start of the statement being parsed
+            size_t m_statement{0};
+            std::string m_string;
+
+            void report(const std::string &message) {
+                if (m_error_handler) {
+                    m_error_handler(std::format("Line {}: {}", m_reader.line_of(m_statement), message));
+                }
+            }
+
+            // Returns false if the statement was malformed, the reader is then past it either way
+            bool parse_statement(std::string_view keyword) {
+                // Line based statements
+                if (keyword == "BO_") {
+                    auto line = m_reader.take_line();
+                    return parse_message(line);
+                }
+                if (keyword == "SG_") {
+                    auto line = m_reader.take_line();
+                    return parse_signal(line);
+                }
+                if (keyword == "BU_") {
+                    auto line = m_reader.take_line();
+                    return parse_nodes(line);
+                }
+                if (keyword == "VERSION") {
+                    auto line = m_reader.take_line();
+                    return line.quoted(m_dbc.version);
+                }
+                if (keyword == "NS_") {
+                    skip_new_symbols();
+                    return true;
+                }
 
-        std::ifstream file(file_path);
+                // Semicolon terminated statements
+                bool ok;
+                if (keyword == "CM_") {
+                    ok = parse_comment();
+                } else if (keyword == "BA_") {
+                    ok = parse_attribute();
+                } else if (keyword == "BA_DEF_DEF_") {
+                    ok = parse_attribute_default();
+                } else if (keyword == "VAL_") {
+                    ok = parse_values();
+                } else if (keyword == "VAL_TABLE_") {
+                    ok = parse_value_table();
+                } else if (keyword == "SG_MUL_VAL_") {
+                    ok = parse_multiplex_values();
+                } else if (keyword == "SIG_VALTYPE_") {
+                    ok = parse_value_type();
+                } else if (std::find(SKIPPED_STATEMENTS.begin(), SKIPPED_STATEMENTS.end(), keyword) !=
+                           SKIPPED_STATEMENTS.end()) {
+                    m_reader.skip_statement();
+                    return true;
+                } else {
+                    // BS_ and anything unknown
+                    m_reader.take_line();
+                    return true;
+                }
 
-        std::string line;
-        long last_message_id = 0;
-        while (std::getline(file, line)) {
-            if (line.starts_with("BO_")) { // Message
-                auto parts = split_string(line, " ");
+                if (!ok) m_reader.skip_statement();
+                return ok;
+            }
+
+            // BO_ <id> <name>: <length> <sender>
+            bool parse_message(dbc_reader &line) {
+                m_message = nullptr;
+
+                uint32_t id;
+                if (!line.number(id)) return false;
+                auto name = line.word();
+                if (name.empty() || !line.accept(':')) return false;
+                int length;
+                if (!line.number(length)) return false;
+                auto sender = line.word();
+
+                const long can_id = static_cast<long>(id);
+                auto [it, inserted] = m_dbc.messages.try_emplace(can_id, can_id, std::string(name), length,
+                                                                 std::string(sender));
+                // A repeated ID keeps the first definition, as before, but takes the new signals
+                if (!inserted) report(std::format("Duplicate message ID {}", id));
+                m_message = &it->second;
+                return true;
+            }
+
+            // SG_ <name> [M|m<value>[M]] : <start>|<length>@<order><sign> (<scale>,<offset>) [<min>|<max>] "<unit>"
+            //     <receivers>
+            bool parse_signal(dbc_reader &line) {
+                if (!m_message) return false;
+
+                auto name = line.word();
+                if (name.empty()) return false;
+
+                bool is_multiplexor = false;
+                int64_t multiplex_value = -1;
+                if (!line.accept(':')) {
+                    auto indicator = line.word();
+                    if (indicator.starts_with('m')) {
+                        auto [ptr, ec] = std::from_chars(indicator.data() + 1, indicator.data() + indicator.size(),
+                                                         multiplex_value);
+                        if (ec != std::errc()) return false;
+                        indicator.remove_prefix(ptr - indicator.data());
+                    }
+                    if (indicator == "M") {
+                        is_multiplexor = true;
+                    } else if (!indicator.empty()) {
+                        return false;
+                    }
+                    if (!line.accept(':')) return false;
+                }
+
+                int start, length;
+                if (!line.number(start) || !line.accept('|') || !line.number(length) || !line.accept('@')) {
+                    return false;
+                }
+                auto layout = line.word();
+                if (layout.size() != 2 || (layout[0] != '0' && layout[0] != '1') ||
+                    (layout[1] != '+' && layout[1] != '-')) {
+                    return false;
+                }
+
+                double scale, offset, min, max;
+                if (!line.accept('(') || !line.number(scale) || !line.accept(',') || !line.number(offset) ||
+                    !line.accept(')')) {
+                    return false;
+                }
+                if (!line.accept('[') || !line.number(min) || !line.accept('|') || !line.number(max) ||
+                    !line.accept(']')) {
+                    return false;
+                }
+                if (!line.quoted(m_string)) return false;
+
+                auto &signal = m_message->signals.emplace_back(
+                        std::string(name), start, length, layout[0] == '1', layout[1] == '-',
+                        static_cast<float>(scale), static_cast<float>(offset), static_cast<float>(min),
+                        static_cast<float>(max), m_string, std::string(line.rest_of_line()));
+                signal.is_multiplexor = is_multiplexor;
+                signal.multiplex_value = multiplex_value;
+                signal.plan = compile_signal(signal);
+                return true;
+            }
+
+            // BU_: <node> <node> ...
+            bool parse_nodes(dbc_reader &line) {
+                if (!line.accept(':')) return false;
+                for (auto node = line.word(); !node.empty(); node = line.word()) {
+                    m_dbc.nodes.emplace_back(node);
+                }
+                return true;
+            }
+
+            // Skips the list of symbols after NS_ :, one indented name per line
+            void skip_new_symbols() {
+                m_reader.take_line();
+                while (true) {
+                    const char c = m_reader.peek();
+                    if (c != ' ' && c != '\t') return;
+
+                    // A line with more than a name on it is the next statement, indented
+                    auto probe = m_reader;
+                    auto line = probe.take_line();
+                    line.word();
+                    line.skip_space();
+                    if (!line.at_end()) return;
+                    m_reader = probe;
+                }
+            }
+
+            dbc_message *find_message(uint32_t id) {
+                auto it = m_dbc.messages.find(static_cast<long>(id));
+                return it == m_dbc.messages.end() ? nullptr : &it->second;
+            }
 
-                std::string suffix = ":";
+            dbc_signal *find_signal(uint32_t id, std::string_view name) {
+                auto *message = find_message(id);
+                if (!message) return nullptr;
+                for (auto &signal: message->signals) {
+                    if (signal.name == name) return &signal;
+                }
+                return nullptr;
+            }
 
-                auto can_id = parts[1];
-                auto name = parts[2].substr(0, parts[2].length() - suffix.length());
-                auto length = parts[3];
-                auto sender = parts[4];
+            // CM_ ["<comment>" | BU_ <node> "<comment>" | BO_ <id> "<comment>" | SG_ <id> <signal> "<comment>" |
+            //     EV_ <variable> "<comment>"];
+            bool parse_comment() {
+                m_reader.skip_space();
+                if (m_reader.peek() == '"') {
+                    return m_reader.quoted(m_dbc.comment) && m_reader.accept(';');
+                }
 
-                dbc_message message = dbc_message(std::stol(can_id), name, std::stoi(length), sender);
-                dbc.messages.insert(std::make_pair(std::stol(can_id), message));
-                last_message_id = message.can_id;
+                auto type = m_reader.word();
+                std::string *target = nullptr;
+                if (type == "BU_") {
+                    auto node = m_reader.word();
+                    if (node.empty()) return false;
+                    target = &m_dbc.node_comments[std::string(node)];
+                } else if (type == "BO_") {
+                    uint32_t id;
+                    if (!m_reader.number(id)) return false;
+                    auto *message = find_message(id);
+                    if (!message) return false;
+                    target = &message->comment;
+                } else if (type == "SG_") {
+                    uint32_t id;
+                    if (!m_reader.number(id)) return false;
+                    auto *signal = find_signal(id, m_reader.word());
+                    if (!signal) return false;
+                    target = &signal->comment;
+                } else if (type == "EV_") {
+                    // Environment variables are not kept
+                    if (m_reader.word().empty()) return false;
+                    target = &m_string;
+                } else {
+                    return false;
+                }
 
-                // TODO: Some lines start with a space
-            } else if (line.starts_with(" SG_")) { // Signal
-                auto parts = split_string(line, " ");
+                return m_reader.quoted(*target) && m_reader.accept(';');
+            }
 
-                auto name = parts[2];
+            // Attribute value: a string, or a number or enum index as written
+            bool parse_attribute_value(std::string &value) {
+                m_reader.skip_space();
+                if (m_reader.peek() == '"') return m_reader.quoted(value);
 
-                auto bit_layout_parts = split_string(parts[4], "@");
-                auto start_end = split_string(bit_layout_parts[0], "|");
+                auto token = m_reader.word();
+                if (token.empty()) return false;
+                value.assign(token);
+                return true;
+            }
 
-                auto start = start_end[0];
-                auto length = start_end[1];
-                auto little_endian = (bit_layout_parts[1][0] == '1');
-                auto is_signed = (bit_layout_parts[1][1] == '-');
+            // BA_ "<name>" [BU_ <node> | BO_ <id> | SG_ <id> <signal> | EV_ <variable>] <value>;
+            bool parse_attribute() {
+                std::string name;
+                if (!m_reader.quoted(name)) return false;
 
-                auto scale_offset_parts = split_string(parts[5].substr(1, parts[5].length() - 2), ",");
+                m_reader.skip_space();
+                dbc_attributes *target = &m_dbc.attributes;
+                if (m_reader.peek() != '"') {
+                    auto checkpoint = m_reader;
+                    auto type = m_reader.word();
+                    if (type == "BO_") {
+                        uint32_t id;
+                        if (!m_reader.number(id)) return false;
+                        auto *message = find_message(id);
+                        if (!message) return false;
+                        target = &message->attributes;
+                    } else if (type == "SG_") {
+                        uint32_t id;
+                        if (!m_reader.number(id)) return false;
+                        auto *signal = find_signal(id, m_reader.word());
+                        if (!signal) return false;
+                        target = &signal->attributes;
+                    } else if (type == "BU_" || type == "EV_") {
+                        // Node and environment variable attributes are not kept
+                        if (m_reader.word().empty()) return false;
+                        target = nullptr;
+                    } else {
+                        // A bare network attribute value
+                        m_reader = checkpoint;
+                    }
+                }
+
+                if (!parse_attribute_value(m_string) || !m_reader.accept(';')) return false;
+                if (target) (*target)[std::move(name)] = m_string;
+                return true;
+            }
 
-                auto scale = scale_offset_parts[0];
-                auto offset = scale_offset_parts[1];
+            // BA_DEF_DEF_ "<name>" <value>;
+            bool parse_attribute_default() {
+                std::string name;
+                if (!m_reader.quoted(name) || !parse_attribute_value(m_string) || !m_reader.accept(';')) return false;
+                m_dbc.attribute_defaults[std::move(name)] = m_string;
+                return true;
+            }
 
-                auto min_max_parts = split_string(parts[6].substr(1, parts[6].length() - 2), "|");
+            // <value> "<description>" ... ;
+            bool parse_value_descriptions(dbc_value_table *values) {
+                while (!m_reader.accept(';')) {
+                    int64_t value;
+                    if (!m_reader.number(value)) return false;
+                    // Some tools write whole numbers as decimals, drop the fraction
+                    if (m_reader.peek() == '.') m_reader.word();
+                    if (!m_reader.quoted(m_string)) return false;
+                    if (values) values->emplace_back(value, m_string);
+                }
+                return true;
+            }
 
-                auto min = min_max_parts[0];
-                auto max = min_max_parts[1];
+            // VAL_ <id> <signal> <descriptions>; or VAL_ <variable> <descriptions>;
+            bool parse_values() {
+                uint32_t id;
+                if (!m_reader.number(id)) {
+                    // Environment variable, not kept
+                    if (m_reader.word().empty()) return false;
+                    return parse_value_descriptions(nullptr);
+                }
 
-                auto unit = parts[7];
-                unit.erase(std::remove(unit.begin(), unit.end(), '"'), unit.end());
+                auto *signal = find_signal(id, m_reader.word());
+                if (!signal) return false;
+                signal->values.clear();
+                return parse_value_descriptions(&signal->values);
+            }
 
-                auto receiver = parts[9];
+            // VAL_TABLE_ <name> <descriptions>;
+            bool parse_value_table() {
+                auto name = m_reader.word();
+                if (name.empty()) return false;
+                auto &table = m_dbc.value_tables[std::string(name)];
+                table.clear();
+                return parse_value_descriptions(&table);
+            }
 
-                dbc_signal signal(
-                        name, std::stoi(start), std::stoi(length), little_endian, is_signed,
-                        std::stof(scale), std::stof(offset), std::stof(min), std::stof(max),
-                        unit, receiver
-                        );
+            // SG_MUL_VAL_ <id> <signal> <multiplexor> <from>-<to>, ... ;
+            bool parse_multiplex_values() {
+                uint32_t id;
+                if (!m_reader.number(id)) return false;
+                auto *signal = find_signal(id, m_reader.word());
+                if (!signal) return false;
+                auto multiplexor = m_reader.word();
+                if (multiplexor.empty()) return false;
 
-                dbc.messages.at(last_message_id).signals.push_back(signal);
+                signal->multiplexor.assign(multiplexor);
+                signal->multiplex_ranges.clear();
+                do {
+                    uint64_t from, to;
+                    if (!m_reader.number(from) || !m_reader.accept('-') || !m_reader.number(to)) return false;
+                    signal->multiplex_ranges.emplace_back(from, to);
+                } while (m_reader.accept(','));
+                return m_reader.accept(';');
             }
+
+            // SIG_VALTYPE_ <id> <signal> : <type>; 1 for IEEE float, 2 for double. Some tools leave out the colon.
+            bool parse_value_type() {
+                uint32_t id;
+                if (!m_reader.number(id)) return false;
+                auto *signal = find_signal(id, m_reader.word());
+                if (!signal) return false;
+
+                m_reader.accept(':');
+                int type;
+                if (!m_reader.number(type) || type < 0 || type > 2 || !m_reader.accept(';')) return false;
+
+                // Comes after the SG_ line, the plan was built for an integer
+                signal->value_type = static_cast<dbc_value_type>(type);
+                signal->plan = compile_signal(*signal);
+                return true;
+            }
+        };
+    }
+
+    dbcfile dbcparser::load_dbc_file(const std::string &file_path,
+                                     const std::function<void(std::string message)> &error_handler) {
+        mapped_file file;
+        if (file.open(file_path, true) != 0) {
+            if (error_handler) error_handler(std::format("Error opening DBC file: {}", file_path));
+            return {};
         }
 
-        return dbc;
+        return parse_dbc({reinterpret_cast<const char *>(file.get_data()), file.get_size()}, error_handler);
     }
-}
 
+    dbcfile dbcparser::parse_dbc(std::string_view text, const std::function<void(std::string message)> &error_handler) {
+        // UTF-8 byte order mark
+        if (text.starts_with("\xEF\xBB\xBF")) text.remove_prefix(3);
+
+        return dbc_builder(text, error_handler).build();
+    }
+}
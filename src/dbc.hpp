@@ -4,11 +4,80 @@
 #define __CANARY_DBC__
 
 #include <string>
-#include <fstream>
+#include <string_view>
+#include <cstdint>
+#include <functional>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 namespace canary {
+    // How a signal's raw bits encode its value, from SIG_VALTYPE_
+    enum class dbc_value_type : uint8_t {
+        integer = 0,
+        // 32-bit signal holding an IEEE 754 float
+        ieee_float = 1,
+        // 64-bit signal holding an IEEE 754 double
+        ieee_double = 2,
+    };
+
+    // Shift/mask plan for extracting a signal from a payload, built once per signal by compile_signal() in
+    // dbcdecoder.hpp so decoding needs no per-bit work
+    struct dbc_signal_plan {
+        // First payload byte of the 64-bit load
+        uint16_t byte{0};
+        // Intel: right shift of the little-endian word. Motorola: bits used in the big-endian word.
+        uint8_t shift{0};
+        // Bits that fall past the 64-bit word and come from the following byte
+        uint8_t spill{0};
+        bool motorola{false};
+        bool is_signed{false};
+        // False if the layout does not fit a CAN FD payload, the signal cannot be decoded
+        bool valid{false};
+        // Raw bits are reinterpreted rather than sign extended for IEEE types
+        dbc_value_type value_type{dbc_value_type::integer};
+        uint64_t mask{0};
+        uint64_t sign_bit{0};
+        double scale{1};
+        double offset{0};
+    };
+
+    // Signals present while a multiplexor's raw value is in from..to, inclusive. Signals run first_signal to
+    // first_signal + signal_count in dbc_mux_plan::signals, then the switches of the multiplexors among them.
+    struct dbc_mux_case {
+        uint64_t from{0};
+        uint64_t to{~0ULL};
+        uint32_t first_signal{0};
+        uint32_t signal_count{0};
+        uint32_t first_switch{0};
+        uint32_t switch_count{0};
+    };
+
+    // Selects one of a multiplexor's cases, which are sorted and do not overlap
+    struct dbc_mux_switch {
+        // Index of the multiplexor in dbc_message::signals
+        uint32_t multiplexor{0};
+        uint32_t first_case{0};
+        uint32_t case_count{0};
+    };
+
+    // Which signals a multiplexed message holds for each multiplexor value, built once per message by
+    // compile_multiplexing() in dbcdecoder.hpp. cases[0] holds the signals present in every frame, so decoding is one
+    // lookup per multiplexor instead of a check on every signal. Empty for messages without multiplexed signals.
+    struct dbc_mux_plan {
+        std::vector<dbc_mux_case> cases;
+        std::vector<dbc_mux_switch> switches;
+        std::vector<uint32_t> signals;
+
+        [[nodiscard]] inline bool empty() const { return cases.empty(); }
+    };
+
+    // Value descriptions from VAL_ or VAL_TABLE_, e.g. 0 "Off" 1 "On", in file order
+    using dbc_value_table = std::vector<std::pair<int64_t, std::string>>;
+
+    // Attribute values from BA_ by attribute name. Strings are unquoted, numbers and enum indices kept as written.
+    using dbc_attributes = std::unordered_map<std::string, std::string>;
+
     struct dbc_signal {
         std::string name;
         int start;
@@ -20,8 +89,26 @@ namespace canary {
         float min;
         float max;
         std::string unit;
+        // Receiving nodes, comma separated
         std::string receiver;
 
+        std::string comment;
+        dbc_value_table values;
+        dbc_attributes attributes;
+
+        // "M": this signal's value selects which multiplexed signals are present in the message
+        bool is_multiplexor{false};
+        // "mN": present only when the multiplexor is N, -1 if always present
+        int64_t multiplex_value{-1};
+        // Extended multiplexing from SG_MUL_VAL_: the multiplexor this signal depends on and the ranges of its value,
+        // inclusive, in which the signal is present. Empty for simple multiplexing.
+        std::string multiplexor;
+        std::vector<std::pair<uint64_t, uint64_t>> multiplex_ranges;
+
+        dbc_value_type value_type{dbc_value_type::integer};
+
+        dbc_signal_plan plan{};
+
         dbc_signal(const std::string &name, int start, int length, bool littleEndian, bool isSigned, float scale,
                    float offset, float min, float max, const std::string &unit, const std::string &receiver) : name(
                 name), start(start), length(length), little_endian(littleEndian), is_signed(isSigned), scale(scale),
@@ -41,6 +128,11 @@ namespace canary {
 
         std::vector<dbc_signal> signals;
 
+        std::string comment;
+        dbc_attributes attributes;
+
+        dbc_mux_plan mux;
+
         dbc_message() = default;
 
         dbc_message(long canId, const std::string &name, int length, const std::string &sender) : can_id(canId),
@@ -52,11 +144,29 @@ namespace canary {
     class dbcfile {
     public:
         std::unordered_map<long, dbc_message> messages;
+
+        std::string version;
+        std::vector<std::string> nodes;
+        std::unordered_map<std::string, std::string> node_comments;
+        std::unordered_map<std::string, dbc_value_table> value_tables;
+        std::string comment;
+        // Network attributes, and the defaults from BA_DEF_DEF_ for every object type
+        dbc_attributes attributes;
+        dbc_attributes attribute_defaults;
     };
 
+    // Single pass DBC parser. Reads BO_, SG_ (with multiplexor indicators), BU_, VERSION, CM_, BA_, BA_DEF_DEF_, VAL_,
+    // VAL_TABLE_, SG_MUL_VAL_ and SIG_VALTYPE_. Everything else in the grammar (NS_, BS_, EV_, BA_DEF_, BO_TX_BU_,
+    // SIG_GROUP_...) is recognised and skipped. Statements may be indented, and comments may span lines.
     class dbcparser {
     public:
-        static dbcfile load_dbc_file(const std::string &file_path);
+        // Maps the file rather than reading it, so nothing is copied until a value is stored. Statements that cannot
+        // be parsed are skipped and reported through error_handler with their line number.
+        static dbcfile load_dbc_file(const std::string &file_path,
+                                     const std::function<void(std::string message)> &error_handler = {});
+
+        static dbcfile parse_dbc(std::string_view text,
+                                 const std::function<void(std::string message)> &error_handler = {});
     };
 
 }
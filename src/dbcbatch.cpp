@@ -0,0 +1,405 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "dbcbatch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CANARY_DBCBATCH_SSE2
+#endif
+
+namespace canary {
+    namespace {
+        inline uint64_t swap_bytes(uint64_t v) {
+            v = ((v & 0x00FF00FF00FF00FFULL) << 8) | ((v >> 8) & 0x00FF00FF00FF00FFULL);
+            v = ((v & 0x0000FFFF0000FFFFULL) << 16) | ((v >> 16) & 0x0000FFFF0000FFFFULL);
+            return (v << 32) | (v >> 32);
+        }
+
+        // Frames copied per read_packets() call by the background update, the render thread waits at most this long
+        // to store new frames
+        constexpr size_t READ_FRAMES = 4096;
+
+        // Decodes count frames of one series from first, a signal at a time
+        class series_decoder {
+        public:
+            series_decoder(dbcbatch::series &s, size_t first, size_t count) : m_series(s),
+                                                                              m_signals(s.message->signals),
+                                                                              m_first(first),
+                                                                              m_le_words(s.words.data() + first),
+                                                                              m_shifts(m_signals.size(), -1) {
+                if (s.needs_payloads) m_payloads = s.payloads.data() + first;
+
+                bool motorola = false;
+                for (size_t i = 0; i < m_signals.size(); i++) {
+                    unsigned shift;
+                    if (get_word_shift(m_signals[i].plan, shift)) {
+                        m_shifts[i] = static_cast<int>(shift);
+                        motorola |= m_signals[i].plan.motorola;
+                    }
+                }
+
+                // Motorola signals are read from the big-endian word, the same bytes in reverse
+                if (motorola) {
+                    m_be_words.resize(count);
+                    for (size_t i = 0; i < count; i++) m_be_words[i] = swap_bytes(m_le_words[i]);
+                }
+            }
+
+            // rows are indices into the frames being decoded, nullptr for all count of them
+            void decode_signal(uint32_t signal, const uint32_t *rows, size_t count) {
+                const auto &plan = m_signals[signal].plan;
+                double *out = m_series.columns[signal].values.data() + m_first;
+
+                if (!plan.valid) {
+                    for (size_t i = 0; i < count; i++) out[rows ? rows[i] : i] = 0;
+                    return;
+                }
+                if (m_shifts[signal] < 0) {
+                    for (size_t i = 0; i < count; i++) {
+                        const size_t row = rows ? rows[i] : i;
+                        out[row] = canary::decode_signal(plan, m_payloads[row]);
+                    }
+                    return;
+                }
+
+                const auto shift = static_cast<unsigned>(m_shifts[signal]);
+                const uint64_t *words = plan.motorola ? m_be_words.data() : m_le_words;
+                if (!rows) {
+                    decode_column(plan, shift, words, count, out);
+                    return;
+                }
+
+                // Gather the words of the selected frames so they still decode as a column
+                m_gathered.resize(count);
+                m_values.resize(count);
+                for (size_t i = 0; i < count; i++) m_gathered[i] = words[rows[i]];
+                decode_column(plan, shift, m_gathered.data(), count, m_values.data());
+                for (size_t i = 0; i < count; i++) out[rows[i]] = m_values[i];
+            }
+
+            void decode_case(const dbc_mux_case &c, const uint32_t *rows, size_t count) {
+                const auto &mux = m_series.message->mux;
+                for (uint32_t i = c.first_signal; i < c.first_signal + c.signal_count; i++) {
+                    decode_signal(mux.signals[i], rows, count);
+                }
+
+                for (uint32_t i = c.first_switch; i < c.first_switch + c.switch_count; i++) {
+                    const auto &sw = mux.switches[i];
+
+                    // Split the frames between the cases of the switch, then decode each case's signals together
+                    std::vector<std::vector<uint32_t>> selected(sw.case_count);
+                    for (size_t j = 0; j < count; j++) {
+                        const auto row = static_cast<uint32_t>(rows ? rows[j] : j);
+                        if (const auto *e = find_mux_case(mux, sw, raw(sw.multiplexor, row))) {
+                            selected[e - mux.cases.data() - sw.first_case].push_back(row);
+                        }
+                    }
+                    for (uint32_t j = 0; j < sw.case_count; j++) {
+                        if (selected[j].empty()) continue;
+                        decode_case(mux.cases[sw.first_case + j], selected[j].data(), selected[j].size());
+                    }
+                }
+            }
+
+        private:
+            dbcbatch::series &m_series;
+            const std::vector<dbc_signal> &m_signals;
+            // Column index of the first frame being decoded
+            size_t m_first;
+            const uint64_t *m_le_words;
+            const dbc_payload *m_payloads{nullptr};
+            // From get_word_shift(), -1 for signals that do not fit the words
+            std::vector<int> m_shifts;
+            std::vector<uint64_t> m_be_words;
+            std::vector<uint64_t> m_gathered;
+            std::vector<double> m_values;
+
+            uint64_t raw(uint32_t signal, uint32_t row) const {
+                const auto &plan = m_signals[signal].plan;
+                if (m_shifts[signal] < 0) return extract_raw(plan, m_payloads[row]);
+
+                const uint64_t *words = plan.motorola ? m_be_words.data() : m_le_words;
+                return (words[row] >> m_shifts[signal]) & plan.mask;
+            }
+        };
+    }
+
+    bool get_word_shift(const dbc_signal_plan &plan, unsigned &shift) {
+        if (!plan.valid || plan.spill) return false;
+
+        if (!plan.motorola) {
+            const int bit = plan.byte * 8 + plan.shift;
+            if (bit + std::bit_width(plan.mask) > 64) return false;
+            shift = bit;
+        } else {
+            // The plan's shift is from the end of the word loaded at its byte, which ends 8 bits later per byte
+            if (plan.shift < plan.byte * 8) return false;
+            shift = plan.shift - plan.byte * 8;
+        }
+        return true;
+    }
+
+    void decode_column(const dbc_signal_plan &plan, unsigned shift, const uint64_t *words, size_t count, double *out) {
+        const uint64_t mask = plan.mask;
+        const uint64_t sign_bit = plan.sign_bit;
+        size_t i = 0;
+
+        if (plan.value_type != dbc_value_type::integer) {
+            for (; i < count; i++) {
+                out[i] = ieee_value(plan.value_type, (words[i] >> shift) & mask) * plan.scale + plan.offset;
+            }
+            return;
+        }
+
+#ifdef CANARY_DBCBATCH_SSE2
+        if (mask < (1ULL << 52)) {
+            const __m128i vmask = _mm_set1_epi64x(static_cast<long long>(mask));
+            const __m128i vshift = _mm_cvtsi32_si128(static_cast<int>(shift));
+            const __m128d vscale = _mm_set1_pd(plan.scale);
+            const __m128d voffset = _mm_set1_pd(plan.offset);
+
+            // Adding the raw value to the bits of 2^52 (2^52 + 2^51 when signed, so negative values borrow from the
+            // 2^51) gives a double holding exactly that much more
+            const bool is_signed = plan.is_signed;
+            const __m128i vsign = _mm_set1_epi64x(static_cast<long long>(sign_bit));
+            const __m128i vbias = _mm_set1_epi64x(is_signed ? 0x4338000000000000LL : 0x4330000000000000LL);
+            const __m128d vbias_value = _mm_set1_pd(is_signed ? 6755399441055744.0 : 4503599627370496.0);
+
+            for (; i + 2 <= count; i += 2) {
+                __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i *>(words + i));
+                raw = _mm_and_si128(_mm_srl_epi64(raw, vshift), vmask);
+                if (is_signed) raw = _mm_sub_epi64(_mm_xor_si128(raw, vsign), vsign);
+
+                __m128d value = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(raw, vbias)), vbias_value);
+                _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(value, vscale), voffset));
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            const uint64_t raw = (words[i] >> shift) & mask;
+            if (plan.is_signed) {
+                auto value = static_cast<int64_t>((raw ^ sign_bit) - sign_bit);
+                out[i] = static_cast<double>(value) * plan.scale + plan.offset;
+            } else {
+                out[i] = static_cast<double>(raw) * plan.scale + plan.offset;
+            }
+        }
+    }
+
+    dbcbatch::~dbcbatch() {
+        stop_update();
+    }
+
+    const dbcbatch::series *dbcbatch::update(const can::packetprovider &provider, dbcindex &index, uint8_t bus,
+                                             uint32_t id) {
+        const auto &packets = provider.get_received_packets();
+        check_reset(packets.size(), index);
+
+        size_t work = packets.size() - m_scanned;
+        if (const auto *s = find(bus, id)) work += s->frames.size() - s->decoded;
+        if (work < BACKGROUND_UPDATE_MIN) {
+            update(packets, index);
+            return decode(bus, id);
+        }
+
+        m_worker_index = index;
+        m_progress.store(0, std::memory_order_relaxed);
+        m_progress_total.store(packets.size() - m_scanned, std::memory_order_relaxed);
+        m_updating.store(true, std::memory_order_release);
+        m_worker = std::thread(&dbcbatch::background_update, this, std::cref(provider), provider.get_epoch(),
+                               packets.size(), bus, id);
+        return nullptr;
+    }
+
+    bool dbcbatch::is_updating() {
+        if (m_updating.load(std::memory_order_acquire)) return true;
+        if (m_worker.joinable()) m_worker.join();
+        return false;
+    }
+
+    float dbcbatch::get_progress() const {
+        const size_t total = m_progress_total.load(std::memory_order_relaxed);
+        if (total == 0) return 0;
+        return std::min(1.0f, static_cast<float>(m_progress.load(std::memory_order_relaxed)) /
+                              static_cast<float>(total));
+    }
+
+    const dbcbatch::series *dbcbatch::decode(uint8_t bus, uint32_t id) {
+        auto it = m_keys.find(dbcdatabase::make_key(bus, id & (can::FRAME_EXTENDED_FLAG | can::FRAME_EXTENDED_MASK)));
+        if (it == m_keys.end() || it->second < 0) return nullptr;
+
+        auto &s = *m_series[it->second];
+        s.last_used = ++m_decode_clock;
+        decode_series(s);
+        evict(&s);
+        return &s;
+    }
+
+    void dbcbatch::reset() {
+        stop_update();
+        m_keys.clear();
+        m_series.clear();
+        m_scanned = 0;
+        m_column_bytes = 0;
+    }
+
+    const dbcbatch::series *dbcbatch::find(uint8_t bus, uint32_t id) const {
+        auto it = m_keys.find(dbcdatabase::make_key(bus, id & (can::FRAME_EXTENDED_FLAG | can::FRAME_EXTENDED_MASK)));
+        return (it == m_keys.end() || it->second < 0) ? nullptr : m_series[it->second].get();
+    }
+
+    void dbcbatch::check_reset(size_t packets, const dbcindex &index) {
+        if (index.get_generation() != m_index_generation || packets < m_scanned) {
+            reset();
+            m_index_generation = index.get_generation();
+        }
+    }
+
+    void dbcbatch::stop_update() {
+        if (!m_worker.joinable()) return;
+
+        m_cancel.store(true, std::memory_order_relaxed);
+        m_worker.join();
+        m_cancel.store(false, std::memory_order_relaxed);
+        m_updating.store(false, std::memory_order_relaxed);
+    }
+
+    void dbcbatch::background_update(const can::packetprovider &provider, uint64_t epoch, size_t end, uint8_t bus,
+                                     uint32_t id) {
+        std::vector<can::frame> buffer(READ_FRAMES);
+        while (m_scanned < end && !m_cancel.load(std::memory_order_relaxed)) {
+            const size_t count = provider.read_packets(epoch, m_scanned, std::min(READ_FRAMES, end - m_scanned),
+                                                       buffer.data());
+            // Cleared or replaced, the render thread resets once it sees the new epoch
+            if (count == 0) break;
+
+            for (size_t i = 0; i < count; i++) {
+                add(buffer[i], static_cast<uint32_t>(m_scanned + i), m_worker_index);
+            }
+            m_scanned += count;
+            m_progress.fetch_add(count, std::memory_order_relaxed);
+        }
+
+        if (const auto *s = find(bus, id); s && !m_cancel.load(std::memory_order_relaxed)) {
+            m_progress_total.fetch_add(s->frames.size() - s->decoded, std::memory_order_relaxed);
+            decode(bus, id);
+        }
+        m_updating.store(false, std::memory_order_release);
+    }
+
+    void dbcbatch::add(const can::frame &f, uint32_t packet, dbcindex &index) {
+        const uint32_t id = f.id & (can::FRAME_EXTENDED_FLAG | can::FRAME_EXTENDED_MASK);
+        auto [it, inserted] = m_keys.try_emplace(dbcdatabase::make_key(f.bus, id), -1);
+        if (inserted) {
+            if (const auto *message = index.find(f)) {
+                auto s = std::make_unique<series>();
+                s->bus = f.bus;
+                s->id = id;
+                s->message = message;
+                for (const auto &signal: message->signals) {
+                    unsigned shift;
+                    if (signal.plan.valid && !get_word_shift(signal.plan, shift)) s->needs_payloads = true;
+                }
+
+                it->second = static_cast<int32_t>(m_series.size());
+                m_series.push_back(std::move(s));
+            }
+        }
+        if (it->second < 0) return;
+
+        auto &s = *m_series[it->second];
+        s.frames.push_back(packet);
+        s.timestamps.push_back(f.timestamp);
+        // Bytes past dlc are zero, the words can be loaded straight from the frame
+        s.words.push_back(load_le64(f.data));
+        if (s.needs_payloads) s.payloads.emplace_back(f);
+    }
+
+    void dbcbatch::decode_series(series &s) {
+        const size_t first = s.decoded;
+        const size_t count = s.frames.size() - first;
+        if (count == 0) return;
+
+        s.columns.resize(s.message->signals.size());
+        for (auto &c: s.columns) {
+            c.values.resize(first + count, std::numeric_limits<double>::quiet_NaN());
+        }
+        m_column_bytes += count * s.columns.size() * sizeof(double);
+
+        auto decode_block = [this, &s, first, count](size_t block) {
+            // Only a background update is ever cancelled, and everything is cleared after
+            if (m_cancel.load(std::memory_order_relaxed)) return;
+
+            const size_t from = first + block * DECODE_BLOCK_FRAMES;
+            const size_t frames = std::min(DECODE_BLOCK_FRAMES, first + count - from);
+            series_decoder decoder(s, from, frames);
+            if (s.message->mux.empty()) {
+                for (uint32_t i = 0; i < s.columns.size(); i++) decoder.decode_signal(i, nullptr, frames);
+            } else {
+                decoder.decode_case(s.message->mux.cases[0], nullptr, frames);
+            }
+            m_progress.fetch_add(frames, std::memory_order_relaxed);
+        };
+
+        const size_t blocks = (count + DECODE_BLOCK_FRAMES - 1) / DECODE_BLOCK_FRAMES;
+        const size_t workers = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), blocks);
+        if (workers == 1) {
+            for (size_t b = 0; b < blocks; b++) decode_block(b);
+        } else {
+            std::atomic<size_t> next{0};
+            std::vector<std::thread> threads;
+            threads.reserve(workers);
+            for (size_t w = 0; w < workers; w++) {
+                threads.emplace_back([&decode_block, &next, blocks] {
+                    for (size_t b = next.fetch_add(1); b < blocks; b = next.fetch_add(1)) decode_block(b);
+                });
+            }
+            for (auto &t: threads) t.join();
+        }
+
+        for (auto &c: s.columns) {
+            // std::min and std::max keep the first argument when the second is NaN, so absent values drop out
+            // without a branch
+            double min = std::numeric_limits<double>::infinity();
+            double max = -min;
+            size_t present = 0;
+            for (size_t i = first; i < first + count; i++) {
+                const double v = c.values[i];
+                min = std::min(min, v);
+                max = std::max(max, v);
+                present += !std::isnan(v);
+            }
+            if (present == 0) continue;
+
+            c.min = c.present == 0 ? min : std::min(c.min, min);
+            c.max = c.present == 0 ? max : std::max(c.max, max);
+            c.present += present;
+        }
+        s.decoded = s.frames.size();
+    }
+
+    void dbcbatch::evict(const series *keep) {
+        while (m_column_bytes > COLUMN_MEMORY_LIMIT) {
+            series *oldest = nullptr;
+            for (const auto &s: m_series) {
+                if (s.get() == keep || s->decoded == 0) continue;
+                if (!oldest || s->last_used < oldest->last_used) oldest = s.get();
+            }
+            if (!oldest) return;
+
+            // Decoded again from the words if it is asked for
+            m_column_bytes -= oldest->decoded * oldest->columns.size() * sizeof(double);
+            oldest->columns.clear();
+            oldest->columns.shrink_to_fit();
+            oldest->decoded = 0;
+        }
+    }
+}
@@ -0,0 +1,158 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DBCBATCH__
+#define __CANARY_DBCBATCH__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "dbcdecoder.hpp"
+#include "dbcindex.hpp"
+#include "can/frame.hpp"
+#include "can/packetprovider.hpp"
+
+namespace canary {
+
+    // Position of a signal within the first 64 payload bits, counted from the least significant bit of the
+    // little-endian payload word for Intel signals and of the big-endian word for Motorola ones. False if the signal
+    // extends past them (CAN FD), it then has to be extracted frame by frame.
+    bool get_word_shift(const dbc_signal_plan &plan, unsigned &shift);
+
+    // Decodes one signal from the payload words of count frames into out, the words being little-endian for Intel
+    // signals and big-endian for Motorola ones. Integer signals of up to 52 bits are decoded two frames at a time with
+    // SSE2 where available, they convert to double exactly by placing the raw value in the mantissa. Gives the same
+    // values as decode_signal().
+    void decode_column(const dbc_signal_plan &plan, unsigned shift, const uint64_t *words, size_t count, double *out);
+
+    // Every signal of the capture decoded into one column per signal, for analysis and plotting. Frames are grouped
+    // by bus and ID as they arrive, keeping the first payload word of each. A series' columns are only decoded once
+    // it is asked for, with decode_column() and split between threads, and later only frames received since are
+    // decoded. Decoded columns of all series are kept below COLUMN_MEMORY_LIMIT by dropping the least recently used,
+    // which are decoded again from the words when next asked for.
+    class dbcbatch {
+    public:
+        struct column {
+            // NaN in frames the signal is multiplexed out of
+            std::vector<double> values;
+            // Over the values present
+            double min{0};
+            double max{0};
+            size_t present{0};
+        };
+
+        struct series {
+            uint8_t bus;
+            // frame::id without the RTR and error flags
+            uint32_t id;
+            const dbc_message *message;
+            // Packet index and timestamp of every frame, in order
+            std::vector<uint32_t> frames;
+            std::vector<uint64_t> timestamps;
+
+            // Little-endian first payload word of every frame, the columns are decoded from these. Whole payloads are
+            // only kept for messages with signals that do not fit the word.
+            std::vector<uint64_t> words;
+            std::vector<dbc_payload> payloads;
+            bool needs_payloads{false};
+
+            // One for every signal of message, in the same order, holding the first decoded frames. Empty until the
+            // series is first decoded and after its columns are dropped.
+            std::vector<column> columns;
+            size_t decoded{0};
+            uint64_t last_used{0};
+        };
+
+        // Frames are decoded in blocks of this many, shared between threads when there are several
+        static constexpr size_t DECODE_BLOCK_FRAMES = 65536;
+
+        // Decoded columns of every series other than the one last decoded are dropped beyond this many bytes
+        static constexpr size_t COLUMN_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+        // Below this many frames to group and decode, update() with a packetprovider does it before returning
+        static constexpr size_t BACKGROUND_UPDATE_MIN = 262144;
+
+        ~dbcbatch();
+
+        // Packets is any container with size() and operator[] returning a frame. Groups the packets received since
+        // the last call, or all of them again if the index was rebuilt or the packets got fewer.
+        template<typename Packets>
+        void update(const Packets &packets, dbcindex &index) {
+            check_reset(packets.size(), index);
+
+            for (size_t i = m_scanned; i < packets.size(); i++) {
+                add(packets[i], static_cast<uint32_t>(i), index);
+            }
+            m_scanned = packets.size();
+        }
+
+        // For the render thread. Groups the received packets as above, then decodes the series of bus and id. If
+        // that is BACKGROUND_UPDATE_MIN frames or more (e.g. a long capture the first time) it is done on a
+        // background thread, reading the packets a chunk at a time so they can still be stored meanwhile, and no
+        // series may be read until is_updating() is false. Returns the series, nullptr while the background update
+        // runs or if no frames with this bus and ID matched a message.
+        const series *update(const can::packetprovider &provider, dbcindex &index, uint8_t bus, uint32_t id);
+
+        // Joins the background update once it has finished
+        [[nodiscard]] bool is_updating();
+
+        // Fraction of the background update done
+        [[nodiscard]] float get_progress() const;
+
+        // Decodes the frames of the series grouped since it was last decoded, dropping other series' columns over
+        // COLUMN_MEMORY_LIMIT. nullptr as find().
+        const series *decode(uint8_t bus, uint32_t id);
+
+        // Must be called when the packets are cleared and before the DBC database changes, the background update
+        // reads it. Stops the background update if there is one.
+        void reset();
+
+        // nullptr if no frames with this bus and ID matched a message. id as in frame::id. The columns may not be
+        // decoded, see decode().
+        [[nodiscard]] const series *find(uint8_t bus, uint32_t id) const;
+
+        [[nodiscard]] inline const std::vector<std::unique_ptr<series>> &get_series() const { return m_series; }
+
+        [[nodiscard]] inline size_t get_scanned_count() const { return m_scanned; }
+
+    private:
+        // Index into m_series by dbcdatabase::make_key(bus, id), -1 for frames without a message
+        std::unordered_map<uint64_t, int32_t> m_keys;
+        std::vector<std::unique_ptr<series>> m_series;
+        size_t m_scanned{0};
+        uint64_t m_index_generation{UINT64_MAX};
+
+        // Bytes held by the columns of every series
+        size_t m_column_bytes{0};
+        uint64_t m_decode_clock{0};
+
+        std::thread m_worker;
+        std::atomic<bool> m_updating{false};
+        std::atomic<bool> m_cancel{false};
+        // Frames grouped and decoded by the background update, and the frames it has to go through
+        std::atomic<size_t> m_progress{0};
+        std::atomic<size_t> m_progress_total{0};
+        // The background update resolves frames with a copy of the index, the render thread keeps using its own
+        dbcindex m_worker_index;
+
+        void check_reset(size_t packets, const dbcindex &index);
+
+        void stop_update();
+
+        void background_update(const can::packetprovider &provider, uint64_t epoch, size_t end, uint8_t bus,
+                               uint32_t id);
+
+        void add(const can::frame &f, uint32_t packet, dbcindex &index);
+
+        void decode_series(series &s);
+
+        // Drops the columns of the least recently decoded series other than keep until under COLUMN_MEMORY_LIMIT
+        void evict(const series *keep);
+    };
+
+}
+
+#endif
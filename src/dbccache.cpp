@@ -0,0 +1,489 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "dbccache.hpp"
+#include "dbcdecoder.hpp"
+#include "mappedfile.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace canary {
+    namespace {
+        constexpr uint64_t HASH_PRIME_1 = 0x9E3779B185EBCA87ULL;
+        constexpr uint64_t HASH_PRIME_2 = 0xC2B2AE3D27D4EB4FULL;
+
+        inline uint64_t rotl64(uint64_t x, int r) {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        inline uint64_t read64(const uint8_t *p) {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        inline uint64_t hash_round(uint64_t acc, uint64_t input) {
+            acc += input * HASH_PRIME_2;
+            return rotl64(acc, 31) * HASH_PRIME_1;
+        }
+
+        // Flattens a dbcfile into the cache arrays
+        class cache_builder {
+        public:
+            dbc_cache_header header{};
+            std::vector<dbc_cache_message> messages;
+            std::vector<dbc_cache_signal> signals;
+            std::vector<dbc_cache_value> values;
+            std::vector<dbc_cache_attribute> attributes;
+            std::vector<dbc_cache_range> ranges;
+            std::vector<dbc_cache_table> tables;
+            std::vector<dbc_cache_string> nodes;
+            std::string strings;
+
+            explicit cache_builder(const dbcfile &dbc) {
+                header.dbc_version = intern(dbc.version);
+                header.comment = intern(dbc.comment);
+                header.attributes = add_attributes(dbc.attributes);
+                header.attribute_defaults = add_attributes(dbc.attribute_defaults);
+                header.node_comments = add_attributes(dbc.node_comments);
+
+                for (const auto &node: dbc.nodes) nodes.push_back(intern(node));
+
+                for (const auto &[name, table]: dbc.value_tables) {
+                    tables.push_back({intern(name), add_values(table)});
+                }
+
+                // In ID order so the same DBC always gives the same cache
+                std::vector<const dbc_message *> sorted;
+                sorted.reserve(dbc.messages.size());
+                for (const auto &[can_id, message]: dbc.messages) sorted.push_back(&message);
+                std::sort(sorted.begin(), sorted.end(), [](const dbc_message *a, const dbc_message *b) {
+                    return a->can_id < b->can_id;
+                });
+
+                messages.reserve(sorted.size());
+                for (const auto *message: sorted) add_message(*message);
+            }
+
+        private:
+            std::unordered_map<std::string_view, dbc_cache_string> m_interned;
+
+            dbc_cache_string intern(std::string_view s) {
+                if (s.empty()) return {0, 0};
+
+                // Keys view the dbcfile's strings, which outlive the builder
+                auto [it, inserted] = m_interned.try_emplace(s);
+                if (inserted) {
+                    it->second = {static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(s.size())};
+                    strings.append(s);
+                }
+                return it->second;
+            }
+
+            template<typename M>
+            dbc_cache_span add_attributes(const M &map) {
+                dbc_cache_span span{static_cast<uint32_t>(attributes.size()), static_cast<uint32_t>(map.size())};
+                for (const auto &[name, value]: map) {
+                    attributes.push_back({intern(name), intern(value)});
+                }
+                return span;
+            }
+
+            dbc_cache_span add_values(const dbc_value_table &table) {
+                dbc_cache_span span{static_cast<uint32_t>(values.size()), static_cast<uint32_t>(table.size())};
+                for (const auto &[value, description]: table) {
+                    values.push_back({value, intern(description)});
+                }
+                return span;
+            }
+
+            void add_message(const dbc_message &message) {
+                dbc_cache_message m{};
+                m.can_id = static_cast<uint32_t>(message.can_id);
+                m.length = message.length;
+                m.name = intern(message.name);
+                m.sender = intern(message.sender);
+                m.comment = intern(message.comment);
+                m.attributes = add_attributes(message.attributes);
+                m.signals = {static_cast<uint32_t>(signals.size()), static_cast<uint32_t>(message.signals.size())};
+                messages.push_back(m);
+
+                for (const auto &signal: message.signals) {
+                    dbc_cache_signal s{};
+                    s.name = intern(signal.name);
+                    s.unit = intern(signal.unit);
+                    s.receiver = intern(signal.receiver);
+                    s.comment = intern(signal.comment);
+                    s.multiplexor = intern(signal.multiplexor);
+                    s.start = signal.start;
+                    s.length = signal.length;
+                    s.scale = signal.scale;
+                    s.offset = signal.offset;
+                    s.min = signal.min;
+                    s.max = signal.max;
+                    s.multiplex_value = signal.multiplex_value;
+                    s.values = add_values(signal.values);
+                    s.attributes = add_attributes(signal.attributes);
+                    s.ranges = {static_cast<uint32_t>(ranges.size()),
+                                static_cast<uint32_t>(signal.multiplex_ranges.size())};
+                    for (const auto &[from, to]: signal.multiplex_ranges) ranges.push_back({from, to});
+                    s.little_endian = signal.little_endian;
+                    s.is_signed = signal.is_signed;
+                    s.is_multiplexor = signal.is_multiplexor;
+                    s.value_type = static_cast<uint8_t>(signal.value_type);
+                    s.plan = signal.plan;
+                    signals.push_back(s);
+                }
+            }
+        };
+
+        // Bounds-checked access to a mapped cache. Any reference outside the file marks the cache as corrupt.
+        class cache_reader {
+        public:
+            const dbc_cache_message *messages{nullptr};
+            const dbc_cache_signal *signals{nullptr};
+            const dbc_cache_value *values{nullptr};
+            const dbc_cache_attribute *attributes{nullptr};
+            const dbc_cache_range *ranges{nullptr};
+            const dbc_cache_table *tables{nullptr};
+            const dbc_cache_string *nodes{nullptr};
+            bool ok{true};
+
+            // Returns false if the sections do not exactly fill the file
+            bool map(const uint8_t *data, size_t size) {
+                std::memcpy(&m_header, data, sizeof(m_header));
+
+                const uint8_t *p = data + sizeof(m_header);
+                uint64_t expected = sizeof(m_header);
+                auto section = [&p, &expected](auto *&array, uint32_t count) {
+                    array = reinterpret_cast<std::remove_reference_t<decltype(array)>>(p);
+                    const uint64_t bytes = static_cast<uint64_t>(count) * sizeof(*array);
+                    p += bytes;
+                    expected += bytes;
+                };
+                section(messages, m_header.message_count);
+                section(signals, m_header.signal_count);
+                section(values, m_header.value_count);
+                section(attributes, m_header.attribute_count);
+                section(ranges, m_header.range_count);
+                section(tables, m_header.table_count);
+                section(nodes, m_header.node_count);
+                m_strings = reinterpret_cast<const char *>(p);
+                expected += m_header.string_table_size;
+
+                return expected == size;
+            }
+
+            std::string str(dbc_cache_string s) {
+                if (static_cast<uint64_t>(s.offset) + s.length > m_header.string_table_size) {
+                    ok = false;
+                    return {};
+                }
+                return {m_strings + s.offset, s.length};
+            }
+
+            // First record of the span, nullptr if it runs past the end of the array
+            template<typename T>
+            const T *span(const T *array, uint32_t array_count, dbc_cache_span s) {
+                if (static_cast<uint64_t>(s.first) + s.count > array_count) {
+                    ok = false;
+                    return nullptr;
+                }
+                return array + s.first;
+            }
+
+            template<typename M>
+            void read_attributes(dbc_cache_span s, M &out) {
+                // Most objects have no attributes, and reserving even nothing allocates a map's buckets
+                if (s.count == 0) return;
+                const auto *first = span(attributes, m_header.attribute_count, s);
+                if (!first) return;
+                out.reserve(s.count);
+                for (uint32_t i = 0; i < s.count; i++) {
+                    out.emplace(str(first[i].name), str(first[i].value));
+                }
+            }
+
+            void read_values(dbc_cache_span s, dbc_value_table &out) {
+                const auto *first = span(values, m_header.value_count, s);
+                if (!first) return;
+                out.reserve(s.count);
+                for (uint32_t i = 0; i < s.count; i++) {
+                    out.emplace_back(first[i].value, str(first[i].description));
+                }
+            }
+
+            const dbc_cache_header &get_header() const { return m_header; }
+
+        private:
+            dbc_cache_header m_header{};
+            const char *m_strings{nullptr};
+        };
+
+        struct compiled_file {
+            std::string path;
+            uint64_t source_size;
+            std::filesystem::file_time_type modified;
+            uint64_t source_hash;
+            std::shared_ptr<const dbcfile> dbc;
+            uint64_t last_used;
+        };
+
+        // One entry per path, copies of the same DBC share the compiled file
+        struct compiled_files {
+            std::mutex mutex;
+            std::vector<compiled_file> files;
+            uint64_t clock{0};
+
+            void remember(compiled_file file) {
+                file.last_used = ++clock;
+                auto it = std::find_if(files.begin(), files.end(), [&file](const compiled_file &f) {
+                    return f.path == file.path;
+                });
+                if (it != files.end()) {
+                    *it = std::move(file);
+                    return;
+                }
+
+                if (files.size() >= dbccache::MEMORY_CACHE_FILES) {
+                    files.erase(std::min_element(files.begin(), files.end(), [](const auto &a, const auto &b) {
+                        return a.last_used < b.last_used;
+                    }));
+                }
+                files.push_back(std::move(file));
+            }
+        };
+
+        compiled_files &get_compiled_files() {
+            static compiled_files files;
+            return files;
+        }
+
+        template<typename T>
+        bool write_array(std::FILE *file, const std::vector<T> &array) {
+            return array.empty() || std::fwrite(array.data(), sizeof(T), array.size(), file) == array.size();
+        }
+    }
+
+    std::string dbccache::get_cache_path(const std::string &dbc_path) {
+        return dbc_path + ".cache";
+    }
+
+    uint64_t dbccache::hash(const uint8_t *data, size_t size) {
+        // Four independent lanes so the multiplies overlap, the whole DBC is hashed whenever it is read
+        uint64_t lanes[4] = {HASH_PRIME_1 + HASH_PRIME_2, HASH_PRIME_2, 0, 0 - HASH_PRIME_1};
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            for (int lane = 0; lane < 4; lane++) {
+                lanes[lane] = hash_round(lanes[lane], read64(data + i + lane * 8));
+            }
+        }
+
+        uint64_t h = rotl64(lanes[0], 1) + rotl64(lanes[1], 7) + rotl64(lanes[2], 12) + rotl64(lanes[3], 18) + size;
+        for (; i + 8 <= size; i += 8) {
+            h = rotl64(h ^ hash_round(0, read64(data + i)), 27) * HASH_PRIME_1;
+        }
+        for (; i < size; i++) {
+            h = rotl64(h ^ (data[i] * HASH_PRIME_2), 11) * HASH_PRIME_1;
+        }
+
+        h ^= h >> 33;
+        h *= HASH_PRIME_2;
+        h ^= h >> 29;
+        h *= HASH_PRIME_1;
+        h ^= h >> 32;
+        return h;
+    }
+
+    std::shared_ptr<const dbcfile> dbccache::load(const std::string &dbc_path,
+                                                  const std::function<void(std::string message)> &error_handler) {
+        auto &compiled = get_compiled_files();
+
+        // The same size and modification time is taken as the same contents, as make does
+        std::error_code ec;
+        const uint64_t size = std::filesystem::file_size(dbc_path, ec);
+        std::filesystem::file_time_type modified{};
+        if (!ec) modified = std::filesystem::last_write_time(dbc_path, ec);
+        const bool stat_ok = !ec;
+
+        if (stat_ok) {
+            std::lock_guard lk(compiled.mutex);
+            for (auto &f: compiled.files) {
+                if (f.path == dbc_path && f.source_size == size && f.modified == modified) {
+                    f.last_used = ++compiled.clock;
+                    return f.dbc;
+                }
+            }
+        }
+
+        mapped_file source;
+        if (source.open(dbc_path, true) != 0) {
+            if (error_handler) error_handler(std::format("Error opening DBC file: {}", dbc_path));
+            return std::make_shared<const dbcfile>();
+        }
+
+        const uint64_t source_hash = hash(source.get_data(), source.get_size());
+        // Stored with the size and time from before the DBC was read, if it changed since it is only hashed again
+        compiled_file entry{dbc_path, source.get_size(), modified, source_hash, nullptr, 0};
+
+        {
+            std::lock_guard lk(compiled.mutex);
+            for (const auto &f: compiled.files) {
+                if (f.source_hash == source_hash && f.source_size == source.get_size()) {
+                    entry.dbc = f.dbc;
+                    break;
+                }
+            }
+        }
+
+        if (!entry.dbc) {
+            const std::string cache_path = get_cache_path(dbc_path);
+            dbcfile dbc;
+            if (read(cache_path, source_hash, source.get_size(), dbc) != 0) {
+                dbc = dbcparser::parse_dbc({reinterpret_cast<const char *>(source.get_data()), source.get_size()},
+                                           error_handler);
+                write(cache_path, dbc, source_hash, source.get_size());
+            }
+            entry.dbc = std::make_shared<const dbcfile>(std::move(dbc));
+        }
+
+        auto dbc = entry.dbc;
+        if (stat_ok && entry.source_size == size) {
+            std::lock_guard lk(compiled.mutex);
+            compiled.remember(std::move(entry));
+        }
+        return dbc;
+    }
+
+    void dbccache::clear_memory_cache() {
+        auto &compiled = get_compiled_files();
+        std::lock_guard lk(compiled.mutex);
+        compiled.files.clear();
+    }
+
+    int dbccache::write(const std::string &cache_path, const dbcfile &dbc, uint64_t source_hash,
+                        uint64_t source_size) {
+        cache_builder builder(dbc);
+
+        auto &header = builder.header;
+        std::memcpy(header.magic, DBC_CACHE_MAGIC, sizeof(header.magic));
+        header.version = DBC_CACHE_VERSION;
+        header.byte_order = DBC_CACHE_BYTE_ORDER_MARK;
+        header.plan_size = sizeof(dbc_signal_plan);
+        header.string_table_size = static_cast<uint32_t>(builder.strings.size());
+        header.source_hash = source_hash;
+        header.source_size = source_size;
+        header.message_count = static_cast<uint32_t>(builder.messages.size());
+        header.signal_count = static_cast<uint32_t>(builder.signals.size());
+        header.value_count = static_cast<uint32_t>(builder.values.size());
+        header.attribute_count = static_cast<uint32_t>(builder.attributes.size());
+        header.range_count = static_cast<uint32_t>(builder.ranges.size());
+        header.table_count = static_cast<uint32_t>(builder.tables.size());
+        header.node_count = static_cast<uint32_t>(builder.nodes.size());
+
+        // Written beside the cache and renamed over it, so a reader never sees a partial file
+        const std::string temp_path = cache_path + ".tmp";
+        std::FILE *file = std::fopen(temp_path.c_str(), "wb");
+        if (!file) return 1;
+
+        bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        ok = ok && write_array(file, builder.messages);
+        ok = ok && write_array(file, builder.signals);
+        ok = ok && write_array(file, builder.values);
+        ok = ok && write_array(file, builder.attributes);
+        ok = ok && write_array(file, builder.ranges);
+        ok = ok && write_array(file, builder.tables);
+        ok = ok && write_array(file, builder.nodes);
+        ok = ok && (builder.strings.empty() ||
+                    std::fwrite(builder.strings.data(), 1, builder.strings.size(), file) == builder.strings.size());
+        ok = std::fclose(file) == 0 && ok;
+
+        std::error_code ec;
+        if (ok) std::filesystem::rename(temp_path, cache_path, ec);
+        if (!ok || ec) {
+            std::filesystem::remove(temp_path, ec);
+            return 1;
+        }
+        return 0;
+    }
+
+    int dbccache::read(const std::string &cache_path, uint64_t source_hash, uint64_t source_size, dbcfile &dbc) {
+        mapped_file file;
+        if (file.open(cache_path) != 0 || file.get_size() < sizeof(dbc_cache_header)) return 1;
+
+        cache_reader reader;
+        if (!reader.map(file.get_data(), file.get_size())) return 1;
+
+        const auto &header = reader.get_header();
+        if (std::memcmp(header.magic, DBC_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != DBC_CACHE_VERSION || header.byte_order != DBC_CACHE_BYTE_ORDER_MARK ||
+            header.plan_size != sizeof(dbc_signal_plan) || header.source_hash != source_hash ||
+            header.source_size != source_size) {
+            return 1;
+        }
+
+        dbcfile out;
+        out.version = reader.str(header.dbc_version);
+        out.comment = reader.str(header.comment);
+        reader.read_attributes(header.attributes, out.attributes);
+        reader.read_attributes(header.attribute_defaults, out.attribute_defaults);
+        reader.read_attributes(header.node_comments, out.node_comments);
+
+        out.nodes.reserve(header.node_count);
+        for (uint32_t i = 0; i < header.node_count; i++) {
+            out.nodes.push_back(reader.str(reader.nodes[i]));
+        }
+
+        for (uint32_t i = 0; i < header.table_count; i++) {
+            reader.read_values(reader.tables[i].values, out.value_tables[reader.str(reader.tables[i].name)]);
+        }
+
+        out.messages.reserve(header.message_count);
+        for (uint32_t i = 0; i < header.message_count && reader.ok; i++) {
+            const auto &m = reader.messages[i];
+            const long can_id = static_cast<long>(m.can_id);
+            auto &message = out.messages.try_emplace(can_id, can_id, reader.str(m.name), m.length,
+                                                     reader.str(m.sender)).first->second;
+            message.comment = reader.str(m.comment);
+            reader.read_attributes(m.attributes, message.attributes);
+
+            const auto *first = reader.span(reader.signals, header.signal_count, m.signals);
+            if (!first) break;
+
+            message.signals.reserve(m.signals.count);
+            for (uint32_t j = 0; j < m.signals.count; j++) {
+                const auto &s = first[j];
+                auto &signal = message.signals.emplace_back(reader.str(s.name), s.start, s.length, s.little_endian != 0,
+                                                            s.is_signed != 0, s.scale, s.offset, s.min, s.max,
+                                                            reader.str(s.unit), reader.str(s.receiver));
+                signal.comment = reader.str(s.comment);
+                signal.multiplexor = reader.str(s.multiplexor);
+                signal.is_multiplexor = s.is_multiplexor != 0;
+                signal.value_type = static_cast<dbc_value_type>(s.value_type);
+                signal.multiplex_value = s.multiplex_value;
+                reader.read_values(s.values, signal.values);
+                reader.read_attributes(s.attributes, signal.attributes);
+
+                if (const auto *range = reader.span(reader.ranges, header.range_count, s.ranges)) {
+                    signal.multiplex_ranges.reserve(s.ranges.count);
+                    for (uint32_t k = 0; k < s.ranges.count; k++) {
+                        signal.multiplex_ranges.emplace_back(range[k].from, range[k].to);
+                    }
+                }
+                signal.plan = s.plan;
+            }
+            message.mux = compile_multiplexing(message);
+        }
+
+        if (!reader.ok) return 1;
+        dbc = std::move(out);
+        return 0;
+    }
+}
@@ -0,0 +1,166 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DBCCACHE__
+#define __CANARY_DBCCACHE__
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+#include "dbc.hpp"
+
+namespace canary {
+
+    // Compiled form of a DBC file, saved next to it as <file>.cache so switching between DBCs does not reparse them:
+    //   dbc_cache_header
+    //   dbc_cache_message for every message, in ID order
+    //   dbc_cache_signal for every signal, grouped by message
+    //   dbc_cache_value for every value description, grouped by signal or value table
+    //   dbc_cache_attribute for every attribute, default and node comment
+    //   dbc_cache_range for every SG_MUL_VAL_ range
+    //   dbc_cache_table for every value table
+    //   dbc_cache_string for every node
+    //   string table
+    // Strings are interned, each distinct string is stored once and referenced by offset and length. Decode plans are
+    // stored as built so they do not need compiling again. Multiplexing plans are rebuilt from the stored indicators
+    // and ranges, which only costs anything for multiplexed messages. The header holds a hash of the DBC's contents; a
+    // cache is only used while the DBC it was built from is unchanged.
+    //
+    // Compiled files are also kept in memory by the hash of their contents, so opening a DBC again (or another copy
+    // of it) in the same process neither reads the cache nor rehashes the DBC while its size and modification time
+    // are unchanged.
+    constexpr char DBC_CACHE_MAGIC[8] = {'C', 'A', 'N', 'A', 'R', 'Y', 'D', 'C'};
+    constexpr uint32_t DBC_CACHE_VERSION = 2;
+    // Written in native byte order, reads back as a different value on a host of the other endianness
+    constexpr uint32_t DBC_CACHE_BYTE_ORDER_MARK = 0x01020304;
+
+    struct dbc_cache_string {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Run of records in one of the arrays
+    struct dbc_cache_span {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    struct dbc_cache_header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        // sizeof(dbc_signal_plan), the plan layout can change between builds
+        uint32_t plan_size;
+        uint32_t string_table_size;
+        uint64_t source_hash;
+        uint64_t source_size;
+        uint32_t message_count;
+        uint32_t signal_count;
+        uint32_t value_count;
+        uint32_t attribute_count;
+        uint32_t range_count;
+        uint32_t table_count;
+        uint32_t node_count;
+        uint32_t reserved;
+        dbc_cache_string dbc_version;
+        dbc_cache_string comment;
+        dbc_cache_span attributes;
+        dbc_cache_span attribute_defaults;
+        dbc_cache_span node_comments;
+        uint8_t reserved2[16];
+    };
+
+    struct dbc_cache_message {
+        uint32_t can_id;
+        int32_t length;
+        dbc_cache_string name;
+        dbc_cache_string sender;
+        dbc_cache_string comment;
+        dbc_cache_span signals;
+        dbc_cache_span attributes;
+    };
+
+    struct dbc_cache_signal {
+        dbc_cache_string name;
+        dbc_cache_string unit;
+        dbc_cache_string receiver;
+        dbc_cache_string comment;
+        dbc_cache_string multiplexor;
+        int32_t start;
+        int32_t length;
+        float scale;
+        float offset;
+        float min;
+        float max;
+        int64_t multiplex_value;
+        dbc_cache_span values;
+        dbc_cache_span attributes;
+        dbc_cache_span ranges;
+        uint8_t little_endian;
+        uint8_t is_signed;
+        uint8_t is_multiplexor;
+        // dbc_value_type
+        uint8_t value_type;
+        uint8_t reserved[4];
+        dbc_signal_plan plan;
+    };
+
+    struct dbc_cache_value {
+        int64_t value;
+        dbc_cache_string description;
+    };
+
+    // Also used for node comments, with the node as the name
+    struct dbc_cache_attribute {
+        dbc_cache_string name;
+        dbc_cache_string value;
+    };
+
+    struct dbc_cache_range {
+        uint64_t from;
+        uint64_t to;
+    };
+
+    struct dbc_cache_table {
+        dbc_cache_string name;
+        dbc_cache_span values;
+    };
+
+    static_assert(sizeof(dbc_cache_header) == 128, "dbc_cache_header is part of the file format");
+    static_assert(sizeof(dbc_cache_message) == 48, "dbc_cache_message is part of the file format");
+    static_assert(sizeof(dbc_cache_signal) % 8 == 0, "dbc_cache_signal must keep the following arrays aligned");
+    static_assert(std::is_trivially_copyable_v<dbc_signal_plan>, "Plans are stored as-is");
+
+    class dbccache {
+    public:
+        // Compiled files kept in memory, the least recently loaded is dropped beyond this many. Enough for rotating
+        // through a vehicle's DBCs without ever going back to the disk cache.
+        static constexpr size_t MEMORY_CACHE_FILES = 32;
+
+        static std::string get_cache_path(const std::string &dbc_path);
+
+        // Loads a DBC file through its cache. A file compiled by an earlier load is shared if the DBC's size and
+        // modification time are unchanged or its contents hash the same. Otherwise the cache is used if it was built
+        // from identical contents, or the DBC is parsed and the cache rewritten. A cache that cannot be written, e.g.
+        // in a read-only directory, is not an error. Never nullptr, a DBC that cannot be opened gives an empty file.
+        static std::shared_ptr<const dbcfile> load(const std::string &dbc_path,
+                                                   const std::function<void(std::string message)> &error_handler = {});
+
+        // Drops the compiled files kept in memory, the next load of each reads its cache again
+        static void clear_memory_cache();
+
+        // Returns 0 on success. The file is replaced atomically so other instances never read a partial cache.
+        static int write(const std::string &cache_path, const dbcfile &dbc, uint64_t source_hash, uint64_t source_size);
+
+        // Returns 0 and fills dbc if the cache exists, is intact and was built from a DBC with this hash and size
+        static int read(const std::string &cache_path, uint64_t source_hash, uint64_t source_size, dbcfile &dbc);
+
+        // Fast 64-bit hash of the DBC contents for detecting changes, not collision resistant against deliberate edits
+        static uint64_t hash(const uint8_t *data, size_t size);
+    };
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "dbcdatabase.hpp"
+
+#include <algorithm>
+
+#include "can/frame.hpp"
+
+namespace canary {
+    uint32_t dbcdatabase::normalise_id(uint32_t id) {
+        if ((id & can::FRAME_EXTENDED_FLAG) || id > can::FRAME_STANDARD_MASK) {
+            return can::FRAME_EXTENDED_FLAG | (id & can::FRAME_EXTENDED_MASK);
+        }
+        return id;
+    }
+
+    size_t dbcdatabase::add(const std::string &path, std::shared_ptr<const dbcfile> dbc) {
+        auto existing = std::find_if(m_files.begin(), m_files.end(), [&path](const auto &f) {
+            return f->path == path;
+        });
+
+        size_t index;
+        if (existing != m_files.end()) {
+            (*existing)->dbc = std::move(dbc);
+            index = existing - m_files.begin();
+        } else {
+            auto f = std::make_unique<file>();
+            f->path = path;
+            f->dbc = std::move(dbc);
+            m_files.push_back(std::move(f));
+            index = m_files.size() - 1;
+        }
+
+        rebuild();
+        return index;
+    }
+
+    void dbcdatabase::remove(size_t index) {
+        if (index >= m_files.size()) return;
+        m_files.erase(m_files.begin() + static_cast<std::ptrdiff_t>(index));
+        rebuild();
+    }
+
+    void dbcdatabase::clear() {
+        m_files.clear();
+        rebuild();
+    }
+
+    void dbcdatabase::set_buses(size_t index, const std::bitset<MAX_BUSES> &buses) {
+        if (index >= m_files.size() || m_files[index]->buses == buses) return;
+        m_files[index]->buses = buses;
+        rebuild();
+    }
+
+    void dbcdatabase::rebuild() {
+        m_index.clear();
+        for (const auto &f: m_files) {
+            const size_t bus_count = f->buses.none() ? 1 : f->buses.count();
+            m_index.reserve(m_index.size() + f->dbc->messages.size() * bus_count);
+
+            for (const auto &[can_id, message]: f->dbc->messages) {
+                const auto id = static_cast<uint32_t>(can_id);
+                if (f->buses.none()) {
+                    m_index.push_back({make_key(ALL_BUSES, id), &message});
+                    continue;
+                }
+                for (uint32_t bus = 0; bus < MAX_BUSES; bus++) {
+                    if (f->buses.test(bus)) m_index.push_back({make_key(bus, id), &message});
+                }
+            }
+        }
+
+        // Stable so the first file wins when several define the same ID for a bus
+        std::stable_sort(m_index.begin(), m_index.end(), [](const index_entry &a, const index_entry &b) {
+            return a.key < b.key;
+        });
+        m_index.erase(std::unique(m_index.begin(), m_index.end(), [](const index_entry &a, const index_entry &b) {
+            return a.key == b.key;
+        }), m_index.end());
+
+        m_generation++;
+    }
+
+    const dbc_message *dbcdatabase::find(uint8_t bus, uint32_t id) const {
+        auto lookup = [this](uint64_t key) -> const dbc_message * {
+            auto it = std::lower_bound(m_index.begin(), m_index.end(), key, [](const index_entry &e, uint64_t k) {
+                return e.key < k;
+            });
+            return (it != m_index.end() && it->key == key) ? it->message : nullptr;
+        };
+
+        // Drop the RTR and error flags
+        id &= can::FRAME_EXTENDED_FLAG | can::FRAME_EXTENDED_MASK;
+        if (const auto *message = lookup(make_key(bus, id))) return message;
+        return lookup(make_key(ALL_BUSES, id));
+    }
+}
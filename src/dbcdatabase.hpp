@@ -0,0 +1,84 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DBCDATABASE__
+#define __CANARY_DBCDATABASE__
+
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dbc.hpp"
+
+namespace canary {
+
+    // Any number of DBC files loaded at once, each bound to the capture buses it describes (as in a container, one DBC
+    // per bus). Every message of every file is kept in one array sorted by (bus, ID), rebuilt when files or bindings
+    // change, so resolving a frame is a binary search however many files are loaded.
+    class dbcdatabase {
+    public:
+        static constexpr size_t MAX_BUSES = 256;
+        // Bus part of the key for files that apply to every bus
+        static constexpr uint32_t ALL_BUSES = MAX_BUSES;
+
+        struct file {
+            std::string path;
+            // Shared with dbccache, which keeps compiled files for loading again
+            std::shared_ptr<const dbcfile> dbc;
+            // Buses the file describes, none for every bus
+            std::bitset<MAX_BUSES> buses;
+        };
+
+        struct index_entry {
+            // Bus (or ALL_BUSES) in the high 32 bits, the ID with the extended flag in the low
+            uint64_t key;
+            const dbc_message *message;
+        };
+
+        // Adds a file for every bus, or replaces the one already loaded from path and keeps its buses. Returns its
+        // index.
+        size_t add(const std::string &path, std::shared_ptr<const dbcfile> dbc);
+
+        inline size_t add(const std::string &path, dbcfile dbc) {
+            return add(path, std::make_shared<const dbcfile>(std::move(dbc)));
+        }
+
+        void remove(size_t index);
+
+        void clear();
+
+        void set_buses(size_t index, const std::bitset<MAX_BUSES> &buses);
+
+        // id as in frame::id. nullptr if no file for the bus has the ID. Files bound to the bus take precedence over
+        // files for every bus, then earlier files over later ones.
+        [[nodiscard]] const dbc_message *find(uint8_t bus, uint32_t id) const;
+
+        [[nodiscard]] inline const std::vector<std::unique_ptr<file>> &get_files() const { return m_files; }
+
+        [[nodiscard]] inline const std::vector<index_entry> &get_index() const { return m_index; }
+
+        // True if no messages are loaded
+        [[nodiscard]] inline bool empty() const { return m_index.empty(); }
+
+        // Changes whenever the index is rebuilt, message pointers from before are then invalid
+        [[nodiscard]] inline uint64_t get_generation() const { return m_generation; }
+
+        // DBC IDs use the same extended flag bit as frame::id, but some files leave it off 29-bit IDs
+        static uint32_t normalise_id(uint32_t id);
+
+        static inline uint64_t make_key(uint32_t bus, uint32_t id) {
+            return (static_cast<uint64_t>(bus) << 32) | normalise_id(id);
+        }
+
+    private:
+        std::vector<std::unique_ptr<file>> m_files;
+        std::vector<index_entry> m_index;
+        uint64_t m_generation{0};
+
+        void rebuild();
+    };
+
+}
+
+#endif
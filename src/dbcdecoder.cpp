@@ -0,0 +1,180 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "dbcdecoder.hpp"
+
+#include <deque>
+
+namespace canary {
+    namespace {
+        using mux_ranges = std::vector<std::pair<uint64_t, uint64_t>>;
+
+        struct mux_interval {
+            uint64_t from;
+            uint64_t to;
+            std::vector<uint32_t> signals;
+        };
+
+        // Splits the ranges the dependants of a multiplexor are present in into intervals that do not overlap, each
+        // with the dependants present throughout it. max is the largest value the multiplexor can hold.
+        std::vector<mux_interval> split_ranges(const std::vector<uint32_t> &dependants,
+                                               const std::vector<mux_ranges> &ranges, uint64_t max) {
+            std::vector<uint64_t> bounds;
+            for (auto signal: dependants) {
+                for (const auto &[from, to]: ranges[signal]) {
+                    if (from > to || from > max) continue;
+                    bounds.push_back(from);
+                    if (to < max) bounds.push_back(to + 1);
+                }
+            }
+            std::sort(bounds.begin(), bounds.end());
+            bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+            std::vector<mux_interval> intervals;
+            for (size_t i = 0; i < bounds.size(); i++) {
+                const uint64_t from = bounds[i];
+                const uint64_t to = i + 1 < bounds.size() ? bounds[i + 1] - 1 : max;
+
+                std::vector<uint32_t> present;
+                for (auto signal: dependants) {
+                    for (const auto &range: ranges[signal]) {
+                        if (range.first <= from && from <= range.second) {
+                            present.push_back(signal);
+                            break;
+                        }
+                    }
+                }
+                if (present.empty()) continue;
+
+                if (!intervals.empty() && intervals.back().to + 1 == from && intervals.back().signals == present) {
+                    intervals.back().to = to;
+                } else {
+                    intervals.push_back({from, to, std::move(present)});
+                }
+            }
+            return intervals;
+        }
+    }
+
+    dbc_mux_plan compile_multiplexing(const dbc_message &message) {
+        dbc_mux_plan plan;
+        const auto &signals = message.signals;
+        const auto count = static_cast<uint32_t>(signals.size());
+
+        bool multiplexed = std::any_of(signals.begin(), signals.end(), [](const dbc_signal &s) {
+            return s.multiplex_value >= 0 || !s.multiplex_ranges.empty();
+        });
+        if (!multiplexed) return plan;
+
+        auto find = [&signals, count](const std::string &name) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (signals[i].name == name) return static_cast<int64_t>(i);
+            }
+            return static_cast<int64_t>(-1);
+        };
+
+        int64_t top = -1;
+        for (uint32_t i = 0; i < count && top < 0; i++) {
+            const auto &s = signals[i];
+            if (s.is_multiplexor && s.multiplex_value < 0 && s.multiplex_ranges.empty()) top = i;
+        }
+
+        // Dependants of each multiplexor, count stands for the signals present in every frame
+        std::vector<std::vector<uint32_t>> dependants(count + 1);
+        std::vector<mux_ranges> ranges(count);
+        for (uint32_t i = 0; i < count; i++) {
+            const auto &s = signals[i];
+            int64_t multiplexor = count;
+            if (!s.multiplex_ranges.empty()) {
+                multiplexor = find(s.multiplexor);
+                ranges[i] = s.multiplex_ranges;
+            } else if (s.multiplex_value >= 0) {
+                multiplexor = top;
+                ranges[i].emplace_back(s.multiplex_value, s.multiplex_value);
+            }
+            if (multiplexor >= 0 && multiplexor != i) dependants[multiplexor].push_back(i);
+        }
+
+        // Cases are filled breadth first, so the switches of a case and the cases of a switch are each contiguous.
+        // Starting from the signals present in every frame only reaches multiplexors that can be decoded, a cycle of
+        // signals depending on each other is never reached.
+        std::deque<std::pair<uint32_t, std::vector<uint32_t>>> pending;
+        plan.cases.emplace_back();
+        pending.emplace_back(0, std::move(dependants[count]));
+
+        while (!pending.empty()) {
+            auto [index, present] = std::move(pending.front());
+            pending.pop_front();
+
+            plan.cases[index].first_signal = static_cast<uint32_t>(plan.signals.size());
+            plan.cases[index].signal_count = static_cast<uint32_t>(present.size());
+            plan.signals.insert(plan.signals.end(), present.begin(), present.end());
+
+            const auto first_switch = static_cast<uint32_t>(plan.switches.size());
+            for (auto signal: present) {
+                const auto &multiplexor = signals[signal].plan;
+                if (dependants[signal].empty() || !multiplexor.valid) continue;
+
+                dbc_mux_switch sw;
+                sw.multiplexor = signal;
+                sw.first_case = static_cast<uint32_t>(plan.cases.size());
+                for (auto &interval: split_ranges(dependants[signal], ranges, multiplexor.mask)) {
+                    dbc_mux_case c;
+                    c.from = interval.from;
+                    c.to = interval.to;
+                    pending.emplace_back(static_cast<uint32_t>(plan.cases.size()), std::move(interval.signals));
+                    plan.cases.push_back(c);
+                }
+                sw.case_count = static_cast<uint32_t>(plan.cases.size()) - sw.first_case;
+                if (sw.case_count > 0) plan.switches.push_back(sw);
+            }
+            plan.cases[index].first_switch = first_switch;
+            plan.cases[index].switch_count = static_cast<uint32_t>(plan.switches.size()) - first_switch;
+        }
+
+        return plan;
+    }
+
+    dbc_signal_plan compile_signal(const dbc_signal &signal) {
+        dbc_signal_plan plan;
+        plan.motorola = !signal.little_endian;
+        plan.is_signed = signal.is_signed;
+        plan.value_type = signal.value_type;
+        plan.scale = signal.scale;
+        plan.offset = signal.offset;
+
+        const int length = signal.length;
+        const int payload_bits = can::FRAME_MAX_DATA * 8;
+        if (length < 1 || length > 64 || signal.start < 0 || signal.start >= payload_bits) {
+            return plan;
+        }
+        if ((signal.value_type == dbc_value_type::ieee_float && length != 32) ||
+            (signal.value_type == dbc_value_type::ieee_double && length != 64)) {
+            return plan;
+        }
+
+        plan.mask = length == 64 ? ~0ULL : (1ULL << length) - 1;
+        plan.sign_bit = 1ULL << (length - 1);
+
+        int used;
+        if (!plan.motorola) {
+            // Bits numbered LSB first within each byte, bytes in increasing order
+            if (signal.start + length > payload_bits) return plan;
+
+            plan.byte = signal.start / 8;
+            plan.shift = signal.start % 8;
+            used = plan.shift + length;
+        } else {
+            // Convert the sawtooth MSB to a position counted MSB first across the whole payload
+            int msb = (signal.start / 8) * 8 + (7 - signal.start % 8);
+            if (msb + length > payload_bits) return plan;
+
+            plan.byte = msb / 8;
+            used = msb % 8 + length;
+            plan.shift = used <= 64 ? 64 - used : 0;
+        }
+        plan.spill = used > 64 ? used - 64 : 0;
+
+        plan.valid = true;
+        return plan;
+    }
+}
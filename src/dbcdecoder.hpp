@@ -0,0 +1,135 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DBCDECODER__
+#define __CANARY_DBCDECODER__
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "dbc.hpp"
+#include "can/frame.hpp"
+
+namespace canary {
+
+    // Payload copied into a zero-padded buffer so any signal can be read with one unaligned 64-bit load, plus one
+    // extra byte when it straddles the end of the word
+    struct dbc_payload {
+        static constexpr size_t SIZE = can::FRAME_MAX_DATA + 8;
+
+        alignas(8) uint8_t bytes[SIZE];
+
+        explicit dbc_payload(const can::frame &f) {
+            std::memcpy(bytes, f.data, f.dlc);
+            std::memset(bytes + f.dlc, 0, SIZE - f.dlc);
+        }
+    };
+
+    // Builds the shift/mask plan for a signal. Intel signals use the DBC start bit as their least significant bit,
+    // Motorola signals as their most significant bit in sawtooth numbering.
+    dbc_signal_plan compile_signal(const dbc_signal &signal);
+
+    // Resolves which signals of message are present for each value of its multiplexors, from the M/mN indicators and
+    // SG_MUL_VAL_ ranges. Plain mN signals depend on the message's M signal. Signals whose multiplexor is missing, or
+    // cannot be decoded, are never present.
+    dbc_mux_plan compile_multiplexing(const dbc_message &message);
+
+    inline uint64_t load_le64(const uint8_t *p) {
+        uint64_t v = 0;
+        for (int i = 7; i >= 0; i--) v = (v << 8) | p[i];
+        return v;
+    }
+
+    inline uint64_t load_be64(const uint8_t *p) {
+        uint64_t v = 0;
+        for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+        return v;
+    }
+
+    // Raw value before sign extension and scaling
+    inline uint64_t extract_raw(const dbc_signal_plan &plan, const dbc_payload &payload) {
+        const uint8_t *p = payload.bytes + plan.byte;
+        uint64_t raw;
+        if (!plan.motorola) {
+            raw = load_le64(p) >> plan.shift;
+            if (plan.spill) raw |= static_cast<uint64_t>(p[8]) << (64 - plan.shift);
+        } else if (plan.spill) {
+            raw = (load_be64(p) << plan.spill) | (p[8] >> (8 - plan.spill));
+        } else {
+            raw = load_be64(p) >> plan.shift;
+        }
+        return raw & plan.mask;
+    }
+
+    // Value held in the raw bits of an IEEE float or double signal
+    inline double ieee_value(dbc_value_type type, uint64_t raw) {
+        if (type == dbc_value_type::ieee_float) return std::bit_cast<float>(static_cast<uint32_t>(raw));
+        return std::bit_cast<double>(raw);
+    }
+
+    inline double decode_signal(const dbc_signal_plan &plan, const dbc_payload &payload) {
+        uint64_t raw = extract_raw(plan, payload);
+        if (plan.value_type != dbc_value_type::integer) {
+            return ieee_value(plan.value_type, raw) * plan.scale + plan.offset;
+        }
+        if (plan.is_signed) {
+            auto value = static_cast<int64_t>((raw ^ plan.sign_bit) - plan.sign_bit);
+            return static_cast<double>(value) * plan.scale + plan.offset;
+        }
+        return static_cast<double>(raw) * plan.scale + plan.offset;
+    }
+
+    // Case of the switch holding the multiplexor value, nullptr if the value has none
+    inline const dbc_mux_case *find_mux_case(const dbc_mux_plan &mux, const dbc_mux_switch &sw, uint64_t value) {
+        const auto *first = mux.cases.data() + sw.first_case;
+        const auto *last = first + sw.case_count;
+        const auto *it = std::lower_bound(first, last, value, [](const dbc_mux_case &e, uint64_t v) {
+            return e.to < v;
+        });
+        return (it != last && it->from <= value) ? it : nullptr;
+    }
+
+    // Decodes the signals of a multiplexer case, then the case each of its switches selects
+    inline size_t decode_mux_case(const dbc_message &message, const dbc_mux_case &c, const dbc_payload &payload,
+                                  double *values) {
+        const auto &mux = message.mux;
+        for (uint32_t i = c.first_signal; i < c.first_signal + c.signal_count; i++) {
+            const auto &plan = message.signals[mux.signals[i]].plan;
+            values[mux.signals[i]] = plan.valid ? decode_signal(plan, payload) : 0;
+        }
+
+        size_t decoded = c.signal_count;
+        for (uint32_t i = c.first_switch; i < c.first_switch + c.switch_count; i++) {
+            const auto &sw = mux.switches[i];
+            const uint64_t value = extract_raw(message.signals[sw.multiplexor].plan, payload);
+            if (const auto *selected = find_mux_case(mux, sw, value)) {
+                decoded += decode_mux_case(message, *selected, payload, values);
+            }
+        }
+        return decoded;
+    }
+
+    // Decodes every signal of message into values, which must have room for message.signals.size() entries. Signals
+    // with an invalid plan decode to 0, signals not present for the frame's multiplexor values to NaN. Returns the
+    // number of signals present.
+    inline size_t decode_message(const dbc_message &message, const can::frame &f, double *values) {
+        dbc_payload payload(f);
+        if (!message.mux.empty()) {
+            // A double with every bit set is a NaN, so memset can mark every signal absent
+            static_assert(std::numeric_limits<double>::is_iec559);
+            std::memset(values, 0xFF, message.signals.size() * sizeof(double));
+            return decode_mux_case(message, message.mux.cases[0], payload, values);
+        }
+
+        size_t i = 0;
+        for (const auto &signal: message.signals) {
+            values[i++] = signal.plan.valid ? decode_signal(signal.plan, payload) : 0;
+        }
+        return i;
+    }
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "dbcindex.hpp"
+
+namespace canary {
+    bool dbcindex::prefix_of(uint32_t id, uint32_t &prefix) const {
+        can::frame f{};
+        f.id = id;
+
+        char id_str[9];
+        size_t len = can::format_can_id(f, id_str);
+        if (m_offset < 0 || m_first_n > 8 || static_cast<size_t>(m_offset + m_first_n) > len) {
+            return false;
+        }
+
+        // Hex digits map to their value one to one, so comparing values compares the digits
+        prefix = 0;
+        for (int i = m_offset; i < m_offset + m_first_n; i++) {
+            const char c = id_str[i];
+            prefix = (prefix << 4) | static_cast<uint32_t>(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+        }
+        return true;
+    }
+
+    void dbcindex::build(const dbcdatabase &database) {
+        m_database = &database;
+        m_cache.clear();
+        m_generation++;
+        build_prefixes();
+    }
+
+    void dbcindex::clear() {
+        m_database = nullptr;
+        m_prefix.clear();
+        m_cache.clear();
+        m_generation++;
+    }
+
+    void dbcindex::set_match(int first_n, int offset) {
+        if (first_n == m_first_n && offset == m_offset) return;
+
+        m_first_n = first_n;
+        m_offset = offset;
+        m_cache.clear();
+        m_generation++;
+        build_prefixes();
+    }
+
+    void dbcindex::build_prefixes() {
+        m_prefix.clear();
+        if (!m_database || m_first_n <= 0) return;
+
+        for (const auto &entry: m_database->get_index()) {
+            uint32_t prefix;
+            if (!prefix_of(static_cast<uint32_t>(entry.key), prefix)) continue;
+
+            // Keep the lowest ID when several share a prefix so the match doesn't depend on hash order
+            const uint64_t key = (entry.key & 0xFFFFFFFF00000000ULL) | prefix;
+            auto [it, inserted] = m_prefix.emplace(key, entry.message);
+            if (!inserted && entry.message->can_id < it->second->can_id) {
+                it->second = entry.message;
+            }
+        }
+    }
+
+    const dbc_message *dbcindex::find(const can::frame &f) {
+        const uint32_t id = f.id & (can::FRAME_EXTENDED_FLAG | can::FRAME_EXTENDED_MASK);
+        const uint64_t key = dbcdatabase::make_key(f.bus, id);
+
+        auto cached = m_cache.find(key);
+        if (cached != m_cache.end()) {
+            return cached->second;
+        }
+
+        const dbc_message *message = m_database ? m_database->find(f.bus, id) : nullptr;
+        uint32_t prefix;
+        if (!message && !m_prefix.empty() && prefix_of(id, prefix)) {
+            auto it = m_prefix.find((static_cast<uint64_t>(f.bus) << 32) | prefix);
+            if (it == m_prefix.end()) {
+                it = m_prefix.find((static_cast<uint64_t>(dbcdatabase::ALL_BUSES) << 32) | prefix);
+            }
+            if (it != m_prefix.end()) message = it->second;
+        }
+
+        m_cache.emplace(key, message);
+        return message;
+    }
+}
@@ -0,0 +1,55 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_DBCINDEX__
+#define __CANARY_DBCINDEX__
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "dbcdatabase.hpp"
+#include "can/frame.hpp"
+
+namespace canary {
+
+    // Resolves frames to DBC messages. Exact IDs are looked up in the database for the frame's bus, and when first_n
+    // is set IDs are also matched on the first_n hex digits starting at offset (as shown in the packet table). Every
+    // unique (bus, frame ID) is resolved once and cached, including misses.
+    class dbcindex {
+    public:
+        // The database must outlive the index, build again whenever it changes
+        void build(const dbcdatabase &database);
+
+        void clear();
+
+        // first_n <= 0 disables prefix matching. Clears the cache if the options changed.
+        void set_match(int first_n, int offset);
+
+        // nullptr if no message matches
+        const dbc_message *find(const can::frame &f);
+
+        [[nodiscard]] inline size_t get_cache_size() const { return m_cache.size(); }
+
+        // Changes whenever a frame could resolve to a different message than before
+        [[nodiscard]] inline uint64_t get_generation() const { return m_generation; }
+
+    private:
+        // Keyed by bus (or dbcdatabase::ALL_BUSES) in the high 32 bits and the prefix digits as a hex value in the low
+        std::unordered_map<uint64_t, const dbc_message *> m_prefix;
+        // Keyed as dbcdatabase::make_key
+        std::unordered_map<uint64_t, const dbc_message *> m_cache;
+
+        const dbcdatabase *m_database{nullptr};
+        int m_first_n{-1};
+        int m_offset{0};
+        uint64_t m_generation{0};
+
+        // Digits of the ID compared for prefix matching, false if the ID is too short
+        bool prefix_of(uint32_t id, uint32_t &prefix) const;
+
+        void build_prefixes();
+    };
+
+}
+
+#endif
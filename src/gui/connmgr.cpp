@@ -1,6 +1,9 @@
 // Copyright (C) 2024 Ryan Bester
 
 #include "connmgr.hpp"
+
+#include <algorithm>
+
 #include "imgui.h"
 #include "gui.hpp"
 
@@ -73,7 +76,11 @@ namespace canary::gui {
                 if (ImGui::BeginPopup("Options")) {
                     ImGui::Checkbox("Non-blocking", &APP_CONFIG.conn_opts.non_blocking);
                     ImGui::InputInt("Timeout", &APP_CONFIG.conn_opts.timeout);
-                    ImGui::InputInt("Cooldown", &APP_CONFIG.conn_opts.cooldown);
+                    if (ImGui::InputInt("Memory budget (MB)", &APP_CONFIG.conn_opts.memory_budget_mb)) {
+                        APP_CONFIG.conn_opts.memory_budget_mb = std::max(APP_CONFIG.conn_opts.memory_budget_mb, 0);
+                        gui.m_packet_provider.set_memory_budget(
+                                static_cast<size_t>(APP_CONFIG.conn_opts.memory_budget_mb) * 1024 * 1024);
+                    }
                     ImGui::EndPopup();
                 }
 
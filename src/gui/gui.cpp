@@ -6,8 +6,16 @@
 
 #include "cmdline.hpp"
 #include "connmgr.hpp"
+#include "../dbccache.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
+#include <optional>
+#include <cstring>
+#include <cstdlib>
+#include <ctime>
 
 #if defined(WIN32)
 #define WIN32_LEAN_AND_MEAN
@@ -20,69 +28,80 @@
 
 namespace canary::gui {
 
-// TODO: Implement software filter
-    std::vector<std::string> excluded_ids = {
-            "10210040",
-            "10220040",
-            "1022A040",
-            "1022C040",
-            "1022E040",
-            "10230040",
-            "10240040",
-            "10242040",
-            "10244060",
-            "10248040", // Battery voltage?
-            "10250040",
-            "10264040",
-            "102A8097",
-            "102AA097",
-            "102AC097",
-            "102C0040",
-//        "102CA040", // Engine Information?
-            "102CC040",
-            "102CE040",
-            "102D0040",
-            "102E0040",
-            "10304058",
-            "10306099",
-            "10308060",
-            "10324058",
-            "10448060", // Fuel level?
-            "106B0040",
-            "106B8040",
-            "106C0040",
-            "106D0080",
-            "106E0097",
-            "10708040",
-            "10734099",
-            "1077C040",
-            "10780040",
-            "10788040",
-            "10800040",
-            "10806040",
-            "10814099",
-            "108E0080",
-            "10AE8060",
-            "10EC4040",
-            "10EC8040",
-            "13FFE040",
-            "13FFE058",
-            "13FFE060",
-            "13FFE066",
-            "13FFE068",
-            "13FFE080",
-            "13FFE097",
-            "13FFE099",
-            "13FFE0BB",
-            "621",
-            "624",
-            "62C",
-            "10466040",
-            "106D4099"
+    // IDs hidden by the packet filter by default
+    const uint32_t default_excluded_extended_ids[] = {
+            0x10210040,
+            0x10220040,
+            0x1022A040,
+            0x1022C040,
+            0x1022E040,
+            0x10230040,
+            0x10240040,
+            0x10242040,
+            0x10244060,
+            0x10248040, // Battery voltage?
+            0x10250040,
+            0x10264040,
+            0x102A8097,
+            0x102AA097,
+            0x102AC097,
+            0x102C0040,
+//        0x102CA040, // Engine Information?
+            0x102CC040,
+            0x102CE040,
+            0x102D0040,
+            0x102E0040,
+            0x10304058,
+            0x10306099,
+            0x10308060,
+            0x10324058,
+            0x10448060, // Fuel level?
+            0x106B0040,
+            0x106B8040,
+            0x106C0040,
+            0x106D0080,
+            0x106E0097,
+            0x10708040,
+            0x10734099,
+            0x1077C040,
+            0x10780040,
+            0x10788040,
+            0x10800040,
+            0x10806040,
+            0x10814099,
+            0x108E0080,
+            0x10AE8060,
+            0x10EC4040,
+            0x10EC8040,
+            0x13FFE040,
+            0x13FFE058,
+            0x13FFE060,
+            0x13FFE066,
+            0x13FFE068,
+            0x13FFE080,
+            0x13FFE097,
+            0x13FFE099,
+            0x13FFE0BB,
+            0x10466040,
+            0x106D4099
+    };
+
+    const uint32_t default_excluded_standard_ids[] = {
+            0x621,
+            0x624,
+            0x62C
     };
 
     void gui::load_options() {
         m_state.open_dialogs = APP_CONFIG.ui_opts.open_dialogs;
+
+        m_state.packet_filter.clear();
+        for (uint32_t id: default_excluded_extended_ids) {
+            m_state.packet_filter.add_id(canary::can::FRAME_EXTENDED_FLAG | id);
+        }
+        for (uint32_t id: default_excluded_standard_ids) {
+            m_state.packet_filter.add_id(id);
+        }
     }
 
     float gui::get_monitor_scale() {
@@ -130,6 +149,19 @@ namespace canary::gui {
     }
 
     void gui::render_frame() {
+        // Pick up frames queued by the listener thread since the last frame
+        m_packet_provider.poll();
+
+        if (m_packet_provider.get_epoch() != m_state.packets_epoch) {
+            // Packets were cleared or a capture was opened, indices into the old packets are no longer valid
+            m_state.packets_epoch = m_packet_provider.get_epoch();
+            m_state.packet_view_opts.rows = {};
+            m_state.packet_view_opts.selected_row = -1;
+            m_state.search_index.reset();
+            m_state.search_opts.diff_search.reset();
+            m_state.dbc_batch.reset();
+            m_state.search_opts.segment_start = 0;
+        }
 
         // TODO: menu_bar_size in class member
         const ImVec2 menu_bar_size = render_menu_bar();
@@ -143,6 +175,8 @@ namespace canary::gui {
         show_frame_properties();
         show_search();
         show_filter();
+        show_statistics();
+        show_signals();
 
         connmgr::show_conn_mgr(*this);
         connmgr::show_conn_mgr_edit_dlg(*this);
@@ -158,7 +192,7 @@ namespace canary::gui {
     ImVec2 gui::render_menu_bar() {
 
         // TODO: Temp
-        auto file_path = std::string("output.dat");
+        auto file_path = std::string("output.canary");
 
         ImVec2 menu_bar_size;
 
@@ -167,29 +201,40 @@ namespace canary::gui {
                 if (ImGui::MenuItem("Create")) {
                 }
                 if (ImGui::MenuItem("Open", "Ctrl+O")) {
-                    std::ifstream file(file_path);
-
-                    std::string line;
-                    while (std::getline(file, line)) {
-                        m_packet_provider.add_packet(line);
-                    }
-
                     IGFD::FileDialogConfig config;
                     config.path = ".";
                     m_state.file_dialogs.emplace_back("ChooseFileDlgKey");
-                    ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", ".cpp,.h,.hpp", config);
+                    ImGuiFileDialog::Instance()->OpenDialog("ChooseFileDlgKey", "Choose File", ".canary,.dat", config);
                 }
                 if (ImGui::MenuItem("Save", "Ctrl+S")) {
-                    std::ofstream file(file_path);
-
-                    for (const auto &frame: m_packet_provider.get_received_packets()) {
-                        file << frame << std::endl;
+                    if (m_packet_provider.save_capture(file_path) != 0) {
+                        std::cout << "Error saving capture to " << file_path << std::endl;
                     }
-
-                    file.close();
                 }
                 if (ImGui::MenuItem("Save as..")) {
                 }
+                ImGui::Separator();
+                const auto &recorder = m_packet_provider.get_recorder();
+                if (!recorder.is_recording()) {
+                    if (ImGui::MenuItem("Start recording")) {
+                        // Named after the start time so recordings never overwrite each other
+                        char recording_path[64];
+                        std::time_t now = std::time(nullptr);
+                        std::strftime(recording_path, sizeof(recording_path), "recording-%Y%m%d-%H%M%S.canary",
+                                      std::localtime(&now));
+                        m_packet_provider.start_recording(recording_path, true, [](const std::string &msg) {
+                            std::cout << msg << std::endl;
+                        });
+                    }
+                } else {
+                    char label[96];
+                    std::snprintf(label, sizeof(label), "Stop recording (%llu frames, %.1f MB)",
+                                  static_cast<unsigned long long>(recorder.get_frames_written()),
+                                  static_cast<double>(recorder.get_bytes_written()) / (1024.0 * 1024.0));
+                    if (ImGui::MenuItem(label)) {
+                        m_packet_provider.stop_recording();
+                    }
+                }
                 ImGui::EndMenu();
             }
             if (ImGui::BeginMenu("Edit")) {
@@ -199,6 +244,10 @@ namespace canary::gui {
                 if (ImGui::MenuItem("Reset Window Positions")) {
                     m_state.open_dialogs["reset_window_pos"] = true;
                 }
+                ImGui::MenuItem("Statistics", nullptr,
+                                &state_at_or_init(m_state.open_dialogs, std::string("statistics_win")));
+                ImGui::MenuItem("Signals", nullptr,
+                                &state_at_or_init(m_state.open_dialogs, std::string("signals_win")));
 
                 ImGui::EndMenu();
             }
@@ -302,8 +351,10 @@ namespace canary::gui {
                     std::string filePathName = ImGuiFileDialog::Instance()->GetFilePathName();
                     std::string filePath = ImGuiFileDialog::Instance()->GetCurrentPath();
 
-                    if (key == "ChooseDbcFileDlgKey") {
-                        m_state.dbc_file = canary::dbcparser::load_dbc_file(filePathName);
+                    if (key == "ChooseFileDlgKey") {
+                        open_capture(filePathName);
+                    } else if (key == "ChooseDbcFileDlgKey") {
+                        open_dbc(filePathName);
                     }
                 }
 
@@ -313,11 +364,130 @@ namespace canary::gui {
         }
     }
 
+    void gui::open_capture(const std::string &path) {
+        if (path.ends_with(".dat")) {
+            // Text capture saved by older versions, one socketcand frame per line
+            m_packet_provider.clear_packets();
+
+            std::ifstream file(path);
+            std::string line;
+            while (std::getline(file, line)) {
+                canary::can::frame frame{};
+                if (canary::can::parse_socketcand_frame(line, frame)) {
+                    m_packet_provider.add_packet(frame);
+                }
+            }
+            return;
+        }
+
+        m_packet_provider.open_capture(path, [](const std::string &msg) {
+            std::cout << msg << std::endl;
+        });
+    }
+
+    void gui::open_dbc(const std::string &path) {
+        // The signals' background update reads the database
+        m_state.dbc_batch.reset();
+        auto index = m_state.dbc_database.add(path, canary::dbccache::load(path, [](const std::string &msg) {
+            std::cout << msg << std::endl;
+        }));
+
+        // DBC files are named after the bus they describe, bind a newly opened one to that bus if it is connected
+        const auto &file = *m_state.dbc_database.get_files()[index];
+        if (file.buses.none()) {
+            const auto stem = std::filesystem::path(path).stem().string();
+            for (size_t bus = 0; bus < m_packet_provider.get_queue_count(); bus++) {
+                if (bus < canary::dbcdatabase::MAX_BUSES && m_packet_provider.get_queue_stats(bus).name == stem) {
+                    std::bitset<canary::dbcdatabase::MAX_BUSES> buses;
+                    buses.set(bus);
+                    m_state.dbc_database.set_buses(index, buses);
+                    break;
+                }
+            }
+        }
+
+        m_state.dbc_index.build(m_state.dbc_database);
+    }
+
     void gui::show_dbc_options_win() {
         if (state_at_or_init(m_state.open_dialogs, std::string("dbc_options_win"), false)) {
             if (ImGui::Begin("DBC Options")) {
                 ImGui::InputInt("Match first n characters, n:", &m_state.dbc_opt.first_n);
                 ImGui::InputInt("Offset by: ", &m_state.dbc_opt.offset);
+
+                auto &database = m_state.dbc_database;
+                const auto &files = database.get_files();
+                std::optional<size_t> remove;
+                bool changed = false;
+
+                if (!files.empty() &&
+                    ImGui::BeginTable("DbcFiles", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                    ImGui::TableSetupColumn("File", ImGuiTableColumnFlags_WidthStretch);
+                    ImGui::TableSetupColumn("Messages", ImGuiTableColumnFlags_WidthFixed, 70.0f);
+                    ImGui::TableSetupColumn("Buses", ImGuiTableColumnFlags_WidthFixed, 150.0f);
+                    ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed, 60.0f);
+                    ImGui::TableHeadersRow();
+
+                    const size_t bus_count = std::min(m_packet_provider.get_queue_count(),
+                                                      canary::dbcdatabase::MAX_BUSES);
+                    for (size_t i = 0; i < files.size(); i++) {
+                        const auto &file = *files[i];
+                        ImGui::PushID(static_cast<int>(i));
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("%s", std::filesystem::path(file.path).filename().string().c_str());
+                        if (ImGui::IsItemHovered()) ImGui::SetTooltip("%s", file.path.c_str());
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%zu", file.dbc->messages.size());
+
+                        ImGui::TableSetColumnIndex(2);
+                        std::string preview;
+                        for (size_t bus = 0; bus < canary::dbcdatabase::MAX_BUSES; bus++) {
+                            if (!file.buses.test(bus)) continue;
+                            if (!preview.empty()) preview += ", ";
+                            preview += bus < bus_count ? m_packet_provider.get_queue_stats(bus).name
+                                                       : std::to_string(bus);
+                        }
+                        if (preview.empty()) preview = "All buses";
+
+                        ImGui::SetNextItemWidth(-1.0f);
+                        if (ImGui::BeginCombo("##buses", preview.c_str())) {
+                            auto buses = file.buses;
+                            if (ImGui::Selectable("All buses", buses.none())) {
+                                buses.reset();
+                            }
+                            for (size_t bus = 0; bus < bus_count; bus++) {
+                                const auto &name = m_packet_provider.get_queue_stats(bus).name;
+                                if (ImGui::Selectable(name.c_str(), buses.test(bus),
+                                                      ImGuiSelectableFlags_DontClosePopups)) {
+                                    buses.flip(bus);
+                                }
+                            }
+                            if (buses != file.buses) {
+                                m_state.dbc_batch.reset();
+                                database.set_buses(i, buses);
+                                changed = true;
+                            }
+                            ImGui::EndCombo();
+                        }
+
+                        ImGui::TableSetColumnIndex(3);
+                        if (ImGui::SmallButton("Remove")) {
+                            remove = i;
+                        }
+                        ImGui::PopID();
+                    }
+                    ImGui::EndTable();
+                }
+
+                if (remove) {
+                    m_state.dbc_batch.reset();
+                    database.remove(*remove);
+                    changed = true;
+                }
+                if (changed) {
+                    m_state.dbc_index.build(database);
+                }
             }
 
             ImGui::End();
@@ -330,132 +500,97 @@ namespace canary::gui {
             ImGui::Checkbox("Auto scroll", &m_state.packet_view_opts.auto_scroll);
             ImGui::Checkbox("Pause", &m_state.packet_view_opts.paused);
 
-            if (ImGui::BeginTable("PacketTable", 5,
+            if (ImGui::BeginTable("PacketTable", 6,
                                   ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
                 ImGui::TableSetupColumn("Index", ImGuiTableColumnFlags_WidthFixed, 50.0f);
                 ImGui::TableSetupColumn("Timestamp", ImGuiTableColumnFlags_WidthStretch, 0.1f);
                 ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthFixed, 0.0f);
                 ImGui::TableSetupColumn("Len", ImGuiTableColumnFlags_WidthFixed, 50.0f);
                 ImGui::TableSetupColumn("Data", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
 
                 ImGui::TableSetupScrollFreeze(0, 1);
                 ImGui::TableHeadersRow();
 
-                ImGuiListClipper clipper;
-                clipper.Begin(static_cast<int>(m_packet_provider.get_received_packets().size()));
-
-//                std::lock_guard<std::mutex> lock(packets_mutex);
-
-//                while (clipper.Step()) {
-//                    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
-                for (size_t i = 0; i < m_packet_provider.get_received_packets().size(); ++i) {
-                    std::vector<std::string> parts = split_string(m_packet_provider.get_received_packets()[i],
-                                                                  std::string(" "));
-                    if (parts.size() != 6) {
-                        // Probably < ok > or malformed packet, ignore/*
-                        continue;
-                    }
-
-                    if (m_state.packet_filter_enabled) {
-                        if (std::find(excluded_ids.begin(), excluded_ids.end(), parts[2]) != excluded_ids.end()) {
-                            // Excluded ID, ignore
-                            continue;
-                        }
-                    }
-
-//                    if (parts[4].length() / 2 != 8) {
-//                        continue;
-//                    }
+                m_state.dbc_index.set_match(m_state.dbc_opt.first_n, m_state.dbc_opt.offset);
 
-                    ImGui::TableNextRow();
-                    ImGui::TableSetColumnIndex(0);
-                    ImGui::Text("%zu", i + 1);
-                    ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", parts[3].c_str());
-                    ImGui::TableSetColumnIndex(2);
-                    ImGui::Text("0x%s", parts[2].c_str());
-                    ImGui::TableSetColumnIndex(3);
-                    ImGui::Text("%zu", parts[4].length() / 2);
-                    ImGui::TableSetColumnIndex(4);
-//                    ImGui::Text("%s", parts[4].c_str());
+                const auto &packets = m_packet_provider.get_received_packets();
+                m_state.packet_filter.update_view(m_state.packet_view_opts.rows, packets);
+                const auto &rows = m_state.packet_view_opts.rows.rows;
 
-                    bool is_selected = (m_state.packet_view_opts.selected_row == i);
-                    if (ImGui::Selectable(parts[4].c_str(), is_selected, ImGuiSelectableFlags_SpanAllColumns)) {
-                        m_state.packet_view_opts.selected_row = (is_selected ? -1 : i);
-                    }
-
-                    if (!m_state.dbc_file.messages.empty()) {
-//                        if (dbc_file.messages.contains(std::stol(parts[2]))) {
-//                            auto message = dbc_file.messages.at(std::stol(parts[2]));
-//                            ImGui::Text(message.name.c_str());
-//                        } else {
-//                            ImGui::Text("CAN ID not found in DBC file");
-//                        }
-                        bool found(false);
-                        for (const auto &[can_id, message]: m_state.dbc_file.messages) {
-                            // DBC file represents IDs as a decimal, convert here to a hex string
-                            std::stringstream stream;
-                            stream << std::hex << can_id;
-                            std::string can_id_hex(stream.str());
-
-                            // TODO: Cache of found IDs
-                            // TODO: Use dbc_options_first_n variable
-                            // TODO: Skip first character for now, until offset implemented
-                            auto can_id_first_n = can_id_hex.substr(1, 4);
-                            auto to_find_first_n = parts[2].substr(1, 4);
-
-                            std::transform(can_id_first_n.begin(), can_id_first_n.end(), can_id_first_n.begin(),
-                                           ::toupper);
-                            std::transform(to_find_first_n.begin(), to_find_first_n.end(), to_find_first_n.begin(),
-                                           ::toupper);
-
-                            if (can_id_first_n == to_find_first_n) {
-                                found = true;
-                                ImGui::Text("Matching CAN ID: 0x%s", can_id_hex.c_str());
-                                ImGui::Text("Packet: %s", message.name.c_str());
-
-                                if (is_selected) {
-                                    m_state.packet_view_opts.selected_frame = std::make_pair(message, parts[4].c_str());
-                                }
+                // Rows are one line each so the clipper can work out which are visible without laying out the rest
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(rows.size()));
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        const size_t i = rows[row];
+                        const auto &frame = packets[i];
+
+                        char id_str[9];
+                        canary::can::format_can_id(frame, id_str);
+                        char timestamp_str[32];
+                        canary::can::format_timestamp(frame, timestamp_str);
+                        char data_str[canary::can::FRAME_MAX_DATA * 2 + 1];
+                        canary::can::format_data(frame, data_str);
+
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("%zu", i + 1);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%s", timestamp_str);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("0x%s", id_str);
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%d", frame.dlc);
+                        ImGui::TableSetColumnIndex(4);
+
+                        const dbc_message *message = nullptr;
+                        if (!m_state.dbc_database.empty()) {
+                            message = m_state.dbc_index.find(frame);
+                        }
 
-                                break;
+                        bool is_selected = (m_state.packet_view_opts.selected_row == static_cast<int>(i));
+                        ImGui::PushID(static_cast<int>(i));
+                        if (ImGui::Selectable(data_str, is_selected, ImGuiSelectableFlags_SpanAllColumns)) {
+                            m_state.packet_view_opts.selected_row = (is_selected ? -1 : static_cast<int>(i));
+                            if (!is_selected && message) {
+                                m_state.packet_view_opts.selected_frame = std::make_pair(*message, frame);
                             }
                         }
+                        ImGui::PopID();
 
-                        if (!found) {
-                            ImGui::Text("CAN ID not found in DBC file");
+                        ImGui::TableSetColumnIndex(5);
+                        if (message) {
+                            ImGui::Text("%s (0x%lx)", message->name.c_str(), message->can_id);
+                        } else if (!m_state.dbc_database.empty()) {
+                            ImGui::TextDisabled("Not in DBC file");
                         }
-                    }
-
 
-                    if (parts[2] == "102CA040") {
-                        // Engine information
-                        std::vector<bool> bits = hexStringToBitArray(parts[4]);
+                        if (frame.can_id() == 0x102CA040) {
+                            // Engine information
+                            std::vector<bool> bits = bytesToBitArray(frame.data, frame.dlc);
 
-                        // Engine information
-                        bool engineRunning = bits[14];
-                        ImGui::Text("    %d", engineRunning);
-
-                        uint16_t engine_speed = extractFromBoolVector(bits, 23);
-                        ImGui::Text("    %f", 0 + 0.25 * engine_speed);
-                    }
-
-                    if (parts[2] == "10248040") {
-                        // Battery voltage
-                        std::vector<bool> bits = hexStringToBitArray(parts[4]);
+                            bool engineRunning = bits[14];
+                            uint16_t engine_speed = extractFromBoolVector(bits, 23);
+                            ImGui::SameLine();
+                            ImGui::Text("    %d %f", engineRunning, 0 + 0.25 * engine_speed);
+                        }
 
-                        uint8_t voltage = extractFromBoolVectorInt(bits, 23);
-                        ImGui::Text("    %f V", 3 + 0.1 * voltage);
-                    }
+                        if (frame.can_id() == 0x10248040) {
+                            // Battery voltage
+                            std::vector<bool> bits = bytesToBitArray(frame.data, frame.dlc);
 
-                    if (i == m_packet_provider.get_received_packets().size() - 1 &&
-                        m_state.packet_view_opts.auto_scroll) {
-                        ImGui::SetScrollHereY(1.0f);
+                            uint8_t voltage = extractFromBoolVectorInt(bits, 23);
+                            ImGui::SameLine();
+                            ImGui::Text("    %f V", 3 + 0.1 * voltage);
+                        }
                     }
+                }
 
-                    // FIXME: Pause can cause listener thread to break
+                if (m_state.packet_view_opts.auto_scroll && !rows.empty()) {
+                    ImGui::SetScrollHereY(1.0f);
                 }
-//                }
+
                 ImGui::EndTable();
             }
             ImGui::End();
@@ -467,10 +602,13 @@ namespace canary::gui {
         {
             auto frame = m_state.packet_view_opts.selected_frame;
 
+            char data_str[canary::can::FRAME_MAX_DATA * 2 + 1];
+            canary::can::format_data(frame.second, data_str);
+
             ImGui::Text("Name: %s", frame.first.name.c_str());
-            ImGui::Text("Data (hex): %s", frame.second.c_str());
+            ImGui::Text("Data (hex): %s", data_str);
 
-            std::vector<bool> bit_array = hexStringToBitArray(frame.second);
+            std::vector<bool> bit_array = bytesToBitArray(frame.second.data, frame.second.dlc);
             std::string bit_array_str;
             bit_array_str.reserve(bit_array.size());
             for (bool b: bit_array) {
@@ -481,25 +619,16 @@ namespace canary::gui {
             ImGui::Text("");
             ImGui::Text("Signals:");
 
-            for (const auto &signal: frame.first.signals) {
-                if (signal.length == 8) {
-                    // Int8
-                    auto val = extractFromBoolVectorInt(bit_array, signal.start);
-                    auto scaled_val = signal.offset + signal.scale * (float) val;
-                    ImGui::Text("%s: %.2f", signal.name.c_str(), scaled_val);
-                } else if (signal.length == 16) {
-                    // Int16
-                    auto val = extractFromBoolVector(bit_array, signal.start);
-
-                    if (!signal.little_endian) {
-                        val = swap_endian_16(val);
-                    }
-
-                    auto scaled_val = signal.offset + signal.scale * (float) val;
-                    ImGui::Text("%s: %.2f", signal.name.c_str(), scaled_val);
-                } else {
-                    // Unknown type
-                    ImGui::Text("%s: (Unknown type)", signal.name.c_str());
+            const auto &signals = frame.first.signals;
+            std::vector<double> values(signals.size());
+            canary::decode_message(frame.first, frame.second, values.data());
+            for (size_t i = 0; i < signals.size(); i++) {
+                const auto &signal = signals[i];
+                if (!signal.plan.valid) {
+                    ImGui::Text("%s: (Invalid layout)", signal.name.c_str());
+                } else if (!std::isnan(values[i])) {
+                    // Multiplexed signals not in this frame are left out
+                    ImGui::Text("%s: %.2f %s", signal.name.c_str(), values[i], signal.unit.c_str());
                 }
             }
 
@@ -507,131 +636,297 @@ namespace canary::gui {
         }
     }
 
-    void gui::show_search() {
-        ImGui::Begin("Search");
-        {
-            ImGui::InputInt("Range Start", &m_state.search_opts.search_start);
-            ImGui::InputInt("End", &m_state.search_opts.search_end);
-
-            if (m_state.search_opts.search_num == 1) {
-                if (ImGui::Button("First search")) {
-                    m_state.packet_view_opts.paused = true;
-
-                    //std::lock_guard<std::mutex> lock(packets_mutex);
-                    for (const auto &received_packet: m_packet_provider.get_received_packets()) {
-                        for (auto term = m_state.search_opts.search_start;
-                             term <= m_state.search_opts.search_end; term++) {
-                            std::stringstream hex_str;
-                            hex_str << std::hex << term;
-
-                            std::vector<std::string> parts = split_string(received_packet, std::string(" "));
-
-                            if (parts[4].find(hex_str.str()) != std::string::npos) {
-                                std::stringstream msg;
-                                msg << term << " found in packet. Data: ";
-                                msg << parts[4];
-                                m_state.search_opts.search_1_ids.emplace_back(parts[2], msg.str());
-                            }
-                        }
-                    }
+    void gui::show_signals() {
+        bool &open = state_at_or_init(m_state.open_dialogs, std::string("signals_win"), false);
+        if (!open) return;
 
+        if (ImGui::Begin("Signals", &open)) {
+            if (m_state.dbc_database.empty()) {
+                ImGui::TextDisabled("Open a DBC file to decode signals");
+                ImGui::End();
+                return;
+            }
+
+            auto &opts = m_state.signal_view_opts;
+            const auto &selected_frame = m_state.packet_view_opts.selected_frame.second;
+            const auto bus = static_cast<uint8_t>(opts.series == UINT64_MAX ? selected_frame.bus : opts.series >> 32);
+            const auto id = static_cast<uint32_t>(opts.series == UINT64_MAX ? selected_frame.id : opts.series);
+
+            // Only groups frames received since the last frame and decodes the message shown, or everything after
+            // the DBC or capture changed. A lot of frames (the whole capture the first time) are done in the
+            // background.
+            auto &batch = m_state.dbc_batch;
+            const canary::dbcbatch::series *shown = nullptr;
+            if (!batch.is_updating()) {
+                shown = batch.update(m_packet_provider, m_state.dbc_index, bus, id);
+            }
+            if (batch.is_updating()) {
+                ImGui::ProgressBar(batch.get_progress(), ImVec2(-1.0f, 0.0f), "Decoding signals");
+                ImGui::End();
+                return;
+            }
 
-                    m_packet_provider.clear_packets();
-                    m_state.packet_view_opts.paused = false;
-                    m_state.search_opts.search_num++;
+            auto describe = [this](const canary::dbcbatch::series &s) {
+                const std::string bus = s.bus < m_packet_provider.get_queue_count()
+                                        ? m_packet_provider.get_queue_stats(s.bus).name : std::to_string(s.bus);
+                char label[160];
+                std::snprintf(label, sizeof(label), "%s (0x%X) on %s", s.message->name.c_str(),
+                              s.id & canary::can::FRAME_EXTENDED_MASK, bus.c_str());
+                return std::string(label);
+            };
+
+            std::string preview = "Selected frame";
+            if (shown && opts.series != UINT64_MAX) preview = describe(*shown);
+            if (ImGui::BeginCombo("Message", preview.c_str())) {
+                if (ImGui::Selectable("Selected frame", opts.series == UINT64_MAX)) {
+                    opts.series = UINT64_MAX;
                 }
-            } else if (m_state.search_opts.search_num == 2) {
-                if (ImGui::Button("Second search")) {
-                    m_state.packet_view_opts.paused = true;
-
-                    //std::lock_guard<std::mutex> lock(packets_mutex);
-                    for (const auto &received_packet: m_packet_provider.get_received_packets()) {
-                        for (auto term = m_state.search_opts.search_start;
-                             term <= m_state.search_opts.search_end; term++) {
-                            std::stringstream hex_str;
-                            hex_str << std::hex << term;
-
-                            std::vector<std::string> parts = split_string(received_packet, std::string(" "));
-
-                            if (parts[4].find(hex_str.str()) != std::string::npos) {
-                                std::stringstream msg;
-                                msg << term << " found in packet. Data: ";
-                                msg << parts[4];
-                                m_state.search_opts.search_2_ids.emplace_back(parts[2], msg.str());
-                            }
-                        }
+                for (const auto &s: batch.get_series()) {
+                    const uint64_t key = canary::dbcdatabase::make_key(s->bus, s->id);
+                    if (ImGui::Selectable(describe(*s).c_str(), key == opts.series)) {
+                        opts.series = key;
                     }
+                }
+                ImGui::EndCombo();
+            }
+
+            if (!shown) {
+                ImGui::TextDisabled("No decoded frames for this message");
+            } else if (ImGui::BeginTable("SignalsTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                const size_t frames = shown->frames.size();
+                ImGui::TableSetupColumn("Signal");
+                ImGui::TableSetupColumn("Frames");
+                ImGui::TableSetupColumn("Min");
+                ImGui::TableSetupColumn("Max");
+                ImGui::TableSetupColumn("Last");
+                ImGui::TableSetupColumn("Plot", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableHeadersRow();
+
+                for (size_t i = 0; i < shown->columns.size(); i++) {
+                    const auto &signal = shown->message->signals[i];
+                    const auto &column = shown->columns[i];
 
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(signal.name.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%zu/%zu", column.present, frames);
+                    if (column.present == 0) continue;
 
-                    m_packet_provider.clear_packets();
-                    m_state.packet_view_opts.paused = false;
-                    m_state.search_opts.search_num++;
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.2f %s", column.min, signal.unit.c_str());
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.2f %s", column.max, signal.unit.c_str());
+                    ImGui::TableSetColumnIndex(4);
+                    for (auto it = column.values.rbegin(); it != column.values.rend(); ++it) {
+                        if (std::isnan(*it)) continue;
+                        ImGui::Text("%.2f %s", *it, signal.unit.c_str());
+                        break;
+                    }
+
+                    // Only columns present in every frame, multiplexed ones would plot gaps as values
+                    ImGui::TableSetColumnIndex(5);
+                    if (column.present == frames) {
+                        ImGui::PushID(static_cast<int>(i));
+                        ImGui::PlotLines("##plot", [](void *data, int idx) {
+                            return static_cast<float>(static_cast<const double *>(data)[idx]);
+                        }, const_cast<double *>(column.values.data()), static_cast<int>(frames), 0, nullptr,
+                                         static_cast<float>(column.min), static_cast<float>(column.max),
+                                         ImVec2(-1.0f, 30.0f));
+                        ImGui::PopID();
+                    }
                 }
-            } else {
-                if (ImGui::Button("Reset")) {
-                    m_state.search_opts.search_1_ids.clear();
-                    m_state.search_opts.search_2_ids.clear();
+                ImGui::EndTable();
+            }
+        }
+
+        ImGui::End();
+    }
+
+    void gui::find_values(std::vector<std::tuple<std::string, std::string>> &results) {
+        const auto &packets = m_packet_provider.get_received_packets();
+
+        auto lo = static_cast<uint8_t>(std::clamp(m_state.search_opts.search_start, 0, 255));
+        auto hi = static_cast<uint8_t>(std::clamp(m_state.search_opts.search_end, 0, 255));
+
+        for (const auto &match: m_state.search_index.find_ids(lo, hi)) {
+            canary::can::frame id_frame{};
+            id_frame.id = match.id;
+            char id_str[9];
+            canary::can::format_can_id(id_frame, id_str);
+
+            std::stringstream msg;
+            msg << "Found at byte";
+            for (int i = 0; i < 64; i++) {
+                if (match.positions & (1ULL << i)) msg << " " << i;
+            }
 
-                    m_state.search_opts.search_num = 1;
+            // Show the most recent payload holding one of the values
+            const auto *frames = m_state.search_index.get_frames(match.id);
+            for (auto it = frames->rbegin(); it != frames->rend(); ++it) {
+                const auto &frame = packets[*it];
+                auto end = frame.data + frame.dlc;
+                if (std::find_if(frame.data, end, [lo, hi](uint8_t v) { return v >= lo && v <= hi; }) != end) {
+                    char data_str[canary::can::FRAME_MAX_DATA * 2 + 1];
+                    canary::can::format_data(frame, data_str);
+                    msg << ". Data: " << data_str;
+                    break;
                 }
             }
 
+            results.emplace_back(id_str, msg.str());
+        }
+    }
+
+    void gui::show_search() {
+        auto &opts = m_state.search_opts;
+        auto &diff = opts.diff_search;
+        auto &index = m_state.search_index;
+
+        ImGui::Begin("Search");
+        {
+            ImGui::InputInt("Range Start", &opts.search_start);
+            ImGui::InputInt("End", &opts.search_end);
+
+            if (ImGui::Button("Find values")) {
+                opts.value_results.clear();
+                opts.find_pending = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear results")) {
+                opts.value_results.clear();
+                opts.find_pending = false;
+            }
 
-            ImGui::Text("First search results:");
-            if (ImGui::BeginTable("FoundPacketsTable", 2,
-                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
-                ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthFixed, 50.0f);
+            // The index is only built once values are searched for, and then only takes in the packets received
+            // since the last search. A lot of packets (the whole capture the first time) are indexed in the
+            // background.
+            if (opts.find_pending && !index.is_updating() && index.update(m_packet_provider)) {
+                find_values(opts.value_results);
+                opts.find_pending = false;
+            }
+            if (index.is_updating()) {
+                ImGui::ProgressBar(index.get_progress(), ImVec2(-1.0f, 0.0f), "Indexing payloads");
+            }
+
+            if (!opts.value_results.empty() &&
+                ImGui::BeginTable("FoundPacketsTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthFixed, 80.0f);
                 ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
 
                 ImGui::TableSetupScrollFreeze(0, 1);
                 ImGui::TableHeadersRow();
 
-
-                for (auto &search_1_id: m_state.search_opts.search_1_ids) {
+                for (auto &result: opts.value_results) {
                     ImGui::TableNextRow();
                     ImGui::TableSetColumnIndex(0);
-                    ImGui::Text("0x%s", get<0>(search_1_id).c_str());
+                    ImGui::Text("0x%s", get<0>(result).c_str());
                     ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", get<1>(search_1_id).c_str());
+                    ImGui::Text("%s", get<1>(result).c_str());
                 }
                 ImGui::EndTable();
+            }
 
+            ImGui::Separator();
+            ImGui::Text("Differential search");
+
+            // A long segment is summarised in the background, the segments and stages are left alone until it is done
+            if (diff.is_updating()) {
+                ImGui::ProgressBar(diff.get_progress(), ImVec2(-1.0f, 0.0f), "Summarising segment");
+                ImGui::End();
+                return;
             }
 
+            const size_t packet_count = m_packet_provider.get_received_packets().size();
+            if (opts.segment_start > packet_count) {
+                opts.segment_start = 0;
+            }
 
-            ImGui::Text("Second search results:");
-            if (ImGui::BeginTable("FoundPacketsTable2", 2,
-                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
-                ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthFixed, 50.0f);
-                ImGui::TableSetupColumn("Message", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::Text("Segments: %zu, current segment: %zu frames", diff.get_segments().size(),
+                        packet_count - opts.segment_start);
+            if (ImGui::Button("End segment")) {
+                // The index the new segment will have, it may still be summarised in the background
+                opts.diff_segment = static_cast<int>(diff.get_segments().size());
+                diff.add_segment(m_packet_provider, opts.segment_start, packet_count);
+                opts.segment_start = packet_count;
+            }
 
-                ImGui::TableSetupScrollFreeze(0, 1);
-                ImGui::TableHeadersRow();
+            const char *conditions[] = {"Changed", "Unchanged", "Increased", "Decreased", "In range"};
+            ImGui::Combo("Condition", &opts.diff_condition, conditions, IM_ARRAYSIZE(conditions));
+            ImGui::InputInt("Segment", &opts.diff_segment);
+
+            if (ImGui::Button("Apply") && opts.diff_segment >= 0 &&
+                opts.diff_segment < static_cast<int>(diff.get_segments().size())) {
+                diff.apply(opts.diff_segment, static_cast<canary::can::diffsearch::condition>(opts.diff_condition),
+                           static_cast<uint8_t>(std::clamp(opts.search_start, 0, 255)),
+                           static_cast<uint8_t>(std::clamp(opts.search_end, 0, 255)));
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Back")) {
+                diff.undo();
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset")) {
+                diff.reset();
+                opts.segment_start = packet_count;
+                opts.diff_segment = 0;
+            }
 
-                for (auto &search_2_id: m_state.search_opts.search_2_ids) {
-                    bool found(false);
+            for (size_t i = 0; i < diff.get_stages().size(); i++) {
+                const auto &stage = diff.get_stages()[i];
+                ImGui::Text("Stage %zu: %s in segment %zu, %zu candidates", i + 1,
+                            canary::can::diffsearch::condition_name(stage.cond), stage.segment,
+                            stage.candidates.size());
+            }
 
-                    auto it = std::find_if(m_state.search_opts.search_1_ids.begin(),
-                                           m_state.search_opts.search_1_ids.end(),
-                                           [&search_2_id](const std::tuple<std::string, std::string> &e) {
-                                               return std::get<0>(e) == get<0>(search_2_id);
-                                           });
-                    if (it != m_state.search_opts.search_1_ids.end()) {
-                        found = true;
-                    }
+            if (!diff.get_stages().empty() &&
+                ImGui::BeginTable("DiffCandidatesTable", 6,
+                                  ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY)) {
+                ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthFixed, 80.0f);
+                ImGui::TableSetupColumn("Byte", ImGuiTableColumnFlags_WidthFixed, 40.0f);
+                ImGui::TableSetupColumn("First", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Last", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Min", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Max", ImGuiTableColumnFlags_WidthStretch);
 
-                    if (!found) continue;
+                ImGui::TableSetupScrollFreeze(0, 1);
+                ImGui::TableHeadersRow();
 
-                    ImGui::TableNextRow();
-                    ImGui::TableSetColumnIndex(0);
-                    ImGui::Text("0x%s", get<0>(search_2_id).c_str());
-                    ImGui::TableSetColumnIndex(1);
-                    ImGui::Text("%s", get<1>(search_2_id).c_str());
+                const auto &stage = diff.get_stages().back();
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(stage.candidates.size()));
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        auto k = stage.candidates[row];
+
+                        canary::can::frame id_frame{};
+                        id_frame.id = canary::can::diffsearch::key_id(k);
+                        char id_str[9];
+                        canary::can::format_can_id(id_frame, id_str);
+
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("0x%s", id_str);
+                        ImGui::TableSetColumnIndex(1);
+                        ImGui::Text("%d", canary::can::diffsearch::key_byte(k));
+
+                        // Values as seen in the segment the last stage looked at
+                        if (const auto *summary = diff.find_summary(stage.segment, k)) {
+                            ImGui::TableSetColumnIndex(2);
+                            ImGui::Text("%d", summary->first);
+                            ImGui::TableSetColumnIndex(3);
+                            ImGui::Text("%d", summary->last);
+                            ImGui::TableSetColumnIndex(4);
+                            ImGui::Text("%d", summary->min);
+                            ImGui::TableSetColumnIndex(5);
+                            ImGui::Text("%d", summary->max);
+                        }
+                    }
                 }
 
                 ImGui::EndTable();
-
             }
+
             ImGui::End();
         }
     }
@@ -639,17 +934,58 @@ namespace canary::gui {
     void gui::show_filter() {
         ImGui::Begin("Filter");
         {
-            ImGui::Checkbox("Enable Packet Filter", &m_state.packet_filter_enabled);
+            auto &filter = m_state.packet_filter;
+
+            bool enabled = filter.is_enabled();
+            if (ImGui::Checkbox("Enable Packet Filter", &enabled)) {
+                filter.set_enabled(enabled);
+            }
+
+            int mode = filter.get_mode() == canary::can::packetfilter::mode::INCLUDE ? 1 : 0;
+            bool mode_changed = ImGui::RadioButton("Exclude", &mode, 0);
+            ImGui::SameLine();
+            mode_changed |= ImGui::RadioButton("Include only", &mode, 1);
+            if (mode_changed) {
+                filter.set_mode(mode == 1 ? canary::can::packetfilter::mode::INCLUDE
+                                          : canary::can::packetfilter::mode::EXCLUDE);
+            }
 
-            if (ImGui::BeginTable("FilteredPacketsTable", 1, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            static char new_id[9] = "";
+            bool add = ImGui::InputText("##NewId", new_id, sizeof(new_id),
+                                        ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue);
+            ImGui::SameLine();
+            add |= ImGui::Button("Add ID");
+            if (add) {
+                size_t len = std::strlen(new_id);
+                if (len > 0) {
+                    auto id = static_cast<uint32_t>(std::strtoul(new_id, nullptr, 16));
+                    // Same rule as socketcand: more than 3 digits is an extended ID
+                    filter.add_id(len > 3 ? (canary::can::FRAME_EXTENDED_FLAG | id) : id);
+                    new_id[0] = '\0';
+                }
+            }
+
+            if (ImGui::BeginTable("FilteredPacketsTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
                 ImGui::TableSetupColumn("CAN ID", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
 
                 ImGui::TableHeadersRow();
 
-                for (auto &id: excluded_ids) {
+                for (uint32_t id: filter.get_ids()) {
+                    canary::can::frame f{};
+                    f.id = id;
+                    char id_str[9];
+                    canary::can::format_can_id(f, id_str);
+
                     ImGui::TableNextRow();
                     ImGui::TableSetColumnIndex(0);
-                    ImGui::Text("0x%s", id.c_str());
+                    ImGui::Text("0x%s", id_str);
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::PushID(static_cast<int>(id));
+                    if (ImGui::SmallButton("Remove")) {
+                        filter.remove_id(id);
+                    }
+                    ImGui::PopID();
                 }
 
                 ImGui::EndTable();
@@ -659,6 +995,96 @@ namespace canary::gui {
         }
     }
 
+    void gui::show_statistics() {
+        bool &open = state_at_or_init(m_state.open_dialogs, std::string("statistics_win"), false);
+        if (!open) return;
+
+        if (ImGui::Begin("Statistics", &open)) {
+            using canary::can::format_latency;
+
+            const auto &stats = m_packet_provider.get_stats();
+            const double seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - stats.since).count();
+
+            ImGui::Text("Latency from frame timestamp, over the last %.0f s", seconds);
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Reset")) {
+                m_packet_provider.reset_stats();
+            }
+
+            if (ImGui::BeginTable("StatisticsStagesTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Stage", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Frames/s");
+                ImGui::TableSetupColumn("p50");
+                ImGui::TableSetupColumn("p99");
+                ImGui::TableSetupColumn("p99.9");
+                ImGui::TableSetupColumn("Max");
+                ImGui::TableHeadersRow();
+
+                auto stage_row = [seconds](const std::string &name, uint64_t frames,
+                                           const canary::can::latency_histogram &latency) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(name.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%.0f", seconds > 0 ? frames / seconds : 0.0);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::TextUnformatted(format_latency(latency.percentile(50)).c_str());
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::TextUnformatted(format_latency(latency.percentile(99)).c_str());
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::TextUnformatted(format_latency(latency.percentile(99.9)).c_str());
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::TextUnformatted(format_latency(latency.get_max()).c_str());
+                };
+
+                for (size_t i = 0; i < m_packet_provider.get_queue_count(); i++) {
+                    const auto &queue = m_packet_provider.get_queue_stats(i);
+                    stage_row("Queued (" + queue.name + ")", queue.frames.load(), queue.received);
+                }
+                stage_row("Stored", stats.stored_frames.load(), stats.stored);
+                stage_row("Rendered", stats.rendered_frames.load(), stats.rendered);
+
+                ImGui::EndTable();
+            }
+
+            if (ImGui::BeginTable("StatisticsQueuesTable", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Queue", ImGuiTableColumnFlags_WidthStretch);
+                ImGui::TableSetupColumn("Dropped");
+                ImGui::TableSetupColumn("High water");
+                ImGui::TableHeadersRow();
+
+                for (size_t i = 0; i < m_packet_provider.get_queue_count(); i++) {
+                    const auto &queue = m_packet_provider.get_queue_stats(i);
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(queue.name.c_str());
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%llu", static_cast<unsigned long long>(queue.dropped.load()));
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%zu / %zu", queue.high_water.load(), queue.capacity);
+                }
+
+                ImGui::EndTable();
+            }
+
+            const auto &packets = m_packet_provider.get_received_packets();
+            ImGui::Text("Store: %zu frames, %.1f MB resident, %.1f MB spilled", packets.size(),
+                        packets.get_resident_bytes() / (1024.0 * 1024.0),
+                        packets.get_spilled_bytes() / (1024.0 * 1024.0));
+
+            const auto &recorder = m_packet_provider.get_recorder();
+            if (recorder.is_recording()) {
+                ImGui::Text("Recording: %llu frames, %llu dropped",
+                            static_cast<unsigned long long>(recorder.get_frames_written()),
+                            static_cast<unsigned long long>(recorder.get_dropped_count()));
+            }
+
+            ImGui::Text("Render: %.1f frames/s", ImGui::GetIO().Framerate);
+        }
+        ImGui::End();
+    }
+
     void gui::show_gauges() {
         ImGui::Begin("RPM");
         {
@@ -16,7 +16,14 @@
 #include "imgui_internal.h"
 
 #include "../can/packetprovider.hpp"
+#include "../can/packetfilter.hpp"
+#include "../can/searchindex.hpp"
+#include "../can/diffsearch.hpp"
 #include "../dbc.hpp"
+#include "../dbcbatch.hpp"
+#include "../dbcdatabase.hpp"
+#include "../dbcdecoder.hpp"
+#include "../dbcindex.hpp"
 #include "../config.hpp"
 #include "../cmd/commanddispatcher.hpp"
 
@@ -35,16 +42,26 @@ namespace canary::gui {
     struct search_options {
         int search_start = 0;
         int search_end = 0;
-        std::vector<std::tuple<std::string, std::string>> search_1_ids{};
-        std::vector<std::tuple<std::string, std::string>> search_2_ids{};
-        int search_num = 1;
+        std::vector<std::tuple<std::string, std::string>> value_results{};
+        // Find values was pressed, the results are filled in once the search index has caught up
+        bool find_pending = false;
+
+        canary::can::diffsearch diff_search;
+        // First packet of the segment being captured
+        size_t segment_start = 0;
+        int diff_segment = 0;
+        int diff_condition = 0;
     };
 
     struct packet_view_options {
         bool auto_scroll;
         bool paused;
         int selected_row;
-        std::pair<dbc_message, std::string> selected_frame;
+        std::pair<dbc_message, canary::can::frame> selected_frame;
+
+        // Indices of received packets that pass the filter, extended as new packets arrive so the table never has
+        // to look at rows that are off screen
+        canary::can::packetfilter::view rows;
     };
 
     struct dbc_options {
@@ -52,13 +69,24 @@ namespace canary::gui {
         int offset = 0;
     };
 
+    struct signal_view_options {
+        // dbcdatabase::make_key of the series shown, UINT64_MAX to follow the selected frame
+        uint64_t series = UINT64_MAX;
+    };
+
     struct state {
         std::unordered_map<std::string, bool> open_dialogs;
         std::vector<std::string> file_dialogs;
         dbc_options dbc_opt;
         packet_view_options packet_view_opts;
-        canary::dbcfile dbc_file;
-        bool packet_filter_enabled = true;
+        canary::dbcdatabase dbc_database;
+        canary::dbcindex dbc_index;
+        canary::dbcbatch dbc_batch;
+        signal_view_options signal_view_opts;
+        canary::can::packetfilter packet_filter;
+        canary::can::searchindex search_index;
+        // Packet provider epoch the views above were built for
+        uint64_t packets_epoch = 0;
         search_options search_opts;
         int speed = 0;
         int rpm = 0;
@@ -108,16 +136,31 @@ namespace canary::gui {
 
         void show_reset_window_pos_dlg();
 
+        // Opens a capture file, or imports a text capture from older versions (.dat)
+        void open_capture(const std::string &path);
+
+        void open_dbc(const std::string &path);
+
         void show_dbc_options_win();
 
         void show_file_dialogs();
 
         void show_frame_properties();
 
+        // Every signal of one message over the whole capture
+        void show_signals();
+
+        // Adds an entry to results for every ID carrying a value in the search range. The search index must be up to
+        // date.
+        void find_values(std::vector<std::tuple<std::string, std::string>> &results);
+
         void show_search();
 
         void show_filter();
 
+        // Per-stage throughput and latency, drops and buffer use
+        void show_statistics();
+
         void show_gauges();
 
         void show_tools();
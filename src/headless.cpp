@@ -0,0 +1,127 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "headless.hpp"
+#include "cmd/statscmd.hpp"
+
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace canary {
+    namespace {
+        volatile std::sig_atomic_t stop_requested = 0;
+        volatile std::sig_atomic_t stats_requested = 0;
+
+        extern "C" void handle_stop_signal(int) {
+            stop_requested = 1;
+        }
+
+#if !defined(WIN32)
+        extern "C" void handle_stats_signal(int) {
+            stats_requested = 1;
+        }
+#endif
+    }
+
+    int headless::run(int duration_s) {
+        stop_requested = 0;
+        stats_requested = 0;
+
+        auto prev_int = std::signal(SIGINT, handle_stop_signal);
+        auto prev_term = std::signal(SIGTERM, handle_stop_signal);
+#if !defined(WIN32)
+        auto prev_usr1 = std::signal(SIGUSR1, handle_stats_signal);
+#endif
+
+        m_start = std::chrono::steady_clock::now();
+        const auto deadline = m_start + std::chrono::seconds(duration_s);
+        const auto commands_interval = std::chrono::seconds(m_commands_interval_s);
+        auto next_commands = m_start + commands_interval;
+
+        std::cout << "Capturing without GUI, press Ctrl+C to stop" << std::endl;
+
+        while (!stop_requested) {
+            m_provider.poll();
+
+            if (stats_requested) {
+                stats_requested = 0;
+                print_stats(std::cout);
+                run_commands();
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (m_commands_interval_s > 0 && now >= next_commands) {
+                run_commands();
+                next_commands = now + commands_interval;
+            }
+
+            if (duration_s > 0 && now >= deadline) break;
+
+            if (m_capture.is_finished()) {
+                std::cout << "All sources finished" << std::endl;
+                break;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(POLL_INTERVAL_MS));
+        }
+
+        // Once more with everything captured
+        m_provider.poll();
+        run_commands();
+
+        std::signal(SIGINT, prev_int);
+        std::signal(SIGTERM, prev_term);
+#if !defined(WIN32)
+        std::signal(SIGUSR1, prev_usr1);
+#endif
+        return 0;
+    }
+
+    void headless::set_commands(command::command_dispatcher &dispatcher, std::vector<std::string> commands,
+                                int interval_s) {
+        m_dispatcher = &dispatcher;
+        m_commands = std::move(commands);
+        m_commands_interval_s = interval_s;
+    }
+
+    void headless::run_commands() {
+        if (!m_dispatcher || m_commands.empty()) return;
+
+        int res = 0;
+        for (const auto &cmd: m_commands) {
+            res = m_dispatcher->execute_command(cmd);
+            if (res != 0) {
+                break;
+            }
+        }
+
+        const auto &lines = m_dispatcher->get_command_line().get_lines();
+        for (; m_printed_lines < lines.size(); m_printed_lines++) {
+            std::cout << lines[m_printed_lines] << std::endl;
+        }
+        std::cout << "Commands executed with code: " << res << std::endl;
+    }
+
+    void headless::print_stats(std::ostream &out) const {
+        const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+        const auto &packets = m_provider.get_received_packets();
+
+        out << std::fixed << std::setprecision(1);
+        out << "Elapsed: " << elapsed << " s" << std::endl;
+        out << "Frames: " << packets.size() << " (" << (elapsed > 0 ? packets.size() / elapsed : 0.0) << " frames/s)"
+            << std::endl;
+
+        for (const auto &bus: m_capture.get_buses()) {
+            out << "    " << bus->name << ": " << bus->frame_count.load(std::memory_order_relaxed) << " frames"
+                << (bus->connected ? "" : " (disconnected)") << std::endl;
+        }
+
+        out << std::defaultfloat;
+
+        // Per-stage latency, drops, memory and recording, as the stats command shows them
+        for (const auto &line: command::stats_cmd::describe(m_provider)) {
+            out << line << std::endl;
+        }
+    }
+}
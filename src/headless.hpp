@@ -0,0 +1,58 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_HEADLESS__
+#define __CANARY_HEADLESS__
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "can/packetprovider.hpp"
+#include "can/capturemanager.hpp"
+#include "cmd/commanddispatcher.hpp"
+
+namespace canary {
+
+    // Capture loop for --nogui. Does the work the GUI's render loop would (draining the capture queues into the
+    // packet store and any recording) without touching GLFW or ImGui, so it runs on machines with no display.
+    // Runs until SIGINT/SIGTERM, the duration runs out or every source is a finished replay; SIGUSR1 prints
+    // statistics, runs any commands and carries on.
+    class headless {
+    public:
+        static constexpr int POLL_INTERVAL_MS = 10;
+
+        headless(can::packetprovider &provider, const can::capturemanager &capture) : m_provider(provider),
+                                                                                       m_capture(capture) {};
+
+        // Blocks until stopped, duration_s of 0 runs until interrupted. Returns 0 on success. The capture is still
+        // running when it returns; once it is stopped, packetprovider::flush() stores the last frames and the final
+        // statistics can be printed.
+        int run(int duration_s = 0);
+
+        void print_stats(std::ostream &out) const;
+
+        // Commands (e.g. from --cmds) to run against the live capture every interval_s seconds, on SIGUSR1 and once
+        // more before run() returns. With interval_s of 0 they only run on SIGUSR1 and at the end.
+        void set_commands(command::command_dispatcher &dispatcher, std::vector<std::string> commands,
+                          int interval_s = 0);
+
+    private:
+        can::packetprovider &m_provider;
+        const can::capturemanager &m_capture;
+
+        command::command_dispatcher *m_dispatcher{nullptr};
+        std::vector<std::string> m_commands;
+        int m_commands_interval_s{0};
+        // The dispatcher keeps every line it has output, these have been printed already
+        size_t m_printed_lines{0};
+
+        void run_commands();
+
+        std::chrono::steady_clock::time_point m_start{};
+    };
+
+}
+
+#endif
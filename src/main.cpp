@@ -4,17 +4,28 @@
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <condition_variable>
 #include <atomic>
 #include <thread>
 #include <cmath>
+#include <chrono>
+#include <ctime>
+#include <algorithm>
 
 #include "main.hpp"
 #include "config.hpp"
+#include "stringutils.hpp"
 #include "dbc.hpp"
 #include "gui/gui.hpp"
 #include "can/packetprovider.hpp"
+#include "can/socketcand.hpp"
+#include "can/socketcan.hpp"
+#include "can/capturemanager.hpp"
+#include "can/replay.hpp"
+#include "headless.hpp"
 #include "cmd/commanddispatcher.hpp"
 #include "cmd/helpcmd.hpp"
+#include "cmd/statscmd.hpp"
 
 #include <nlohmann/json.hpp>
 
@@ -36,15 +47,16 @@
 #define SOCKETCAND_IP "192.168.0.31"
 #define SOCKETCAND_INTERFACE "can0"
 
-std::vector<std::string> received_packets;
-std::mutex packets_mutex;
 std::atomic<bool> is_running(false);
 
-std::mutex exit_status_mutex;
-std::condition_variable exit_status;
+std::mutex listener_mutex;
+std::condition_variable listener_wakeup;
 
+// How often OBD speed/RPM requests are sent
+constexpr int OBD_REQUEST_INTERVAL_MS = 250;
 
-int speed = 0;
+
+std::atomic<int> speed = 0;
 
 bool paused(false);
 
@@ -84,129 +96,71 @@ void error(const std::string &msg) {
     is_running = false;
 }
 
-std::vector<std::string> split_string(std::string s, const std::string &delimiter) {
-    std::vector<std::string> res;
-    int pos = 0;
-    std::string part;
-    while ((pos = s.find(delimiter)) != std::string::npos) {
-        part = s.substr(0, pos);
-        res.push_back(part);
-        s.erase(0, pos + delimiter.length());
-    }
-    res.push_back(s);
-    return res;
+// Filled by the capture reader threads through lock-free queues, drained by the GUI once per frame
+canary::can::packetprovider provider;
+
+// One reader thread per bus, socketcand unless --socketcan is given or connections are configured
+canary::can::capturemanager capture(provider);
+
+canary::can::frame make_obd_request(uint8_t pid) {
+    canary::can::frame request{};
+    request.id = 0x7DF;
+    request.dlc = 8;
+    request.data[0] = 0x02;
+    request.data[1] = 0x01;
+    request.data[2] = pid;
+    return request;
 }
 
-canary::socketcand socketcand(SOCKETCAND_IP, SOCKETCAND_PORT, SOCKETCAND_INTERFACE);
+// Runs on the bus reader threads
+void handle_obd_response(const canary::can::frame &frame) {
+    if (frame.bus != 0 || frame.can_id() != 0x7E8 || frame.is_extended()) {
+        return;
+    }
 
-void listen_for_packets() {
-    char buffer[1024] = {0};
+    if (frame.data[2] == 0x0C) {
+        // RPM response
+        int firstValue = frame.data[3];
+        int secondValue = frame.data[4];
 
-    socketcand.set_error_handler([](const std::string &msg) {
-        std::cout << "Error: " << msg << std::endl;
-    });
+        //rpm = ((256 * firstValue) + secondValue) / 4;
+    }
 
-    int connect_res = socketcand.connect();
-    if (connect_res != 0) {
-        std::cout << "Error connecting to socketcand" << std::endl;
-        return;
+    if (frame.data[2] == 0x0D) {
+        // Speed response
+        speed = frame.data[3];
     }
+}
+
+// poll_obd is false without the GUI: nothing shows the gauges, and the requests would only put traffic on the vehicle
+// bus and into the recording
+void listen_for_packets(bool poll_obd) {
+    capture.set_error_handler([](const std::string &msg) {
+        std::cout << "Error: " << msg << std::endl;
+    });
+    if (poll_obd) capture.set_frame_observer(handle_obd_response);
 
-    std::cout << "Connected to socketcand" << std::endl;
+    capture.start();
+    std::cout << "Capturing from " << capture.get_buses().size() << " bus(es)" << std::endl;
 
     is_running = true;
-    int i = 0;
+
+    // Poll OBD speed/RPM on the first bus until shutdown
     bool flag = false;
+    std::unique_lock lk(listener_mutex);
     while (is_running && !paused) {
-        i++;
-        if (i % 200 == 0) {
-            if (flag) {
-                const char *pid_rpm_msg = "< send 7df 8 02 01 0c 00 00 00 00 00 >\n";
-                socketcand.send_when_ready(pid_rpm_msg, strlen(pid_rpm_msg));
-            } else {
-                const char *pid_speed_msg = "< send 7df 8 02 01 0d 00 00 00 00 00 >\n";
-                socketcand.send_when_ready(pid_speed_msg, strlen(pid_speed_msg));
-            }
+        if (poll_obd) {
+            capture.send_frame(0, make_obd_request(flag ? 0x0C : 0x0D));
             flag = !flag;
-
         }
 
-        bool read, write = false;
-        int activity = socketcand.select(false, read, write);
-        if (activity == 0) {
-            // No activity
-            continue;
-        }
-
-        if (!read) {
-            continue;
-        }
-
-        memset(buffer, 0, sizeof(buffer));
-        int n = socketcand.recv(buffer, sizeof(buffer) - 1);
-        if (n < 0) {
-            if (is_running) error("Error reading from socket");
-            break;
-        } else if (n == 0) {
-            std::cerr << "Connection closed by socketcand" << std::endl;
-            break;
-        } else {
-            // Split data with multiple packets
-            std::lock_guard<std::mutex> lock(packets_mutex);
-            auto partial_buffer = std::string(buffer);
-
-            size_t start = 0;
-            size_t end;
-            while ((end = partial_buffer.find('>', start)) != std::string::npos) {
-                std::string packet = partial_buffer.substr(start, end - start + 1);
-                received_packets.emplace_back(packet);
-                start = end + 1;
-
-//                if (received_packets.size() > 50) {
-//                    received_packets.erase(received_packets.begin());
-//                }
-
-                std::vector<std::string> parts = split_string(packet, std::string(" "));
-                if (parts.size() != 6) {
-                    // Probably < ok > or malformed packet, ignore
-                    continue;
-                }
-
-                if (parts[2] == "7E8") {
-                    if (parts[4].substr(4, 2) == "0C") {
-                        // RPM response
-                        auto input = parts[4].substr(6, 4);
-                        // std::cout << "Got RPM response: " << parts[4].substr(6, 4) << std::endl;
-
-                        std::string firstPart = input.substr(0, 2); // "0B"
-                        std::string secondPart = input.substr(2, 2); // "AB"
-
-                        int firstValue = std::stoi(firstPart, nullptr, 16);
-                        int secondValue = std::stoi(secondPart, nullptr, 16);
-
-                        //rpm = ((256 * firstValue) + secondValue) / 4;
-                    }
-
-                    if (parts[4].substr(4, 2) == "0D") {
-                        // Speed response
-                        auto input = parts[4].substr(6, 2);
-
-                        std::string firstPart = input.substr(0, 2); // "0B"
-
-                        int firstValue = std::stoi(firstPart, nullptr, 16);
-
-                        speed = firstValue;
-                    }
-                }
-
-
-            }
-        }
+        listener_wakeup.wait_for(lk, std::chrono::milliseconds(OBD_REQUEST_INTERVAL_MS), [] {
+            return !is_running;
+        });
     }
+    lk.unlock();
 
-    socketcand.close();
-
-    exit_status.notify_one();
+    capture.stop();
 }
 
 std::vector<bool> hexStringToBitArray(const std::string &hex) {
@@ -231,6 +185,19 @@ std::vector<bool> hexStringToBitArray(const std::string &hex) {
     return bitArray;
 }
 
+std::vector<bool> bytesToBitArray(const uint8_t *data, size_t len) {
+    std::vector<bool> bitArray;
+    bitArray.reserve(len * 8);
+
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 7; bit >= 0; --bit) {
+            bitArray.push_back((data[i] >> bit) & 1);
+        }
+    }
+
+    return bitArray;
+}
+
 uint16_t swap_endian_16(uint16_t value) {
     return (value >> 8) | (value << 8);
 }
@@ -270,6 +237,9 @@ uint16_t extractFromBoolVector(const std::vector<bool> &bitVector, size_t startI
 void register_commands(canary::command::command_dispatcher &cmd_dispatcher) {
     auto help = std::make_shared<canary::command::help_cmd>(cmd_dispatcher);
     cmd_dispatcher.register_command(help);
+
+    auto stats = std::make_shared<canary::command::stats_cmd>(provider);
+    cmd_dispatcher.register_command(stats);
 }
 
 int main(int argc, char **argv) {
@@ -279,6 +249,14 @@ int main(int argc, char **argv) {
     bool no_gui{false};
     std::vector<std::string> commands{};
     bool show_help{false};
+    std::string socketcan_interface{};
+    std::string record_path{};
+    bool record_set{false};
+    int duration{0};
+    int commands_interval{0};
+    std::string replay_path{};
+    double replay_speed{1.0};
+    bool replay_loop{false};
 
     if (argc > 1) {
         // Arguments specified
@@ -309,6 +287,21 @@ int main(int argc, char **argv) {
                 std::istringstream(arg_val) >> std::boolalpha >> no_gui;
             } else if (arg_name == "cmds") {
                 commands = split_string(arg_val, ";");
+            } else if (arg_name == "cmds-interval") {
+                std::istringstream(arg_val) >> commands_interval;
+            } else if (arg_name == "socketcan") {
+                socketcan_interface = arg_val;
+            } else if (arg_name == "record") {
+                record_path = arg_val;
+                record_set = true;
+            } else if (arg_name == "duration") {
+                std::istringstream(arg_val) >> duration;
+            } else if (arg_name == "replay") {
+                replay_path = arg_val;
+            } else if (arg_name == "speed") {
+                std::istringstream(arg_val) >> replay_speed;
+            } else if (arg_name == "loop") {
+                std::istringstream(arg_val) >> std::boolalpha >> replay_loop;
             } else {
                 std::cout << "Unrecognised option: " << arg_name << std::endl;
             }
@@ -318,15 +311,62 @@ int main(int argc, char **argv) {
     if (show_help) {
         std::cout << "CANary help" << std::endl << std::endl;
         std::cout << "--help\tShow this help message" << std::endl;
-        std::cout << "--nogui\tDon't render the GUI and don't start the connection loop" << std::endl;
-        std::cout << "--cmds\tSemicolon-separated list of commands to execute" << std::endl;
+        std::cout << "--nogui\tCapture without the GUI until Ctrl+C, recording to a capture file unless --record is "
+                     "given (--record= to not record). SIGUSR1 prints statistics" << std::endl;
+        std::cout << "--duration\tWith --nogui, stop after this many seconds" << std::endl;
+        std::cout << "--cmds\tSemicolon-separated list of commands to execute. With --nogui they run against the live "
+                     "capture on SIGUSR1, every --cmds-interval seconds and when it stops" << std::endl;
+        std::cout << "--cmds-interval\tWith --nogui, run --cmds every this many seconds" << std::endl;
+        std::cout << "--socketcan\tCapture from a local SocketCAN interface (e.g. vcan0) instead of the configured "
+                     "connections" << std::endl;
+        std::cout << "--replay\tPlay back a capture file instead of the configured connections" << std::endl;
+        std::cout << "--speed\tReplay speed, e.g. 0.5, 2 or 10. 0 replays as fast as possible" << std::endl;
+        std::cout << "--loop\tRestart the replay from the beginning when it reaches the end" << std::endl;
+        std::cout << "--record\tStream all captured frames to a compressed capture file" << std::endl;
         return 0;
     }
 
-    std::thread listener_thread(listen_for_packets);
-
-    if (!glfwInit())
+    if (!replay_path.empty()) {
+        capture.add_bus(replay_path, std::make_unique<canary::can::replay>(replay_path, replay_speed, replay_loop));
+    } else if (!socketcan_interface.empty()) {
+#if defined(__linux__)
+        capture.add_bus(socketcan_interface, std::make_unique<canary::can::socketcan>(socketcan_interface));
+#else
+        std::cout << "SocketCAN is only supported on Linux" << std::endl;
         return 1;
+#endif
+    } else if (capture.add_connections(APP_CONFIG.connections) == 0) {
+        // No connections configured, fall back to the development socketcand device
+        capture.add_bus("socketcand", std::make_unique<canary::can::socketcand>(SOCKETCAND_IP, SOCKETCAND_PORT,
+                                                                                 SOCKETCAND_INTERFACE));
+    }
+
+    provider.set_memory_budget(static_cast<size_t>(std::max(APP_CONFIG.conn_opts.memory_budget_mb, 0)) * 1024 * 1024,
+                               [](const std::string &msg) {
+                                   std::cout << "Error: " << msg << std::endl;
+                               });
+
+    if (no_gui && !record_set) {
+        // Headless capture is only useful if it ends up on disk
+        char default_path[64];
+        auto now = std::time(nullptr);
+        std::strftime(default_path, sizeof(default_path), "recording-%Y%m%d-%H%M%S.canary", std::localtime(&now));
+        record_path = default_path;
+    }
+
+    if (!record_path.empty()) {
+        std::cout << "Recording to " << record_path << std::endl;
+        provider.start_recording(record_path, true, [](const std::string &msg) {
+            std::cout << "Error: " << msg << std::endl;
+        });
+    }
+
+    std::thread listener_thread(listen_for_packets, !no_gui);
+
+    GLFWwindow *win = nullptr;
+    if (!no_gui) {
+        if (!glfwInit())
+            return 1;
 
         glfwWindowHint(GLFW_SAMPLES, 4);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -359,35 +399,40 @@ int main(int argc, char **argv) {
 
     std::unique_ptr<const canary::config::connection> current_connection;
 
-    canary::can::packetprovider provider;
     canary::command::command_dispatcher cmd_dispatcher;
 
     register_commands(cmd_dispatcher);
 
-    int res = 0;
-    for (const auto &cmd: commands) {
-        res = cmd_dispatcher.execute_command(cmd);
-        if (res != 0) {
-            break;
+    if (!no_gui) {
+        // Headless runs them itself, once the capture has something in it
+        int res = 0;
+        for (const auto &cmd: commands) {
+            res = cmd_dispatcher.execute_command(cmd);
+            if (res != 0) {
+                break;
+            }
         }
-    }
 
-    for (const auto &line: cmd_dispatcher.get_command_line().get_lines()) {
-        std::cout << line << std::endl;
-    }
+        for (const auto &line: cmd_dispatcher.get_command_line().get_lines()) {
+            std::cout << line << std::endl;
+        }
 
-    std::cout << "Commands executed with code: " << res << std::endl;
+        std::cout << "Commands executed with code: " << res << std::endl;
+    }
 
     std::shared_ptr<canary::gui::gui> gui = nullptr;
-    if (!no_gui) {
+    std::unique_ptr<canary::headless> headless = nullptr;
+    if (no_gui) {
+        headless = std::make_unique<canary::headless>(provider, capture);
+        headless->set_commands(cmd_dispatcher, commands, commands_interval);
+        headless->run(duration);
+    } else {
         gui = std::make_shared<canary::gui::gui>(win, provider, cmd_dispatcher);
         gui->load_options();
         auto scale = canary::gui::gui::get_monitor_scale();
         ImGuiIO &io = ImGui::GetIO();
         gui->set_scale(io, 13.0f, scale);
 
-        provider.add_packet("Test");
-
         while (!glfwWindowShouldClose(win)) {
             ImGui_ImplOpenGL3_NewFrame();
             ImGui_ImplGlfw_NewFrame();
@@ -402,26 +447,28 @@ int main(int argc, char **argv) {
             ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
             glfwSwapBuffers(win);
+            provider.mark_rendered();
             glfwPollEvents();
         }
     }
 
-    // Force close if still in connection phase
-    if (!socketcand.m_connected) {
-        socketcand.close();
-    }
-
-    if (is_running) {
-        is_running = false;
-        std::cout << "Waiting for listener thread to quit..." << std::endl;
-        {
-            std::unique_lock lk(exit_status_mutex);
-            exit_status.wait(lk);
-        }
-        std::cout << "Listener thread terminated" << std::endl;
+    bool was_running;
+    {
+        std::lock_guard lk(listener_mutex);
+        was_running = is_running.exchange(false);
     }
+    listener_wakeup.notify_all();
 
+    if (was_running) std::cout << "Waiting for listener thread to quit..." << std::endl;
     listener_thread.join();
+    if (was_running) std::cout << "Listener thread terminated" << std::endl;
+
+    // The readers have stopped, so whatever is still in the queues or held back for reordering can be stored and
+    // recorded before the file is closed
+    provider.flush();
+    provider.stop_recording();
+
+    if (headless) headless->print_stats(std::cout);
 
     if (!no_gui) {
         ImGui_ImplOpenGL3_Shutdown();
@@ -19,12 +19,12 @@ void draw_gauge(const char *label, float value, float min_value, float max_value
 
 void error(const std::string &msg);
 
-std::vector<std::string> split_string(std::string s, const std::string &delimiter);
-
-void listen_for_packets();
+void listen_for_packets(bool poll_obd);
 
 std::vector<bool> hexStringToBitArray(const std::string &hex);
 
+std::vector<bool> bytesToBitArray(const uint8_t *data, size_t len);
+
 uint8_t extractFromBoolVectorInt(const std::vector<bool> &bitVector, size_t startIndex);
 
 uint16_t extractFromBoolVector(const std::vector<bool> &bitVector, size_t startIndex);
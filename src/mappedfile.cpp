@@ -0,0 +1,89 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "mappedfile.hpp"
+
+#if defined(WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace canary {
+    mapped_file::~mapped_file() {
+        close();
+    }
+
+    int mapped_file::open(const std::string &path, bool sequential) {
+        close();
+
+#if defined(WIN32)
+        DWORD flags = FILE_ATTRIBUTE_NORMAL | (sequential ? FILE_FLAG_SEQUENTIAL_SCAN : 0);
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return 1;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+            CloseHandle(file);
+            return 1;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(file);
+            return 1;
+        }
+
+        void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data) {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return 1;
+        }
+
+        m_file_handle = file;
+        m_mapping_handle = mapping;
+        m_data = static_cast<const uint8_t *>(data);
+        m_size = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 1;
+
+        struct stat st{};
+        if (fstat(fd, &st) < 0 || st.st_size == 0) {
+            ::close(fd);
+            return 1;
+        }
+
+        void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) return 1;
+
+        if (sequential) {
+            madvise(data, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+        }
+
+        m_data = static_cast<const uint8_t *>(data);
+        m_size = static_cast<size_t>(st.st_size);
+#endif
+        return 0;
+    }
+
+    void mapped_file::close() {
+        if (!m_data) return;
+#if defined(WIN32)
+        UnmapViewOfFile(m_data);
+        CloseHandle(static_cast<HANDLE>(m_mapping_handle));
+        CloseHandle(static_cast<HANDLE>(m_file_handle));
+        m_mapping_handle = nullptr;
+        m_file_handle = nullptr;
+#else
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_size = 0;
+    }
+}
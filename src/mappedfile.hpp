@@ -0,0 +1,47 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_MAPPEDFILE__
+#define __CANARY_MAPPEDFILE__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace canary {
+
+    // Read-only memory mapping of a whole file. Pages are loaded by the OS as they are touched, so opening is cheap
+    // regardless of the file size.
+    class mapped_file {
+    public:
+        mapped_file() = default;
+
+        ~mapped_file();
+
+        mapped_file(const mapped_file &) = delete;
+
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        // Returns 0 on success. Empty files cannot be mapped and fail. sequential hints that the file will be read
+        // from start to end so the OS can read ahead further.
+        int open(const std::string &path, bool sequential = false);
+
+        void close();
+
+        [[nodiscard]] inline const uint8_t *get_data() const { return m_data; }
+
+        [[nodiscard]] inline size_t get_size() const { return m_size; }
+
+        [[nodiscard]] inline bool is_open() const { return m_data != nullptr; }
+
+    private:
+        const uint8_t *m_data{nullptr};
+        size_t m_size{0};
+#if defined(WIN32)
+        void *m_file_handle{nullptr};
+        void *m_mapping_handle{nullptr};
+#endif
+    };
+
+}
+
+#endif
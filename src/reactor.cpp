@@ -0,0 +1,117 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "reactor.hpp"
+
+#if defined(__linux__)
+
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace canary {
+    namespace {
+        constexpr int MAX_EVENTS = 64;
+    }
+
+    reactor::reactor() {
+        m_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        m_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+        if (m_epoll_fd >= 0 && m_event_fd >= 0) {
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = m_event_fd;
+            epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &ev);
+        }
+    }
+
+    reactor::~reactor() {
+        if (m_event_fd >= 0) ::close(m_event_fd);
+        if (m_epoll_fd >= 0) ::close(m_epoll_fd);
+    }
+
+    uint32_t reactor::to_epoll_events(uint32_t events) {
+        uint32_t epoll_events = EPOLLET | EPOLLRDHUP;
+        if (events & READABLE) epoll_events |= EPOLLIN;
+        if (events & WRITABLE) epoll_events |= EPOLLOUT;
+        return epoll_events;
+    }
+
+    int reactor::add(int fd, uint32_t events, callback cb) {
+        struct epoll_event ev{};
+        ev.events = to_epoll_events(events);
+        ev.data.fd = fd;
+        if (epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            return 1;
+        }
+
+        m_handlers[fd] = std::make_shared<callback>(std::move(cb));
+        return 0;
+    }
+
+    int reactor::modify(int fd, uint32_t events) {
+        struct epoll_event ev{};
+        ev.events = to_epoll_events(events);
+        ev.data.fd = fd;
+        return epoll_ctl(m_epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0 ? 1 : 0;
+    }
+
+    int reactor::remove(int fd) {
+        m_handlers.erase(fd);
+        return epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr) < 0 ? 1 : 0;
+    }
+
+    int reactor::run_once(int timeout_ms) {
+        if (is_stopped()) return -1;
+
+        struct epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(m_epoll_fd, events, MAX_EVENTS, timeout_ms);
+        if (n < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+
+        int dispatched = 0;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+
+            if (fd == m_event_fd) {
+                uint64_t value;
+                while (::read(m_event_fd, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+
+            auto it = m_handlers.find(fd);
+            if (it == m_handlers.end()) continue;
+
+            uint32_t ready = 0;
+            if (events[i].events & EPOLLIN) ready |= READABLE;
+            if (events[i].events & EPOLLOUT) ready |= WRITABLE;
+            if (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) ready |= CLOSED;
+
+            // Keep the handler alive in case it removes itself
+            auto handler = it->second;
+            (*handler)(ready);
+            dispatched++;
+        }
+
+        return is_stopped() ? -1 : dispatched;
+    }
+
+    void reactor::run() {
+        while (run_once() >= 0) {}
+    }
+
+    void reactor::stop() {
+        m_stopped.store(true, std::memory_order_release);
+        wake();
+    }
+
+    void reactor::wake() {
+        uint64_t value = 1;
+        [[maybe_unused]] auto res = ::write(m_event_fd, &value, sizeof(value));
+    }
+}
+
+#endif
@@ -0,0 +1,75 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_REACTOR__
+#define __CANARY_REACTOR__
+
+#if defined(__linux__)
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+namespace canary {
+
+    // Edge-triggered epoll event loop. Any number of file descriptors can be watched from one thread; callbacks are
+    // invoked as soon as a descriptor becomes ready, and must read/write until the call would block because the same
+    // edge is not reported twice. stop() and wake() are safe to call from other threads and interrupt a blocked wait
+    // immediately through an eventfd.
+    class reactor {
+    public:
+        static constexpr uint32_t READABLE = 0x1;
+        static constexpr uint32_t WRITABLE = 0x2;
+        // Error or hang-up, always reported
+        static constexpr uint32_t CLOSED = 0x4;
+
+        using callback = std::function<void(uint32_t events)>;
+
+        reactor();
+
+        ~reactor();
+
+        reactor(const reactor &) = delete;
+
+        reactor &operator=(const reactor &) = delete;
+
+        // Returns 0 on success
+        int add(int fd, uint32_t events, callback cb);
+
+        int modify(int fd, uint32_t events);
+
+        int remove(int fd);
+
+        // Waits up to timeout_ms (-1 for no limit) and dispatches ready callbacks. Returns the number of callbacks
+        // run, or -1 on error or once stopped.
+        int run_once(int timeout_ms = -1);
+
+        // Dispatches callbacks until stop() is called
+        void run();
+
+        void stop();
+
+        // Interrupts the current wait without stopping
+        void wake();
+
+        [[nodiscard]] inline bool is_stopped() const { return m_stopped.load(std::memory_order_acquire); }
+
+        [[nodiscard]] inline bool is_valid() const { return m_epoll_fd >= 0 && m_event_fd >= 0; }
+
+    private:
+        int m_epoll_fd{-1};
+        int m_event_fd{-1};
+        std::atomic<bool> m_stopped{false};
+
+        // shared_ptr so a callback can remove itself while it is running
+        std::unordered_map<int, std::shared_ptr<callback>> m_handlers;
+
+        static uint32_t to_epoll_events(uint32_t events);
+    };
+
+}
+
+#endif
+
+#endif
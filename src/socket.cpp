@@ -16,6 +16,8 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <cerrno>
 #endif
 
 #include "config.hpp"
@@ -119,64 +121,64 @@ namespace canary {
         return n;
     }
 
-    int socket::recv_when_ready(char *buf, int len, int cooldown) {
-        if (cooldown == -1) {
-            cooldown = APP_CONFIG.conn_opts.cooldown;
-        }
-
+    int socket::recv_when_ready(char *buf, int len, int timeout_ms) {
+        // Blocks in select until readable, so data is picked up as soon as it arrives
         bool read = false, write = false;
-        while (!read) {
-            select(false, read, write);
-
-            int optval;
-            int optlen = sizeof(optval);
-            if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, (char *) &optval, &optlen) < 0) {
-                if (m_error_handler) m_error_handler(std::format("recv_when_ready: getsockopt failed with error: {}", WSAGetLastError()));
-                return false;
-            }
-            if (optval != 0) {
-                // Connection failed
-                if (m_error_handler) m_error_handler(std::format("recv_when_ready: Connect failed with error: {}", optval));
-                return false;
-            }
-
-            if (read) {
-                break;
-            }
+        int activity = select(false, read, write, timeout_ms);
+        if (activity < 0) {
+            return activity;
+        }
+        if (activity == 0 || !read) {
+            if (m_error_handler) m_error_handler("recv_when_ready: Timed out waiting for data");
+            return -1;
+        }
 
+        int optval = 0;
 #if defined(WIN32)
-            Sleep(cooldown);
+        int optlen = sizeof(optval);
+        if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, (char *) &optval, &optlen) < 0) {
+            if (m_error_handler) m_error_handler(std::format("recv_when_ready: getsockopt failed with error: {}", WSAGetLastError()));
+            return -1;
+        }
 #else
-            usleep(cooldown * 1000);
+        socklen_t optlen = sizeof(optval);
+        if (getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0) {
+            if (m_error_handler) m_error_handler(std::format("recv_when_ready: getsockopt failed with error: {}", errno));
+            return -1;
+        }
 #endif
+        if (optval != 0) {
+            // Connection failed
+            if (m_error_handler) m_error_handler(std::format("recv_when_ready: Connect failed with error: {}", optval));
+            return -1;
         }
 
         return recv(buf, len);
     }
 
-    int socket::send_when_ready(const char *buf, int len, int cooldown) {
-        if (cooldown == -1) {
-            cooldown = APP_CONFIG.conn_opts.cooldown;
-        }
-
+    int socket::send_when_ready(const char *buf, int len, int timeout_ms) {
         bool read = false, write = false;
-        while (!write) {
-            select(true, read, write);
-            if (write) {
-                break;
-            }
-
-#if defined(WIN32)
-            Sleep(cooldown);
-#else
-            usleep(cooldown * 1000);
-#endif
+        int activity = select(true, read, write, timeout_ms);
+        if (activity < 0) {
+            return activity;
+        }
+        if (activity == 0 || !write) {
+            if (m_error_handler) m_error_handler("send_when_ready: Timed out waiting for socket to be writable");
+            return -1;
         }
 
         return send(buf, len);
     }
 
-    int socket::select(bool want_write, bool &read, bool &write) {
+    int socket::select(bool want_write, bool &read, bool &write, int timeout_ms) {
+        if (timeout_ms < 0) {
+            timeout_ms = APP_CONFIG.conn_opts.timeout * 1000;
+        }
+
+        read = false;
+        write = false;
+
+#if defined(WIN32)
         fd_set read_fds, write_fds;
         FD_ZERO(&read_fds);
         FD_ZERO(&write_fds);
@@ -185,8 +187,8 @@ namespace canary {
         if (want_write) FD_SET(m_fd, &write_fds);
 
         struct timeval timeout;
-        timeout.tv_sec = APP_CONFIG.conn_opts.timeout;
-        timeout.tv_usec = 0;
+        timeout.tv_sec = timeout_ms / 1000;
+        timeout.tv_usec = (timeout_ms % 1000) * 1000;
 
         int activity = ::select(m_fd + 1, &read_fds, &write_fds, nullptr, &timeout);
         if (activity < 0) {
@@ -199,17 +201,32 @@ namespace canary {
             return activity;
         }
 
-        read = false;
-        write = false;
+        read = FD_ISSET(m_fd, &read_fds);
+        write = FD_ISSET(m_fd, &write_fds);
+#else
+        // poll rather than select, which cannot handle descriptors above FD_SETSIZE
+        struct pollfd pfd{m_fd, static_cast<short>(POLLIN | (want_write ? POLLOUT : 0)), 0};
+
+        int activity;
+        do {
+            activity = ::poll(&pfd, 1, timeout_ms);
+        } while (activity < 0 && errno == EINTR);
 
-        if (FD_ISSET(m_fd, &read_fds)) {
-            read = true;
+        if (activity < 0) {
+            if (m_error_handler) m_error_handler("select: Error in poll");
+            return activity;
         }
 
-        if (FD_ISSET(m_fd, &write_fds)) {
-            write = true;
+        if (activity == 0) {
+            // No activity detected
+            return activity;
         }
 
+        // Errors and hang-ups are reported as readable so the following recv picks them up
+        read = (pfd.revents & (POLLIN | POLLERR | POLLHUP)) != 0;
+        write = (pfd.revents & POLLOUT) != 0;
+#endif
+
         return 1;
     }
 
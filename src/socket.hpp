@@ -29,11 +29,16 @@ namespace canary {
         // Should use send_when_ready
         int send(const char *buf, int len);
 
-        int recv_when_ready(char *buf, int len, int cooldown = -1);
+        // Wait (without polling) until the socket is ready, then receive/send. A timeout of -1 uses the configured
+        // connection timeout.
+        int recv_when_ready(char *buf, int len, int timeout_ms = -1);
 
-        int send_when_ready(const char *buf, int len, int cooldown = -1);
+        int send_when_ready(const char *buf, int len, int timeout_ms = -1);
 
-        int select(bool want_write, bool &read, bool &write);
+        // Timeout of -1 uses the configured connection timeout
+        int select(bool want_write, bool &read, bool &write, int timeout_ms = -1);
+
+        [[nodiscard]] inline int get_fd() const { return m_fd; }
 
         void close();
 
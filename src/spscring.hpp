@@ -0,0 +1,122 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_SPSCRING__
+#define __CANARY_SPSCRING__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <algorithm>
+
+namespace canary {
+
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    // Lock-free single-producer/single-consumer ring buffer. Exactly one thread may call the producer functions
+    // (push, push_batch) and exactly one other thread the consumer functions (drain, pop_batch). Neither side ever
+    // blocks; push fails when the ring is full.
+    template<typename T>
+    class spsc_ring {
+    public:
+        // Capacity is rounded up to the next power of two
+        explicit spsc_ring(size_t capacity) : m_capacity(round_up_pow2(capacity)), m_mask(m_capacity - 1),
+                                              m_buffer(std::make_unique<T[]>(m_capacity)) {}
+
+        spsc_ring(const spsc_ring &) = delete;
+
+        spsc_ring &operator=(const spsc_ring &) = delete;
+
+        // Producer: returns false if the ring is full
+        bool push(const T &item) {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head_cache >= m_capacity) {
+                m_head_cache = m_head.load(std::memory_order_acquire);
+                if (tail - m_head_cache >= m_capacity) {
+                    return false;
+                }
+            }
+
+            m_buffer[tail & m_mask] = item;
+            m_tail.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Producer: pushes as many items as fit, returns the number pushed
+        size_t push_batch(const T *items, size_t count) {
+            const size_t tail = m_tail.load(std::memory_order_relaxed);
+            size_t free = m_capacity - (tail - m_head_cache);
+            if (free < count) {
+                m_head_cache = m_head.load(std::memory_order_acquire);
+                free = m_capacity - (tail - m_head_cache);
+            }
+
+            const size_t n = std::min(free, count);
+            const size_t first = std::min(n, m_capacity - (tail & m_mask));
+            std::copy_n(items, first, &m_buffer[tail & m_mask]);
+            std::copy_n(items + first, n - first, &m_buffer[0]);
+
+            m_tail.store(tail + n, std::memory_order_release);
+            return n;
+        }
+
+        // Consumer: passes every available item to fn as at most two contiguous spans, then releases them.
+        // Returns the number of items drained.
+        template<typename F>
+        size_t drain(F &&fn, size_t max = SIZE_MAX) {
+            const size_t head = m_head.load(std::memory_order_relaxed);
+            m_tail_cache = m_tail.load(std::memory_order_acquire);
+
+            const size_t n = std::min(m_tail_cache - head, max);
+            if (n == 0) return 0;
+
+            const size_t first = std::min(n, m_capacity - (head & m_mask));
+            fn(std::span<const T>(&m_buffer[head & m_mask], first));
+            if (n > first) {
+                fn(std::span<const T>(&m_buffer[0], n - first));
+            }
+
+            m_head.store(head + n, std::memory_order_release);
+            return n;
+        }
+
+        // Consumer: copies up to max items into out, returns the number copied
+        size_t pop_batch(T *out, size_t max) {
+            return drain([&out](std::span<const T> items) {
+                out = std::copy(items.begin(), items.end(), out);
+            }, max);
+        }
+
+        // Approximate number of queued items, exact only when called from the producer or consumer thread
+        [[nodiscard]] size_t size() const {
+            return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] size_t capacity() const {
+            return m_capacity;
+        }
+
+    private:
+        static size_t round_up_pow2(size_t n) {
+            size_t p = 1;
+            while (p < n) p <<= 1;
+            return p;
+        }
+
+        const size_t m_capacity;
+        const size_t m_mask;
+        std::unique_ptr<T[]> m_buffer;
+
+        // Consumer owned, kept on separate cache lines from the producer's fields to avoid false sharing
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head{0};
+        size_t m_tail_cache{0};
+
+        // Producer owned
+        alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail{0};
+        size_t m_head_cache{0};
+    };
+
+}
+
+#endif
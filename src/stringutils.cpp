@@ -0,0 +1,16 @@
+// Copyright (C) 2024 Ryan Bester
+
+#include "stringutils.hpp"
+
+std::vector<std::string> split_string(std::string s, const std::string &delimiter) {
+    std::vector<std::string> res;
+    int pos = 0;
+    std::string part;
+    while ((pos = s.find(delimiter)) != std::string::npos) {
+        part = s.substr(0, pos);
+        res.push_back(part);
+        s.erase(0, pos + delimiter.length());
+    }
+    res.push_back(s);
+    return res;
+}
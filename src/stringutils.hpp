@@ -0,0 +1,11 @@
+// Copyright (C) 2024 Ryan Bester
+
+#ifndef __CANARY_STRINGUTILS__
+#define __CANARY_STRINGUTILS__
+
+#include <string>
+#include <vector>
+
+std::vector<std::string> split_string(std::string s, const std::string &delimiter);
+
+#endif
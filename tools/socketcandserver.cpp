@@ -0,0 +1,434 @@
+// Copyright (C) 2024 Ryan Bester
+
+// Stand-in for a socketcand server, so canary::socketcand can be tested and load tested on localhost without a CAN
+// device. Speaks the rawmode subset of the protocol CANary uses: "< hi >" on connect, "< open bus >" and "< rawmode >"
+// are acknowledged with "< ok >", then "< frame ... >" packets are streamed at the requested rate. "< send ... >"
+// packets from the client are counted and can be echoed back as received frames.
+//
+// Synthetic frames carry a per-connection sequence number in the first 4 payload bytes (little endian), and every
+// frame is stamped with the time it was sent, so the client can work out drops and end-to-end latency.
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "can/frame.hpp"
+#include "can/capturefile.hpp"
+
+namespace {
+    constexpr int DEFAULT_PORT = 29536;
+    // Frames are sent in bursts on this tick, as many as are due at the requested rate
+    constexpr int TICK_MS = 1;
+    // Frames per burst when sending as fast as possible
+    constexpr int MAX_BURST = 256;
+    // Most frames sent in one tick when a slow client has fallen behind the rate
+    constexpr uint64_t MAX_CATCH_UP = 65536;
+    constexpr int HANDSHAKE_TIMEOUT_MS = 5000;
+
+    struct options {
+        int port{DEFAULT_PORT};
+        std::string interface{"can0"};
+        // Frames per second per connection, 0 for as fast as possible
+        int rate{10000};
+        // Distinct synthetic IDs, starting at 0x100
+        int ids{64};
+        // Replay IDs and payloads from a capture file instead of synthetic frames
+        std::string replay_path{};
+        // Send received "< send >" frames back to the client
+        bool echo{false};
+        // Seconds, 0 to run until interrupted
+        int duration{0};
+    };
+
+    std::atomic<bool> running{true};
+
+    std::atomic<uint64_t> total_sent{0};
+    std::atomic<uint64_t> total_received{0};
+    std::atomic<int> active_clients{0};
+
+    extern "C" void handle_signal(int) {
+        running = false;
+    }
+
+    uint64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // A client that stops reading must not keep its session from seeing running go false
+    constexpr int SEND_POLL_MS = 100;
+
+    // Waits for the socket to take more rather than blocking in send(), false once stopped or the client is gone
+    bool send_all(int fd, const char *buf, size_t len) {
+        while (len > 0) {
+            struct pollfd pfd{fd, POLLOUT, 0};
+            int ready = poll(&pfd, 1, SEND_POLL_MS);
+            if (!running) return false;
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready < 0 || (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) return false;
+            if (ready == 0) continue;
+
+            ssize_t n = ::send(fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) continue;
+            if (n <= 0) return false;
+            buf += n;
+            len -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool send_str(int fd, std::string_view s) {
+        return send_all(fd, s.data(), s.size());
+    }
+
+    // Appends "< frame ID SEC.USEC DATA >\n"
+    void append_frame(std::string &out, const canary::can::frame &f) {
+        char id[9], ts[32], data[2 * canary::can::FRAME_MAX_DATA + 1];
+        canary::can::format_can_id(f, id);
+        canary::can::format_timestamp(f, ts);
+        canary::can::format_data(f, data);
+
+        out += "< frame ";
+        out += id;
+        out += ' ';
+        out += ts;
+        out += ' ';
+        out += data;
+        out += " >\n";
+    }
+
+    // Parses "< send ID DLC b0 b1 ... >" into a frame
+    bool parse_send(std::string_view packet, canary::can::frame &f) {
+        std::istringstream in{std::string(packet)};
+        std::string open, cmd, id;
+        unsigned dlc;
+        if (!(in >> open >> cmd >> id >> dlc) || cmd != "send" || dlc > canary::can::FRAME_MAX_DATA) return false;
+
+        char *id_end;
+        f = {};
+        f.id = static_cast<uint32_t>(std::strtoul(id.c_str(), &id_end, 16));
+        if (*id_end != '\0') return false;
+        if (id.size() > 3) f.id |= canary::can::FRAME_EXTENDED_FLAG;
+        f.dlc = static_cast<uint8_t>(dlc);
+        for (unsigned i = 0; i < dlc; i++) {
+            unsigned byte;
+            if (!(in >> std::hex >> byte)) return false;
+            f.data[i] = static_cast<uint8_t>(byte);
+        }
+        return true;
+    }
+
+    class session {
+    public:
+        session(int fd, const options &opts, const canary::can::capturefile *replay) : m_fd(fd), m_opts(opts),
+                                                                                       m_replay(replay) {};
+
+        ~session() {
+            ::close(m_fd);
+        }
+
+        void run() {
+            active_clients++;
+            if (handshake()) {
+                stream();
+            }
+            active_clients--;
+
+            std::cout << "Client disconnected after " << m_sent << " frames sent, " << m_received << " received"
+                      << std::endl;
+        }
+
+    private:
+        int m_fd;
+        const options &m_opts;
+        const canary::can::capturefile *m_replay;
+
+        std::string m_in;
+        uint64_t m_sequence{0};
+        uint64_t m_sent{0};
+        uint64_t m_received{0};
+
+        // Reads whatever is waiting, false if the client went away
+        bool read_input(int timeout_ms) {
+            struct pollfd pfd{m_fd, POLLIN, 0};
+            int n = poll(&pfd, 1, timeout_ms);
+            if (n < 0) return errno == EINTR;
+            if (n == 0) return true;
+
+            char buf[4096];
+            ssize_t len = ::recv(m_fd, buf, sizeof(buf), 0);
+            if (len <= 0) return false;
+            m_in.append(buf, static_cast<size_t>(len));
+            return true;
+        }
+
+        // Takes the next complete "< ... >" packet from the input, false if there is none yet
+        bool next_packet(std::string &packet) {
+            auto start = m_in.find('<');
+            if (start == std::string::npos) {
+                m_in.clear();
+                return false;
+            }
+            auto end = m_in.find('>', start);
+            if (end == std::string::npos) return false;
+
+            packet = m_in.substr(start, end - start + 1);
+            m_in.erase(0, end + 1);
+            return true;
+        }
+
+        // Waits for a packet starting with prefix, false on timeout or disconnect
+        bool expect(std::string_view prefix, std::string &packet) {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HANDSHAKE_TIMEOUT_MS);
+            while (running && std::chrono::steady_clock::now() < deadline) {
+                while (next_packet(packet)) {
+                    if (packet.starts_with(prefix)) return true;
+                    std::cout << "Unexpected packet during handshake: " << packet << std::endl;
+                }
+                if (!read_input(100)) return false;
+            }
+            return false;
+        }
+
+        bool handshake() {
+            if (!send_str(m_fd, "< hi >")) return false;
+
+            std::string packet;
+            if (!expect("< open ", packet)) return false;
+            if (packet != "< open " + m_opts.interface + " >") {
+                send_str(m_fd, "< error could not open bus >");
+                std::cout << "Client asked for an unknown bus: " << packet << std::endl;
+                return false;
+            }
+            if (!send_str(m_fd, "< ok >")) return false;
+
+            if (!expect("< rawmode", packet)) return false;
+            return send_str(m_fd, "< ok >");
+        }
+
+        canary::can::frame next_frame() {
+            canary::can::frame f{};
+            if (m_replay && m_replay->size() > 0) {
+                f = (*m_replay)[m_sequence % m_replay->size()];
+                f.bus = 0;
+            } else {
+                const auto n = static_cast<uint32_t>(std::max(m_opts.ids, 1));
+                f.id = 0x100 + static_cast<uint32_t>(m_sequence % n);
+                f.dlc = 8;
+                const auto seq = static_cast<uint32_t>(m_sequence);
+                std::memcpy(f.data, &seq, sizeof(seq));
+                // Slowly changing per-ID values, so there is something to search for
+                f.data[4] = static_cast<uint8_t>(m_sequence / n);
+                f.data[5] = static_cast<uint8_t>(m_sequence / n / 256);
+                f.data[6] = static_cast<uint8_t>(f.id);
+                f.data[7] = 0xAA;
+            }
+            m_sequence++;
+            return f;
+        }
+
+        bool handle_input(std::string &out) {
+            std::string packet;
+            while (next_packet(packet)) {
+                canary::can::frame f{};
+                if (!parse_send(packet, f)) continue;
+
+                m_received++;
+                total_received.fetch_add(1, std::memory_order_relaxed);
+                if (m_opts.echo) {
+                    f.timestamp = now_ns();
+                    append_frame(out, f);
+                }
+            }
+            return true;
+        }
+
+        void stream() {
+            const auto start = std::chrono::steady_clock::now();
+            std::string out;
+            out.reserve(MAX_BURST * 64);
+
+            while (running) {
+                out.clear();
+                if (!read_input(m_opts.rate > 0 ? TICK_MS : 0) || !handle_input(out)) return;
+
+                uint64_t due = MAX_BURST;
+                if (m_opts.rate > 0) {
+                    const double elapsed = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start).count();
+                    const auto target = static_cast<uint64_t>(elapsed * m_opts.rate);
+                    due = std::min(target > m_sent ? target - m_sent : 0, MAX_CATCH_UP);
+                }
+
+                const uint64_t timestamp = now_ns();
+                for (uint64_t i = 0; i < due; i++) {
+                    auto f = next_frame();
+                    f.timestamp = timestamp;
+                    append_frame(out, f);
+                }
+
+                if (!out.empty() && !send_all(m_fd, out.data(), out.size())) return;
+
+                m_sent += due;
+                total_sent.fetch_add(due, std::memory_order_relaxed);
+            }
+        }
+    };
+
+    int listen_on(int port) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) return -1;
+
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+
+        if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    void print_help() {
+        std::cout << "socketcand stand-in for testing CANary" << std::endl << std::endl;
+        std::cout << "--port\tPort to listen on (default 29536)" << std::endl;
+        std::cout << "--interface\tBus name clients must open (default can0)" << std::endl;
+        std::cout << "--rate\tFrames per second per client, 0 for as fast as possible (default 10000)" << std::endl;
+        std::cout << "--ids\tNumber of distinct synthetic CAN IDs (default 64)" << std::endl;
+        std::cout << "--replay\tSend the IDs and payloads from a capture file, in a loop" << std::endl;
+        std::cout << "--echo\tSend frames from \"< send >\" back to the client" << std::endl;
+        std::cout << "--duration\tStop after this many seconds" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    options opts;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        std::string arg_name = arg, arg_val = "true";
+
+        auto sep_pos = arg.find('=');
+        if (sep_pos != std::string::npos) {
+            arg_name = arg.substr(0, sep_pos);
+            arg_val = arg.substr(sep_pos + 1);
+        }
+
+        auto name_start = arg_name.find_first_not_of('-');
+        if (name_start != std::string::npos) {
+            arg_name.erase(0, name_start);
+        }
+
+        if (arg_name == "help") {
+            print_help();
+            return 0;
+        } else if (arg_name == "port") {
+            std::istringstream(arg_val) >> opts.port;
+        } else if (arg_name == "interface") {
+            opts.interface = arg_val;
+        } else if (arg_name == "rate") {
+            std::istringstream(arg_val) >> opts.rate;
+        } else if (arg_name == "ids") {
+            std::istringstream(arg_val) >> opts.ids;
+        } else if (arg_name == "replay") {
+            opts.replay_path = arg_val;
+        } else if (arg_name == "echo") {
+            std::istringstream(arg_val) >> std::boolalpha >> opts.echo;
+        } else if (arg_name == "duration") {
+            std::istringstream(arg_val) >> opts.duration;
+        } else {
+            std::cout << "Unrecognised option: " << arg_name << std::endl;
+        }
+    }
+
+    std::unique_ptr<canary::can::capturefile> replay;
+    if (!opts.replay_path.empty()) {
+        replay = std::make_unique<canary::can::capturefile>();
+        replay->set_error_handler([](const std::string &msg) {
+            std::cout << "Error: " << msg << std::endl;
+        });
+        if (replay->open(opts.replay_path) != 0) {
+            return 1;
+        }
+    }
+
+    int listen_fd = listen_on(opts.port);
+    if (listen_fd < 0) {
+        perror("Failed to listen");
+        return 1;
+    }
+
+    std::signal(SIGINT, handle_signal);
+    std::signal(SIGTERM, handle_signal);
+
+    std::cout << "Listening on port " << opts.port << ", " << (opts.rate > 0 ? std::to_string(opts.rate) : "max")
+              << " frames/s per client" << std::endl;
+
+    std::vector<std::thread> sessions;
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    uint64_t last_sent = 0;
+
+    while (running) {
+        struct pollfd pfd{listen_fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) > 0) {
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if (client_fd >= 0) {
+                int yes = 1;
+                setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                std::cout << "Client connected" << std::endl;
+                sessions.emplace_back([client_fd, &opts, &replay] {
+                    session(client_fd, opts, replay.get()).run();
+                });
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(1)) {
+            const uint64_t sent = total_sent.load();
+            const double interval = std::chrono::duration<double>(now - last_report).count();
+            if (active_clients > 0) {
+                std::cout << active_clients << " client(s), " << static_cast<uint64_t>((sent - last_sent) / interval)
+                          << " frames/s, " << sent << " sent, " << total_received << " received" << std::endl;
+            }
+            last_sent = sent;
+            last_report = now;
+        }
+
+        if (opts.duration > 0 && now - start >= std::chrono::seconds(opts.duration)) {
+            running = false;
+        }
+    }
+
+    for (auto &s: sessions) {
+        s.join();
+    }
+    ::close(listen_fd);
+
+    std::cout << "Sent " << total_sent << " frames, received " << total_received << std::endl;
+    return 0;
+}